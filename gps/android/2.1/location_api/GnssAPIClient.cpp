@@ -34,6 +34,7 @@
 #include <inttypes.h>
 #include <log_util.h>
 #include <loc_cfg.h>
+#include <LocLatencyTracer.h>
 
 #include "LocationUtil.h"
 #include "GnssAPIClient.h"
@@ -231,6 +232,7 @@ bool GnssAPIClient::gnssStop()
 
     bool retVal = true;
     locAPIStopTracking();
+    loc_util::LocLatencyTracer::getInstance()->flush();
     return retVal;
 }
 
@@ -499,6 +501,9 @@ void GnssAPIClient::onTrackingCb(Location location)
         return;
     }
 
+    loc_util::LocLatencyTracer* tracer = loc_util::LocLatencyTracer::getInstance();
+    tracer->stamp(location.timestamp, loc_util::LOC_LATENCY_STAGE_HIDL_CB);
+
     if (gnssCbIface_2_1 != nullptr) {
         V2_0::GnssLocation gnssLocation;
         convertGnssLocation(location, gnssLocation);
@@ -527,6 +532,7 @@ void GnssAPIClient::onTrackingCb(Location location)
         LOC_LOGW("%s] No GNSS Interface ready for gnssLocationCb ", __FUNCTION__);
     }
 
+    tracer->stamp(location.timestamp, loc_util::LOC_LATENCY_STAGE_HIDL_DONE);
 }
 
 void GnssAPIClient::onGnssNiCb(uint32_t id, GnssNiNotification gnssNiNotification)
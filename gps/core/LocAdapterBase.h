@@ -169,6 +169,16 @@ public:
         mMsgTask->sendMsg(msg);
     }
 
+    // Report traffic should be tagged LOC_MSG_PRIORITY_POSITION or
+    // LOC_MSG_PRIORITY_BULK so it does not delay control messages.
+    inline void sendMsg(const LocMsg* msg, LocMsgPriority priority) const {
+        mMsgTask->sendMsg(msg, priority);
+    }
+
+    inline void sendMsg(const LocMsg* msg, LocMsgPriority priority) {
+        mMsgTask->sendMsg(msg, priority);
+    }
+
     inline void updateEvtMask(LOC_API_ADAPTER_EVENT_MASK_T event,
                               loc_registration_mask_status status)
     {
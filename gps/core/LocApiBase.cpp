@@ -37,6 +37,7 @@
 #include <log_util.h>
 #include <LocContext.h>
 #include <loc_misc_utils.h>
+#include <LocLatencyTracer.h>
 
 namespace loc_core {
 
@@ -325,6 +326,9 @@ void LocApiBase::reportPosition(UlpLocation& location,
                                 GnssDataNotification* pDataNotify,
                                 int msInWeek)
 {
+    LocLatencyTracer::getInstance()->stamp(location.gpsLocation.timestamp,
+                                           LOC_LATENCY_STAGE_LOC_API);
+
     // print the location info before delivering
     LOC_LOGD("flags: %d\n  source: %d\n  latitude: %f\n  longitude: %f\n  "
              "altitude: %f\n  speed: %f\n  bearing: %f\n  accuracy: %f\n  "
@@ -47,6 +47,7 @@
 #include <SystemStatus.h>
 #include <vector>
 #include <loc_misc_utils.h>
+#include <LocLatencyTracer.h>
 #include <gps_extended_c.h>
 
 #define RAD2DEG    (180.0 / M_PI)
@@ -3841,7 +3842,8 @@ GnssAdapter::reportPositionEvent(const UlpLocation& ulpLocation,
             dataNotifyCopy.size = sizeof(dataNotifyCopy);
         }
         sendMsg(new MsgReportSPEPosition(*this, ulpLocation, locationExtended,
-                                          status, techMask, dataNotifyCopy, msInWeek));
+                                          status, techMask, dataNotifyCopy, msInWeek),
+                LOC_MSG_PRIORITY_POSITION);
     }
 }
 
@@ -3871,7 +3873,8 @@ GnssAdapter::reportEnginePositionsEvent(unsigned int count,
         }
     };
 
-    sendMsg(new MsgReportEnginePositions(*this, count, locationArr));
+    sendMsg(new MsgReportEnginePositions(*this, count, locationArr),
+            LOC_MSG_PRIORITY_POSITION);
 }
 
 bool
@@ -4009,6 +4012,9 @@ GnssAdapter::reportPosition(const UlpLocation& ulpLocation,
                             enum loc_sess_status status,
                             LocPosTechMask techMask)
 {
+    LocLatencyTracer::getInstance()->stamp(ulpLocation.gpsLocation.timestamp,
+                                           LOC_LATENCY_STAGE_ADAPTER);
+
     bool reportToGnssClient = needReportForGnssClient(ulpLocation, status, techMask);
     bool reportToFlpClient = needReportForFlpClient(status, techMask);
 
@@ -4116,7 +4122,7 @@ GnssAdapter::reportLatencyInfoEvent(const GnssLatencyInfo& gnssLatencyInfo)
                       mAdapter.mGnssLatencyInfoQueue.size());
         }
     };
-    sendMsg(new MsgReportLatencyInfo(*this, gnssLatencyInfo));
+    sendMsg(new MsgReportLatencyInfo(*this, gnssLatencyInfo), LOC_MSG_PRIORITY_POSITION);
 }
 
 void
@@ -4201,7 +4207,7 @@ GnssAdapter::reportSvEvent(const GnssSvNotification& svNotify,
         }
     };
 
-    sendMsg(new MsgReportSv(*this, svNotify));
+    sendMsg(new MsgReportSv(*this, svNotify), LOC_MSG_PRIORITY_BULK);
 }
 
 void
@@ -4410,7 +4416,7 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length)
         }
     };
 
-    sendMsg(new MsgReportNmea(*this, nmea, length));
+    sendMsg(new MsgReportNmea(*this, nmea, length), LOC_MSG_PRIORITY_BULK);
 }
 
 void
@@ -4790,7 +4796,8 @@ GnssAdapter::reportGnssMeasurementsEvent(const GnssMeasurements& gnssMeasurement
             }
         };
 
-        sendMsg(new MsgReportGnssMeasurementData(*this, gnssMeasurements, msInWeek));
+        sendMsg(new MsgReportGnssMeasurementData(*this, gnssMeasurements, msInWeek),
+                LOC_MSG_PRIORITY_BULK);
     }
     mEngHubProxy->gnssReportSvMeasurement(gnssMeasurements.gnssSvMeasurementSet);
     if (mDGnssNeedReport) {
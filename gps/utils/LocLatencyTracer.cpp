@@ -0,0 +1,203 @@
+/* Copyright (c) 2026 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "LocLatencyTracer.h"
+#include <loc_cfg.h>
+#include <loc_pla.h>
+#include <log_util.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "LocSvc_LatencyTracer"
+
+namespace loc_util {
+
+static const char* const sStageNames[LOC_LATENCY_STAGE_MAX] = {
+    "locapi->adapter", "adapter->hidl", "hidl cb", "total"
+};
+
+static uint64_t getMonotonicNs() {
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t nsToBucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    uint32_t bucket = 0;
+    while (us > 0 && bucket < LOC_LATENCY_HIST_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+LocLatencyTracer* LocLatencyTracer::getInstance() {
+    // never destroyed, LocApi and HIDL threads may still stamp while the process exits
+    static LocLatencyTracer* sInstance = new LocLatencyTracer();
+    return sInstance;
+}
+
+LocLatencyTracer::LocLatencyTracer() :
+        mMode(0), mNextSlot(0), mCompleted(0), mEvicted(0), mTraceFile(nullptr),
+        mTraceBytes(0) {
+    memset(mSlots, 0, sizeof(mSlots));
+    memset(mHist, 0, sizeof(mHist));
+    loc_param_s_type latency_trace_config_table[] =
+    {
+        {"LATENCY_TRACE_ENABLED",   &mMode,  NULL, 'n'},
+    };
+    loc_read_conf(LOC_PATH_GPS_CONF_STR, latency_trace_config_table,
+            sizeof(latency_trace_config_table)/sizeof(latency_trace_config_table[0]));
+
+    if (mMode >= 2) {
+        openTraceFile();
+    }
+    LOC_LOGd("latency trace mode %u", mMode);
+}
+
+void LocLatencyTracer::flush() {
+    std::lock_guard<std::mutex> guard(mLock);
+    if (nullptr != mTraceFile) {
+        fflush(mTraceFile);
+    }
+}
+
+void LocLatencyTracer::openTraceFile() {
+    mTraceFile = fopen(LOC_LATENCY_TRACE_FILE_PATH, "wb");
+    mTraceBytes = 0;
+    if (nullptr == mTraceFile) {
+        LOC_LOGe("failed to open %s, binary trace disabled", LOC_LATENCY_TRACE_FILE_PATH);
+        return;
+    }
+    const uint16_t version = 1;
+    const uint16_t stageCount = LOC_LATENCY_STAGE_MAX;
+    fwrite("LLT1", 1, 4, mTraceFile);
+    fwrite(&version, sizeof(version), 1, mTraceFile);
+    fwrite(&stageCount, sizeof(stageCount), 1, mTraceFile);
+    mTraceBytes = 4 + sizeof(version) + sizeof(stageCount);
+}
+
+void LocLatencyTracer::stamp(uint64_t fixTimestampMs, LocLatencyStage stage) {
+    if (0 == mMode || stage >= LOC_LATENCY_STAGE_MAX) {
+        return;
+    }
+    uint64_t now = getMonotonicNs();
+    std::lock_guard<std::mutex> guard(mLock);
+
+    TraceContext* ctx = nullptr;
+    if (LOC_LATENCY_STAGE_LOC_API == stage) {
+        ctx = &mSlots[mNextSlot];
+        mNextSlot = (mNextSlot + 1) % LOC_LATENCY_TRACE_SLOTS;
+        if (0 != ctx->stampedMask) {
+            // fix never reached the HIDL callback, e.g. no tracking session
+            mEvicted++;
+        }
+        ctx->fixTimestampMs = fixTimestampMs;
+        ctx->stampedMask = 0;
+    } else {
+        for (uint32_t i = 0; i < LOC_LATENCY_TRACE_SLOTS; i++) {
+            if (0 != mSlots[i].stampedMask && mSlots[i].fixTimestampMs == fixTimestampMs) {
+                ctx = &mSlots[i];
+                break;
+            }
+        }
+        // fixes can be reported to more than one client, keep the first stamp
+        if (nullptr == ctx || (ctx->stampedMask & (1 << stage))) {
+            return;
+        }
+    }
+
+    ctx->stampNs[stage] = now;
+    ctx->stampedMask |= (1 << stage);
+
+    if (LOC_LATENCY_STAGE_HIDL_DONE == stage) {
+        if ((1 << LOC_LATENCY_STAGE_MAX) - 1 == ctx->stampedMask) {
+            complete(*ctx);
+        }
+        ctx->stampedMask = 0;
+    }
+}
+
+void LocLatencyTracer::complete(const TraceContext& ctx) {
+    for (uint32_t s = 1; s < LOC_LATENCY_STAGE_MAX; s++) {
+        mHist[s - 1][nsToBucket(ctx.stampNs[s] - ctx.stampNs[s - 1])]++;
+    }
+    mHist[LOC_LATENCY_STAGE_MAX - 1][nsToBucket(
+            ctx.stampNs[LOC_LATENCY_STAGE_HIDL_DONE] - ctx.stampNs[LOC_LATENCY_STAGE_LOC_API])]++;
+    mCompleted++;
+
+    if (nullptr != mTraceFile) {
+        writeRecord(ctx);
+    }
+
+    if (0 == mCompleted % LOC_LATENCY_LOG_INTERVAL) {
+        std::string out;
+        for (uint32_t h = 0; h < LOC_LATENCY_STAGE_MAX; h++) {
+            out.clear();
+            char buf[32];
+            for (uint32_t b = 0; b < LOC_LATENCY_HIST_BUCKETS; b++) {
+                snprintf(buf, sizeof(buf), " %u", mHist[h][b]);
+                out += buf;
+            }
+            LOC_LOGi("fix latency %s (log2 us buckets):%s", sStageNames[h], out.c_str());
+        }
+        LOC_LOGi("fix latency completed %" PRIu64 " evicted %" PRIu64, mCompleted, mEvicted);
+        if (nullptr != mTraceFile) {
+            fflush(mTraceFile);
+        }
+    }
+}
+
+void LocLatencyTracer::writeRecord(const TraceContext& ctx) {
+    uint32_t deltaUs[LOC_LATENCY_STAGE_MAX - 1];
+    for (uint32_t s = 1; s < LOC_LATENCY_STAGE_MAX; s++) {
+        deltaUs[s - 1] = (uint32_t)((ctx.stampNs[s] - ctx.stampNs[s - 1]) / 1000);
+    }
+    fwrite(&ctx.fixTimestampMs, sizeof(ctx.fixTimestampMs), 1, mTraceFile);
+    fwrite(&ctx.stampNs[LOC_LATENCY_STAGE_LOC_API], sizeof(uint64_t), 1, mTraceFile);
+    fwrite(deltaUs, sizeof(deltaUs), 1, mTraceFile);
+    mTraceBytes += sizeof(ctx.fixTimestampMs) + sizeof(uint64_t) + sizeof(deltaUs);
+
+    if (mTraceBytes >= LOC_LATENCY_TRACE_MAX_BYTES) {
+        fclose(mTraceFile);
+        if (0 != rename(LOC_LATENCY_TRACE_FILE_PATH, LOC_LATENCY_TRACE_OLD_FILE_PATH)) {
+            LOC_LOGw("failed to rotate %s, errno %d", LOC_LATENCY_TRACE_FILE_PATH, errno);
+        }
+        openTraceFile();
+    }
+}
+
+}
@@ -0,0 +1,113 @@
+/* Copyright (c) 2026 The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_LATENCY_TRACER_H
+#define LOC_LATENCY_TRACER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+
+//file path of the binary fix latency trace, and of the previous one once it is rotated
+#define LOC_LATENCY_TRACE_FILE_PATH "/data/vendor/location/fix_latency.bin"
+#define LOC_LATENCY_TRACE_OLD_FILE_PATH "/data/vendor/location/fix_latency.bin.1"
+//size at which the binary trace is rotated, about 10 hours of 1Hz fixes
+#define LOC_LATENCY_TRACE_MAX_BYTES (1024 * 1024)
+//number of fixes that may be in flight between the first and last stage
+#define LOC_LATENCY_TRACE_SLOTS 8
+//number of power of two histogram buckets, in microseconds (last is overflow)
+#define LOC_LATENCY_HIST_BUCKETS 24
+//completed fixes between two histogram log prints
+#define LOC_LATENCY_LOG_INTERVAL 60
+
+namespace loc_util {
+
+// Host side stages a fix goes through, in order.
+enum LocLatencyStage {
+    LOC_LATENCY_STAGE_LOC_API = 0,   // LocApiBase::reportPosition
+    LOC_LATENCY_STAGE_ADAPTER,       // GnssAdapter::reportPosition, on the MsgTask thread
+    LOC_LATENCY_STAGE_HIDL_CB,       // GnssAPIClient::onTrackingCb entry
+    LOC_LATENCY_STAGE_HIDL_DONE,     // framework gnssLocationCb returned
+    LOC_LATENCY_STAGE_MAX
+};
+
+/*
+ * Per fix trace of host side latency. Each stage stamps CLOCK_MONOTONIC
+ * against the fix UTC timestamp, which is carried unchanged from UlpLocation
+ * to the HIDL GnssLocation and so identifies the fix across threads. When the
+ * last stage is stamped the per stage deltas go into histograms, which are
+ * printed every LOC_LATENCY_LOG_INTERVAL fixes.
+ *
+ * Enabled through LATENCY_TRACE_ENABLED in gps.conf:
+ *   0: disabled, 1: histograms, 2: histograms and binary trace file.
+ * The trace file is rotated once it reaches LOC_LATENCY_TRACE_MAX_BYTES,
+ * keeping a single previous file. It is never closed, records are flushed
+ * with each histogram print and by flush() when tracking stops.
+ *
+ * Binary trace file layout, little endian:
+ *   header: char magic[4] = "LLT1", uint16_t version = 1,
+ *           uint16_t stageCount = LOC_LATENCY_STAGE_MAX
+ *   record: uint64_t fixTimestampMs (UTC), uint64_t locApiNs (CLOCK_MONOTONIC),
+ *           uint32_t deltaUs[stageCount - 1], each relative to the previous stage
+ */
+class LocLatencyTracer {
+public:
+    static LocLatencyTracer* getInstance();
+    void stamp(uint64_t fixTimestampMs, LocLatencyStage stage);
+    // writes buffered trace records out to the trace file
+    void flush();
+
+private:
+    struct TraceContext {
+        uint64_t fixTimestampMs;
+        uint64_t stampNs[LOC_LATENCY_STAGE_MAX];
+        uint32_t stampedMask;
+    };
+
+    uint32_t mMode;
+    std::mutex mLock;
+    TraceContext mSlots[LOC_LATENCY_TRACE_SLOTS];
+    uint32_t mNextSlot;
+    // one histogram per stage transition plus one for LOC_API to HIDL_DONE
+    uint32_t mHist[LOC_LATENCY_STAGE_MAX][LOC_LATENCY_HIST_BUCKETS];
+    uint64_t mCompleted;
+    uint64_t mEvicted;
+    FILE* mTraceFile;
+    uint32_t mTraceBytes;
+
+    LocLatencyTracer();
+    ~LocLatencyTracer() = delete;
+    void openTraceFile();
+    void complete(const TraceContext& ctx);
+    void writeRecord(const TraceContext& ctx);
+};
+
+}
+
+#endif
@@ -66,8 +66,16 @@ MsgTask::MsgTask(const char* threadName) :
 }
 
 void MsgTask::sendMsg(const LocMsg* msg) const {
+    sendMsg(msg, LOC_MSG_PRIORITY_CONTROL);
+}
+
+void MsgTask::sendMsg(const LocMsg* msg, LocMsgPriority priority) const {
+    static_assert((int)LOC_MSG_PRIORITY_CONTROL == (int)eMSG_Q_PRIO_CONTROL &&
+                  (int)LOC_MSG_PRIORITY_POSITION == (int)eMSG_Q_PRIO_POSITION &&
+                  (int)LOC_MSG_PRIORITY_BULK == (int)eMSG_Q_PRIO_BULK,
+                  "LocMsgPriority must match msg_q_prio_type");
     if (msg && this) {
-        msg_q_snd((void*)mQ, (void*)msg, LocMsgDestroy);
+        msg_q_snd_prio((void*)mQ, (void*)msg, LocMsgDestroy, (msg_q_prio_type)priority);
     } else {
         LOC_LOGE("%s: msg is %p and this is %p",
                  __func__, msg, this);
@@ -34,6 +34,14 @@
 
 namespace loc_util {
 
+// Delivery lanes of a MsgTask. Messages are handled in order within a lane;
+// higher lanes are served first, with lower lanes protected from starvation.
+enum LocMsgPriority {
+    LOC_MSG_PRIORITY_CONTROL = 0,   // requests and state changes (default)
+    LOC_MSG_PRIORITY_POSITION,      // position reports
+    LOC_MSG_PRIORITY_BULK           // SV, measurement, NMEA reports
+};
+
 struct LocMsg {
     inline LocMsg() {}
     inline virtual ~LocMsg() {}
@@ -48,6 +56,7 @@ public:
     ~MsgTask() = default;
     MsgTask(const char* threadName = NULL);
     void sendMsg(const LocMsg* msg) const;
+    void sendMsg(const LocMsg* msg, LocMsgPriority priority) const;
     void sendMsg(const std::function<void()> runnable) const;
 };
 
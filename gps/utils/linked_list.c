@@ -43,11 +43,68 @@ typedef struct list_element {
    void (*dealloc_func)(void*);
 }list_element;
 
+/* Upper bound on the number of released elements a list keeps for reuse.
+   Bounds the memory held by a list that saw a burst of elements. */
+#define LINKED_LIST_NODE_CACHE_MAX 64
+
 typedef struct list_state {
    list_element* p_head;
    list_element* p_tail;
+   /* Singly linked (through next) freelist of released elements */
+   list_element* p_free;
+   uint32_t free_count;
 } list_state;
 
+/* ----------------------- INTERNAL FUNCTIONS ---------------------------------------- */
+
+/* Takes an element from the list's freelist, falling back to malloc
+   only when the freelist is exhausted. */
+static list_element* list_element_alloc(list_state* p_list)
+{
+   list_element* elem = p_list->p_free;
+   if( elem != NULL )
+   {
+      p_list->p_free = elem->next;
+      p_list->free_count--;
+   }
+   else
+   {
+      elem = (list_element*)malloc(sizeof(list_element));
+   }
+   return elem;
+}
+
+/* Returns an element to the list's freelist, or frees it once the
+   freelist holds LINKED_LIST_NODE_CACHE_MAX elements. */
+static void list_element_release(list_state* p_list, list_element* elem)
+{
+   if( p_list->free_count < LINKED_LIST_NODE_CACHE_MAX )
+   {
+      elem->data_ptr = NULL;
+      elem->dealloc_func = NULL;
+      elem->prev = NULL;
+      elem->next = p_list->p_free;
+      p_list->p_free = elem;
+      p_list->free_count++;
+   }
+   else
+   {
+      free(elem);
+   }
+}
+
+/* Frees every element held on the list's freelist. */
+static void list_element_drain(list_state* p_list)
+{
+   while( p_list->p_free != NULL )
+   {
+      list_element* tmp = p_list->p_free->next;
+      free(p_list->p_free);
+      p_list->p_free = tmp;
+   }
+   p_list->free_count = 0;
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
 /*===========================================================================
@@ -73,6 +130,8 @@ linked_list_err_type linked_list_init(void** list_data)
 
    tmp_list->p_head = NULL;
    tmp_list->p_tail = NULL;
+   tmp_list->p_free = NULL;
+   tmp_list->free_count = 0;
 
    *list_data = tmp_list;
 
@@ -95,6 +154,7 @@ linked_list_err_type linked_list_destroy(void** list_data)
    list_state* p_list = (list_state*)*list_data;
 
    linked_list_flush(p_list);
+   list_element_drain(p_list);
 
    free(*list_data);
    *list_data = NULL;
@@ -122,7 +182,7 @@ linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dea
    }
 
    list_state* p_list = (list_state*)list_data;
-   list_element* elem = (list_element*)malloc(sizeof(list_element));
+   list_element* elem = list_element_alloc(p_list);
    if( elem == NULL )
    {
       LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
@@ -195,8 +255,8 @@ linked_list_err_type linked_list_remove(void* list_data, void **data_obj)
    /* Copy data to output param */
    *data_obj = tmp->data_ptr;
 
-   /* Free allocated list element */
-   free(tmp);
+   /* Recycle list element */
+   list_element_release(p_list, tmp);
 
    return eLINKED_LIST_SUCCESS;
 }
@@ -246,8 +306,8 @@ linked_list_err_type linked_list_flush(void* list_data)
          p_list->p_head->dealloc_func(p_list->p_head->data_ptr);
       }
 
-      /* Free list element */
-      free(p_list->p_head);
+      /* Recycle list element */
+      list_element_release(p_list, p_list->p_head);
 
       p_list->p_head = tmp;
    }
@@ -311,7 +371,7 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
          if (NULL == data_p && NULL != tmp->dealloc_func) {
              tmp->dealloc_func(tmp->data_ptr);
          }
-         free(tmp);
+         list_element_release(p_list, tmp);
        }
 
        tmp = NULL;
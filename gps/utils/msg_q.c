@@ -37,8 +37,13 @@
 #include "linked_list.h"
 #include "msg_q.h"
 
+/* Number of consecutive times a non-empty lane may be passed over in favor
+   of a higher priority lane before it is served regardless. */
+#define MSG_Q_STARVATION_LIMIT 16
+
 typedef struct msg_q {
-   void* msg_list;                  /* Linked list to store information */
+   void* msg_list[eMSG_Q_PRIO_MAX]; /* Linked list per priority lane */
+   unsigned int skipped[eMSG_Q_PRIO_MAX]; /* Times each lane was passed over */
    pthread_cond_t  list_cond;       /* Condition variable for waiting on msg queue */
    pthread_mutex_t list_mutex;      /* Mutex for exclusive access to message queue */
    int unblocked;                   /* Has this message queue been unblocked? */
@@ -85,6 +90,91 @@ static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_l
    }
 }
 
+/*===========================================================================
+FUNCTION    msg_q_empty
+
+DESCRIPTION
+   Tells whether all lanes of the message queue are empty. Must be called
+   with list_mutex held.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if no lane holds a message, 0 otherwise
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_q_empty(msg_q* p_msg_q)
+{
+   int i;
+   for( i = 0; i < eMSG_Q_PRIO_MAX; i++ )
+   {
+      if( !linked_list_empty(p_msg_q->msg_list[i]) )
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_remove_next
+
+DESCRIPTION
+   Removes the next message to be delivered. The highest priority non-empty
+   lane is served, unless a lower non-empty lane has been passed over
+   MSG_Q_STARVATION_LIMIT times, in which case the lowest such lane is
+   served. Must be called with list_mutex held.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static linked_list_err_type msg_q_remove_next(msg_q* p_msg_q, void** msg_obj)
+{
+   int i;
+   int lane = -1;
+
+   for( i = eMSG_Q_PRIO_MAX - 1; i >= 0; i-- )
+   {
+      if( !linked_list_empty(p_msg_q->msg_list[i]) )
+      {
+         if( lane < 0 || p_msg_q->skipped[lane] < MSG_Q_STARVATION_LIMIT )
+         {
+            lane = i;
+         }
+      }
+   }
+
+   if( lane < 0 )
+   {
+      return eLINKED_LIST_UNAVAILABLE_RESOURCE;
+   }
+
+   for( i = 0; i < eMSG_Q_PRIO_MAX; i++ )
+   {
+      if( i == lane || linked_list_empty(p_msg_q->msg_list[i]) )
+      {
+         p_msg_q->skipped[i] = 0;
+      }
+      else
+      {
+         p_msg_q->skipped[i]++;
+      }
+   }
+
+   return linked_list_remove(p_msg_q->msg_list[lane], msg_obj);
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
 /*===========================================================================
@@ -94,6 +184,7 @@ static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_l
   ===========================================================================*/
 msq_q_err_type msg_q_init(void** msg_q_data)
 {
+   int i;
    if( msg_q_data == NULL )
    {
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
@@ -108,17 +199,27 @@ msq_q_err_type msg_q_init(void** msg_q_data)
       return eMSG_Q_FAILURE_GENERAL;
    }
 
-   if( linked_list_init(&tmp_msg_q->msg_list) != 0 )
+   for( i = 0; i < eMSG_Q_PRIO_MAX; i++ )
    {
-      LOC_LOGE("%s: Unable to initialize storage list!\n", __FUNCTION__);
-      free(tmp_msg_q);
-      return eMSG_Q_FAILURE_GENERAL;
+      if( linked_list_init(&tmp_msg_q->msg_list[i]) != 0 )
+      {
+         LOC_LOGE("%s: Unable to initialize storage list!\n", __FUNCTION__);
+         while( --i >= 0 )
+         {
+            linked_list_destroy(&tmp_msg_q->msg_list[i]);
+         }
+         free(tmp_msg_q);
+         return eMSG_Q_FAILURE_GENERAL;
+      }
    }
 
    if( pthread_mutex_init(&tmp_msg_q->list_mutex, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize list mutex!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
+      for( i = 0; i < eMSG_Q_PRIO_MAX; i++ )
+      {
+         linked_list_destroy(&tmp_msg_q->msg_list[i]);
+      }
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
@@ -126,7 +227,10 @@ msq_q_err_type msg_q_init(void** msg_q_data)
    if( pthread_cond_init(&tmp_msg_q->list_cond, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize msg q cond var!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
+      for( i = 0; i < eMSG_Q_PRIO_MAX; i++ )
+      {
+         linked_list_destroy(&tmp_msg_q->msg_list[i]);
+      }
       pthread_mutex_destroy(&tmp_msg_q->list_mutex);
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
@@ -168,7 +272,11 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
    msg_q* p_msg_q = (msg_q*)*msg_q_data;
 
-   linked_list_destroy(&p_msg_q->msg_list);
+   int i;
+   for( i = 0; i < eMSG_Q_PRIO_MAX; i++ )
+   {
+      linked_list_destroy(&p_msg_q->msg_list[i]);
+   }
    pthread_mutex_destroy(&p_msg_q->list_mutex);
    pthread_cond_destroy(&p_msg_q->list_cond);
 
@@ -186,6 +294,17 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
   ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*))
+{
+   return msg_q_snd_prio(msg_q_data, msg_obj, dealloc, eMSG_Q_PRIO_CONTROL);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_snd_prio
+
+  ===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              msg_q_prio_type prio)
 {
    msq_q_err_type rv;
    if( msg_q_data == NULL )
@@ -198,11 +317,16 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
       return eMSG_Q_INVALID_PARAMETER;
    }
+   if( prio < eMSG_Q_PRIO_CONTROL || prio >= eMSG_Q_PRIO_MAX )
+   {
+      LOC_LOGE("%s: Invalid prio parameter %d!\n", __FUNCTION__, prio);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
    pthread_mutex_lock(&p_msg_q->list_mutex);
-   LOC_LOGV("%s: Sending message with handle = %p\n", __FUNCTION__, msg_obj);
+   LOC_LOGV("%s: Sending message with handle = %p prio = %d\n", __FUNCTION__, msg_obj, prio);
 
    if( p_msg_q->unblocked )
    {
@@ -211,7 +335,7 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       return eMSG_Q_UNAVAILABLE_RESOURCE;
    }
 
-   rv = convert_linked_list_err_type(linked_list_add(p_msg_q->msg_list, msg_obj, dealloc));
+   rv = convert_linked_list_err_type(linked_list_add(p_msg_q->msg_list[prio], msg_obj, dealloc));
 
    /* Show data is in the message queue. */
    pthread_cond_signal(&p_msg_q->list_cond);
@@ -255,12 +379,12 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
    }
 
    /* Wait for data in the message queue */
-   while( linked_list_empty(p_msg_q->msg_list) && !p_msg_q->unblocked )
+   while( msg_q_empty(p_msg_q) && !p_msg_q->unblocked )
    {
       pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
    }
 
-   rv = convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list, msg_obj));
+   rv = convert_linked_list_err_type(msg_q_remove_next(p_msg_q, msg_obj));
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -297,13 +421,13 @@ msq_q_err_type msg_q_rmv(void* msg_q_data, void** msg_obj)
       return eMSG_Q_UNAVAILABLE_RESOURCE;
    }
 
-   if (linked_list_empty(p_msg_q->msg_list)) {
+   if (msg_q_empty(p_msg_q)) {
       LOC_LOGW("%s: list is empty !!\n", __FUNCTION__);
       pthread_mutex_unlock(&p_msg_q->list_mutex);
       return eMSG_Q_EMPTY;
    }
 
-   rv = convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list, msg_obj));
+   rv = convert_linked_list_err_type(msg_q_remove_next(p_msg_q, msg_obj));
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -322,6 +446,7 @@ msq_q_err_type msg_q_rmv(void* msg_q_data, void** msg_obj)
 msq_q_err_type msg_q_flush(void* msg_q_data)
 {
    msq_q_err_type rv;
+   int i;
    if ( msg_q_data == NULL )
    {
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
@@ -334,8 +459,18 @@ msq_q_err_type msg_q_flush(void* msg_q_data)
 
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
-   /* Remove all elements from the list */
-   rv = convert_linked_list_err_type(linked_list_flush(p_msg_q->msg_list));
+   /* Remove all elements from every lane */
+   rv = eMSG_Q_SUCCESS;
+   for( i = 0; i < eMSG_Q_PRIO_MAX; i++ )
+   {
+      msq_q_err_type lane_rv =
+         convert_linked_list_err_type(linked_list_flush(p_msg_q->msg_list[i]));
+      if( lane_rv != eMSG_Q_SUCCESS )
+      {
+         rv = lane_rv;
+      }
+      p_msg_q->skipped[i] = 0;
+   }
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -54,6 +54,18 @@ typedef enum
      /**< Failed because list is empty. */
 }msq_q_err_type;
 
+/** Message Queue Priority Lanes */
+typedef enum
+{
+  eMSG_Q_PRIO_CONTROL                        = 0,
+     /**< Requests and state changes; default lane of msg_q_snd. */
+  eMSG_Q_PRIO_POSITION                       = 1,
+     /**< Position reports. */
+  eMSG_Q_PRIO_BULK                           = 2,
+     /**< SV, measurement, NMEA and other high rate reports. */
+  eMSG_Q_PRIO_MAX
+}msg_q_prio_type;
+
 /*===========================================================================
 FUNCTION    msg_q_init
 
@@ -137,12 +149,42 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*));
 
+/*===========================================================================
+FUNCTION    msg_q_snd_prio
+
+DESCRIPTION
+   Sends data to the given priority lane of the message queue. Messages are
+   FIFO within a lane; msg_q_rcv serves the highest priority non-empty lane,
+   except that a lower lane passed over too many times in a row is served
+   next so that it can not be starved. msg_q_snd is equivalent to sending on
+   eMSG_Q_PRIO_CONTROL.
+
+   msg_q_data: Message Queue to add the element to.
+   msgp:       Pointer to data to add into message queue.
+   dealloc:    Function used to deallocate memory for this element. Pass NULL
+               if you do not want data deallocated during a flush operation
+   prio:       Lane to add the element to.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              msg_q_prio_type prio);
+
 /*===========================================================================
 FUNCTION    msg_q_rcv
 
 DESCRIPTION
    Retrieves data from the message queue. msg_obj is the oldest message received
-   and pointer is simply removed from message queue.
+   on the lane selected by msg_q_snd_prio and pointer is simply removed from
+   message queue.
 
    msg_q_data: Message Queue to copy data from into msgp.
    msg_obj:    Pointer to space to copy msg_q contents to.
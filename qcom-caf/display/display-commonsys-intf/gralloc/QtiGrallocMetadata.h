@@ -64,6 +64,8 @@
 #define QTI_RGB_DATA_ADDRESS 10023
 #define QTI_COLORSPACE 10024
 #define QTI_YUV_PLANE_INFO 10025
+// Per frame damage and timestamp of a writeback output buffer
+#define QTI_WRITEBACK_FRAME_INFO 10026
 
 // Used to indicate to framework that internal definitions are used instead
 #define COMPRESSION_QTI_UBWC 20001
@@ -168,6 +170,16 @@ struct VideoTimestampInfo {
   int64_t frame_timestamp_us;    /* Frame timestamp in us */
 };
 
+// WRITEBACK_FRAME_INFO
+/* Frame content is identical to the previous frame written to the same display */
+#define WB_FRAME_FLAG_UNCHANGED 0x1
+struct WritebackFrameInfo {
+  uint32_t frame_number;         /* Frame counter of the producing display */
+  uint32_t flags;                /* Bit mask of WB_FRAME_FLAG_* */
+  int64_t timestamp_ns;          /* CLOCK_MONOTONIC time the frame was committed */
+  struct CropRectangle_t damage; /* Region changed since the previous frame, empty if unchanged */
+};
+
 #define RESERVED_REGION_SIZE 4096
 typedef struct ReservedRegion {
   uint32_t size;
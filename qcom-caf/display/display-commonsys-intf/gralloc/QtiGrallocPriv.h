@@ -91,6 +91,10 @@
 
 #define METADATA_V2
 
+// Layout version stamped by qdMetaData into MetaData_t::version on every write. Buffers whose
+// metadata was never written through qdMetaData carry 0.
+#define QD_METADATA_VERSION 1
+
 // TODO: MetaData_t should be in qtigralloc namespace
 struct MetaData_t {
   int32_t operation;
@@ -138,6 +142,12 @@ struct MetaData_t {
   bool isVendorMetadataSet[METADATA_SET_SIZE];
   uint64_t reservedSize;
   VideoTimestampInfo videoTsInfo;
+  /* Set by the composer on virtual display output buffers */
+  struct WritebackFrameInfo wbFrameInfo;
+  /* Maintained by qdMetaData: layout version, operation holds the DispParamType bits set */
+  uint32_t version;
+  /* Maintained by qdMetaData: bumped on every set or clear, lets readers skip re-parsing */
+  uint32_t generation;
 };
 
 namespace qtigralloc {
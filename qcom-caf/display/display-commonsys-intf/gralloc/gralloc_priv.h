@@ -36,6 +36,7 @@
 #define ENABLE_FB_UBWC_PROP                  GRALLOC_PROP("enable_fb_ubwc")
 #define MAP_FB_MEMORY_PROP                   GRALLOC_PROP("map_fb_memory")
 #define USE_SYSTEM_HEAP_FOR_SENSORS          GRALLOC_PROP("use_system_heap_for_sensors")
+#define ENABLE_BUFFER_POOL_PROP              GRALLOC_PROP("enable_buffer_pool")
 
 #define ROUND_UP_PAGESIZE(x) roundUpToPageSize(x)
 inline int roundUpToPageSize(int x) {
@@ -71,6 +72,11 @@ inline int roundUpToPageSize(int x) {
 #define GRALLOC1_MODULE_PERFORM_GET_BUFFER_SIZE_AND_DIMENSIONS 14
 #define GRALLOC1_MODULE_PERFORM_GET_INTERLACE_FLAG 15
 #define GRALLOC_MODULE_PERFORM_GET_GRAPHICS_METADATA 16
+// Only for processes that never share the buffers they allocate, e.g. the composer
+#define GRALLOC1_MODULE_PERFORM_ENABLE_BUFFER_POOL 17
+// GRALLOC1_FUNCTION_RELEASE with the fence signalling the end of the last hardware access, kept
+// by the caller. A pooled buffer is not recycled before the fence has signalled.
+#define GRALLOC1_MODULE_PERFORM_RELEASE_BUFFER_FENCED 18
 
 /* possible values for inverse gamma correction */
 #define HAL_IGC_NOT_SPECIFIED 0
@@ -84,7 +84,8 @@ enum DispParamType {
     SET_S3D_COMP               = 0x8000,
     SET_CVP_METADATA           = 0x00010000,
     SET_VIDEO_HISTOGRAM_STATS  = 0x00020000,
-    SET_VIDEO_TS_INFO          = 0x00040000
+    SET_VIDEO_TS_INFO          = 0x00040000,
+    SET_WRITEBACK_FRAME_INFO   = 0x00080000
 };
 
 enum DispFetchParamType {
@@ -106,7 +107,8 @@ enum DispFetchParamType {
     GET_S3D_COMP              = 0x8000,
     GET_CVP_METADATA          = 0x00010000,
     GET_VIDEO_HISTOGRAM_STATS = 0x00020000,
-    GET_VIDEO_TS_INFO         = 0x00040000
+    GET_VIDEO_TS_INFO         = 0x00040000,
+    GET_WRITEBACK_FRAME_INFO  = 0x00080000
 };
 
 /* Frame type bit mask */
@@ -134,6 +136,10 @@ int clearMetaDataVa(struct MetaData_t *data, enum DispParamType paramType);
 
 unsigned long getMetaDataSize();
 
+// Returns a counter that changes whenever the metadata of handle is set or cleared through
+// this library. Callers can cache what they parsed from the metadata until it changes.
+int getMetaDataGeneration(struct private_handle_t *handle, uint32_t *generation);
+
 // Map, access metadata and unmap. Used by clients that do not import/free but
 //  clone and delete native_handle
 int setMetaDataAndUnmap(struct private_handle_t *handle, enum DispParamType paramType,
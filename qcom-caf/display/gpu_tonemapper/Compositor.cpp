@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Not a Contribution.
+ *
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/Log.h>
+
+#include "Compositor.h"
+#include "EGLImageWrapper.h"
+#include "blend_shader.inl"
+#include "engine.h"
+
+//-----------------------------------------------------------------------------
+Compositor::Compositor()
+//-----------------------------------------------------------------------------
+{
+  engineContext = 0;
+  programID = 0;
+  dstFramebuffer = 0;
+  eglImageWrapper = new EGLImageWrapper();
+}
+
+//-----------------------------------------------------------------------------
+Compositor::~Compositor()
+//-----------------------------------------------------------------------------
+{
+  engine_bind(engineContext);
+  engine_deleteProgram(programID);
+
+  // clear EGLImage mappings
+  if (eglImageWrapper != 0) {
+    delete eglImageWrapper;
+    eglImageWrapper = 0;
+  }
+
+  engine_shutdown(engineContext);
+}
+
+//-----------------------------------------------------------------------------
+Compositor *Compositor::build(bool isSecure)
+//-----------------------------------------------------------------------------
+{
+  Compositor *compositor = new Compositor();
+
+  compositor->engineContext = engine_initialize(isSecure);
+
+  engine_bind(compositor->engineContext);
+
+  const char *fragmentShaders[2];
+  fragmentShaders[0] = "#version 300 es\n";
+  fragmentShaders[1] = blend_fragment_shader;
+
+  compositor->programID = engine_loadProgram(1, &blend_vertex_shader, 2, fragmentShaders);
+
+  return compositor;
+}
+
+//-----------------------------------------------------------------------------
+void Compositor::begin(const void *dst, int dstFenceFd)
+//-----------------------------------------------------------------------------
+{
+  // make current
+  engine_bind(engineContext);
+
+  EGLImageBuffer *dst_buffer = eglImageWrapper->wrap(dst);
+  if (dst_buffer) {
+    dstFramebuffer = dst_buffer->getFramebuffer();
+    engine_setDestination(dst_buffer->getFramebuffer(), 0, 0, dst_buffer->getWidth(),
+                          dst_buffer->getHeight());
+  }
+  engine_clear(dstFenceFd);
+
+  engine_setProgram(programID);
+  engine_setBlend(true);
+}
+
+//-----------------------------------------------------------------------------
+void Compositor::draw(const void *src, int srcFenceFd, const float *srcCrop, const int *dstRect,
+                      float planeAlpha, int blending)
+//-----------------------------------------------------------------------------
+{
+  EGLImageBuffer *src_buffer = eglImageWrapper->wrap(src);
+  if (!src_buffer || (src_buffer->getWidth() <= 0) || (src_buffer->getHeight() <= 0)) {
+    ALOGE("%s - Invalid source buffer", __FUNCTION__);
+    return;
+  }
+
+  // the viewport places the source, the crop is passed in texture coordinates
+  float width = (float)src_buffer->getWidth();
+  float height = (float)src_buffer->getHeight();
+  float crop[4] = {srcCrop[0] / width, srcCrop[1] / height, srcCrop[2] / width,
+                   srcCrop[3] / height};
+  float alphaMode[2] = {planeAlpha, (float)blending};
+
+  engine_setDestination(dstFramebuffer, dstRect[0], dstRect[1], dstRect[2] - dstRect[0],
+                        dstRect[3] - dstRect[1]);
+  engine_setExternalInputBuffer(0, src_buffer->getTexture());
+  engine_setData4f(5, crop);
+  engine_setData2f(6, alphaMode);
+
+  engine_draw(srcFenceFd);
+}
+
+//-----------------------------------------------------------------------------
+int Compositor::end()
+//-----------------------------------------------------------------------------
+{
+  engine_setBlend(false);
+
+  return engine_createFence();
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Not a Contribution.
+ *
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TONEMAPPER_COMPOSITOR_H__
+#define __TONEMAPPER_COMPOSITOR_H__
+
+#define COMPOSITOR_BLEND_NONE 0
+#define COMPOSITOR_BLEND_PREMULTIPLIED 1
+#define COMPOSITOR_BLEND_COVERAGE 2
+
+#include "EGLImageWrapper.h"
+#include "engine.h"
+
+// Blends several RGBA sources into one destination buffer. Used to pre-compose layers that do
+// not change from frame to frame, so that the display only needs to fetch the result.
+class Compositor {
+ private:
+  void* engineContext;
+  unsigned int programID;
+  unsigned int dstFramebuffer;
+  EGLImageWrapper* eglImageWrapper;
+  Compositor();
+
+ public:
+  ~Compositor();
+  static Compositor *build(bool isSecure);
+  // Clears dst to transparent black and makes it the target of the following draw calls.
+  void begin(const void *dst, int dstFenceFd);
+  // srcCrop is in source pixels and dstRect in destination pixels, both as left, top, right,
+  // bottom. Sources are drawn back to front in call order.
+  void draw(const void *src, int srcFenceFd, const float *srcCrop, const int *dstRect,
+            float planeAlpha, int blending);
+  // Returns a fence which signals once all draws since begin() have completed.
+  int end();
+};
+
+#endif  //__TONEMAPPER_COMPOSITOR_H__
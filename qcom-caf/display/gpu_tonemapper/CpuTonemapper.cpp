@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Not a Contribution.
+ *
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utils/Log.h>
+#include <gralloc_priv.h>
+#if TARGET_ION_ABI_VERSION >= 2
+#include <linux/dma-buf.h>
+#else
+#include <linux/msm_ion.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+
+#include "CpuTonemapper.h"
+#include "Tonemapper.h"
+
+// Rows handed to a worker at a time
+static const int kBandRows = 16;
+static const int kFenceTimeoutMs = 1000;
+
+//-----------------------------------------------------------------------------
+// 4-wide float helpers used for the lut interpolation, one lane per channel
+//-----------------------------------------------------------------------------
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef float32x4_t Vec4;
+static inline Vec4 load4(const float *p) { return vld1q_f32(p); }
+static inline void store4(float *p, Vec4 v) { vst1q_f32(p, v); }
+static inline Vec4 lerp4(Vec4 a, Vec4 b, float t) { return vmlaq_n_f32(a, vsubq_f32(b, a), t); }
+#elif defined(__SSE__)
+typedef __m128 Vec4;
+static inline Vec4 load4(const float *p) { return _mm_loadu_ps(p); }
+static inline void store4(float *p, Vec4 v) { _mm_storeu_ps(p, v); }
+static inline Vec4 lerp4(Vec4 a, Vec4 b, float t)
+{
+  return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+}
+#else
+struct Vec4 {
+  float v[4];
+};
+static inline Vec4 load4(const float *p)
+{
+  Vec4 r = {{p[0], p[1], p[2], p[3]}};
+  return r;
+}
+static inline void store4(float *p, Vec4 v) { memcpy(p, v.v, sizeof(v.v)); }
+static inline Vec4 lerp4(Vec4 a, Vec4 b, float t)
+{
+  for (int i = 0; i < 4; i++) {
+    a.v[i] += (b.v[i] - a.v[i]) * t;
+  }
+  return a;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Maps a normalized coordinate to the two texels and weight GL_LINEAR with
+// CLAMP_TO_EDGE would use once the shader's scale/offset is applied
+//-----------------------------------------------------------------------------
+static inline void lutCoord(float v, int size, int *i0, int *i1, float *frac)
+{
+  float pos = std::min(std::max(v, 0.0f), 1.0f) * (float)(size - 1);
+  int i = (int)pos;
+  *i0 = i;
+  *i1 = std::min(i + 1, size - 1);
+  *frac = pos - (float)i;
+}
+
+//-----------------------------------------------------------------------------
+static void unpackColor10(const void *data, int count, std::vector<float> *out)
+//-----------------------------------------------------------------------------
+{
+  const uint32_t *packed = reinterpret_cast<const uint32_t *>(data);
+  out->resize((size_t)count * 4);
+  for (int i = 0; i < count; i++) {
+    uint32_t c = packed[i];
+    (*out)[i * 4 + 0] = (float)(c & 0x3FF) / 1023.0f;
+    (*out)[i * 4 + 1] = (float)((c >> 10) & 0x3FF) / 1023.0f;
+    (*out)[i * 4 + 2] = (float)((c >> 20) & 0x3FF) / 1023.0f;
+    (*out)[i * 4 + 3] = 0.0f;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static inline bool is10Bit(int format)
+//-----------------------------------------------------------------------------
+{
+  return (format == HAL_PIXEL_FORMAT_RGBA_1010102) || (format == HAL_PIXEL_FORMAT_RGBX_1010102);
+}
+
+//-----------------------------------------------------------------------------
+static inline void readPixel(int format, const uint8_t *row, int x, uint32_t *rgb, float *alpha)
+//-----------------------------------------------------------------------------
+{
+  if (is10Bit(format)) {
+    uint32_t c;
+    memcpy(&c, row + x * 4, sizeof(c));
+    rgb[0] = c & 0x3FF;
+    rgb[1] = (c >> 10) & 0x3FF;
+    rgb[2] = (c >> 20) & 0x3FF;
+    *alpha = (format == HAL_PIXEL_FORMAT_RGBA_1010102) ? (float)(c >> 30) / 3.0f : 1.0f;
+  } else {
+    const uint8_t *p = row + x * 4;
+    rgb[0] = p[0];
+    rgb[1] = p[1];
+    rgb[2] = p[2];
+    *alpha = (format == HAL_PIXEL_FORMAT_RGBA_8888) ? (float)p[3] / 255.0f : 1.0f;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static inline uint32_t quantize(float v, float max)
+//-----------------------------------------------------------------------------
+{
+  return (uint32_t)(std::min(std::max(v, 0.0f), 1.0f) * max + 0.5f);
+}
+
+//-----------------------------------------------------------------------------
+static inline void writePixel(int format, uint8_t *row, int x, const float *rgba)
+//-----------------------------------------------------------------------------
+{
+  switch (format) {
+    case HAL_PIXEL_FORMAT_RGBA_1010102:
+    case HAL_PIXEL_FORMAT_RGBX_1010102: {
+      uint32_t c = quantize(rgba[0], 1023.0f) | (quantize(rgba[1], 1023.0f) << 10) |
+                   (quantize(rgba[2], 1023.0f) << 20) | (quantize(rgba[3], 3.0f) << 30);
+      memcpy(row + x * 4, &c, sizeof(c));
+    } break;
+    default: {
+      uint8_t *p = row + x * 4;
+      p[0] = (uint8_t)quantize(rgba[0], 255.0f);
+      p[1] = (uint8_t)quantize(rgba[1], 255.0f);
+      p[2] = (uint8_t)quantize(rgba[2], 255.0f);
+      p[3] = (uint8_t)quantize(rgba[3], 255.0f);
+    } break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+CpuTonemapper::CpuTonemapper()
+//-----------------------------------------------------------------------------
+{
+  type = TONEMAP_FORWARD;
+  lut3dSize = 0;
+  lutXformSize = 0;
+  bandJob = NULL;
+  jobRows = 0;
+  nextBand = 0;
+  activeHelpers = 0;
+  ionFd = -1;
+  for (BandTask &task : bandTasks) {
+    task.owner = this;
+  }
+}
+
+//-----------------------------------------------------------------------------
+CpuTonemapper::~CpuTonemapper()
+//-----------------------------------------------------------------------------
+{
+  // A band task still queued behind other general work finds no job and returns
+  for (BandTask &task : bandTasks) {
+    task.Wait();
+  }
+  if (ionFd >= 0) {
+    close(ionFd);
+  }
+}
+
+//-----------------------------------------------------------------------------
+CpuTonemapper *CpuTonemapper::build(int type, void *colorMap, int colorMapSize, void *lutXform,
+                                    int lutXformSize)
+//-----------------------------------------------------------------------------
+{
+  if (!colorMap || colorMapSize <= 0) {
+    ALOGE("Invalid Color Map size = %d", colorMapSize);
+    return NULL;
+  }
+
+  CpuTonemapper *tonemapper = new CpuTonemapper();
+#if !(TARGET_ION_ABI_VERSION >= 2)
+  // Cache maintenance of cached buffers goes through the legacy ion device
+  tonemapper->ionFd = open("/dev/ion", O_RDONLY | O_CLOEXEC);
+  if (tonemapper->ionFd < 0) {
+    ALOGE("%s: failed to open /dev/ion - %s", __FUNCTION__, strerror(errno));
+    delete tonemapper;
+    return NULL;
+  }
+#endif
+  tonemapper->type = type;
+  tonemapper->lut3dSize = colorMapSize;
+  unpackColor10(colorMap, colorMapSize * colorMapSize * colorMapSize, &tonemapper->lut3d);
+
+  if (lutXform && lutXformSize > 0) {
+    tonemapper->lutXformSize = lutXformSize;
+    unpackColor10(lutXform, lutXformSize, &tonemapper->lutXform);
+  }
+
+  // Every 8 and 10 bit channel code maps to a fixed lut position, resolve them once
+  tonemapper->axisTable8.resize(3 * 256);
+  tonemapper->axisTable10.resize(3 * 1024);
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < 256; i++) {
+      tonemapper->axisTable8[c * 256 + i] = tonemapper->axisSample((float)i / 255.0f, c);
+    }
+    for (int i = 0; i < 1024; i++) {
+      tonemapper->axisTable10[c * 1024 + i] = tonemapper->axisSample((float)i / 1023.0f, c);
+    }
+  }
+
+  return tonemapper;
+}
+
+//-----------------------------------------------------------------------------
+bool CpuTonemapper::isFormatSupported(int format)
+//-----------------------------------------------------------------------------
+{
+  switch (format) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+    case HAL_PIXEL_FORMAT_RGBA_1010102:
+    case HAL_PIXEL_FORMAT_RGBX_1010102:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+static void *mapHandle(const private_handle_t *hnd, bool *mapped)
+//-----------------------------------------------------------------------------
+{
+  *mapped = false;
+  if (hnd->base) {
+    return reinterpret_cast<void *>(hnd->base);
+  }
+
+  void *addr = mmap(NULL, hnd->size, PROT_READ | PROT_WRITE, MAP_SHARED, hnd->fd, 0);
+  if (addr == MAP_FAILED) {
+    ALOGE("%s: mmap failed for fd %d - %s", __FUNCTION__, hnd->fd, strerror(errno));
+    return NULL;
+  }
+  *mapped = true;
+  return addr;
+}
+
+//-----------------------------------------------------------------------------
+int CpuTonemapper::syncHandle(const private_handle_t *hnd, void *base, bool start, bool write)
+//-----------------------------------------------------------------------------
+{
+  // Uncached buffers are coherent with the cpu already
+  if (!(hnd->flags & private_handle_t::PRIV_FLAGS_CACHED)) {
+    return 0;
+  }
+
+#if TARGET_ION_ABI_VERSION >= 2
+  (void)base;
+  struct dma_buf_sync sync;
+  sync.flags = (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END) |
+               (write ? DMA_BUF_SYNC_WRITE : DMA_BUF_SYNC_READ);
+  if (ioctl(hnd->fd, DMA_BUF_IOCTL_SYNC, &sync)) {
+    int err = -errno;
+    ALOGE("%s: DMA_BUF_IOCTL_SYNC failed for fd %d - %s", __FUNCTION__, hnd->fd, strerror(errno));
+    return err;
+  }
+  return 0;
+#else
+  // The source is invalidated before it is read, the destination is cleaned once written
+  bool invalidate = start && !write;
+  bool clean = !start && write;
+  if (!invalidate && !clean) {
+    return 0;
+  }
+
+  struct ion_fd_data fd_data;
+  memset(&fd_data, 0, sizeof(fd_data));
+  fd_data.fd = hnd->fd;
+  if (ioctl(ionFd, ION_IOC_IMPORT, &fd_data)) {
+    int err = -errno;
+    ALOGE("%s: ION_IOC_IMPORT failed for fd %d - %s", __FUNCTION__, hnd->fd, strerror(errno));
+    return err;
+  }
+
+  struct ion_flush_data flush_data;
+  memset(&flush_data, 0, sizeof(flush_data));
+  flush_data.handle = fd_data.handle;
+  flush_data.vaddr = base;
+  flush_data.offset = 0;
+  flush_data.length = hnd->size;
+
+  struct ion_custom_data custom_data;
+  custom_data.cmd = clean ? ION_IOC_CLEAN_CACHES : ION_IOC_INV_CACHES;
+  custom_data.arg = (unsigned long)(&flush_data);  // NOLINT
+  int err = 0;
+  if (ioctl(ionFd, ION_IOC_CUSTOM, &custom_data)) {
+    err = -errno;
+    ALOGE("%s: ion cache operation failed for fd %d - %s", __FUNCTION__, hnd->fd, strerror(errno));
+  }
+
+  struct ion_handle_data handle_data;
+  handle_data.handle = fd_data.handle;
+  ioctl(ionFd, ION_IOC_FREE, &handle_data);
+  return err;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+int CpuTonemapper::blit(const void *dst, const void *src, int srcFenceFd)
+//-----------------------------------------------------------------------------
+{
+  const private_handle_t *dst_hnd = static_cast<const private_handle_t *>(dst);
+  const private_handle_t *src_hnd = static_cast<const private_handle_t *>(src);
+  if (!dst_hnd || !src_hnd) {
+    return -EINVAL;
+  }
+
+  // Compressed and secure buffers cannot be accessed from the cpu
+  const int inaccessible = private_handle_t::PRIV_FLAGS_UBWC_ALIGNED |
+                           private_handle_t::PRIV_FLAGS_SECURE_BUFFER;
+  if ((dst_hnd->flags & inaccessible) || (src_hnd->flags & inaccessible) ||
+      !isFormatSupported(dst_hnd->format) || !isFormatSupported(src_hnd->format)) {
+    ALOGE("%s: unsupported buffers src format 0x%x flags 0x%x, dst format 0x%x flags 0x%x",
+          __FUNCTION__, src_hnd->format, src_hnd->flags, dst_hnd->format, dst_hnd->flags);
+    return -EINVAL;
+  }
+
+  if (srcFenceFd >= 0) {
+    struct pollfd fds = {srcFenceFd, POLLIN, 0};
+    if (poll(&fds, 1, kFenceTimeoutMs) <= 0) {
+      ALOGE("%s: wait on source fence %d failed", __FUNCTION__, srcFenceFd);
+      return -ETIMEDOUT;
+    }
+  }
+
+  int err = -ENOMEM;
+  bool src_mapped = false, dst_mapped = false;
+  void *src_base = mapHandle(src_hnd, &src_mapped);
+  void *dst_base = mapHandle(dst_hnd, &dst_mapped);
+  if (src_base && dst_base) {
+    Image src_image = {src_base, src_hnd->unaligned_width, src_hnd->unaligned_height,
+                       src_hnd->width, src_hnd->format};
+    Image dst_image = {dst_base, dst_hnd->unaligned_width, dst_hnd->unaligned_height,
+                       dst_hnd->width, dst_hnd->format};
+    err = syncHandle(src_hnd, src_base, true, false);
+    if (!err) {
+      err = syncHandle(dst_hnd, dst_base, true, true);
+    }
+    if (!err) {
+      err = blitImage(dst_image, src_image);
+    }
+    if (!err) {
+      err = syncHandle(dst_hnd, dst_base, false, true);
+    }
+    if (!err) {
+      err = syncHandle(src_hnd, src_base, false, false);
+    }
+  }
+
+  if (src_mapped) {
+    munmap(src_base, src_hnd->size);
+  }
+  if (dst_mapped) {
+    munmap(dst_base, dst_hnd->size);
+  }
+
+  return err;
+}
+
+//-----------------------------------------------------------------------------
+int CpuTonemapper::blitImage(const Image &dst, const Image &src)
+//-----------------------------------------------------------------------------
+{
+  int rows = std::min(dst.height, src.height);
+  if (!lut3dSize || rows <= 0) {
+    return -EINVAL;
+  }
+
+  std::function<void(int, int)> job = [&](int first, int last) {
+    processRows(dst, src, first, last);
+  };
+  runBands(rows, job);
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+CpuTonemapper::AxisSample CpuTonemapper::axisSample(float v, int channel) const
+//-----------------------------------------------------------------------------
+{
+  // Non-uniform sampling, each channel goes through its own 1D xform first
+  if (lutXformSize) {
+    int i0, i1;
+    float f;
+    lutCoord(v, lutXformSize, &i0, &i1, &f);
+    float v0 = lutXform[(size_t)i0 * 4 + channel];
+    v = v0 + (lutXform[(size_t)i1 * 4 + channel] - v0) * f;
+  }
+
+  // r runs along the innermost dimension of the 3D lut, b along the outermost
+  uint32_t stride = 4;
+  for (int c = 0; c < channel; c++) {
+    stride *= (uint32_t)lut3dSize;
+  }
+
+  AxisSample sample;
+  int i0, i1;
+  lutCoord(v, lut3dSize, &i0, &i1, &sample.frac);
+  sample.lo = (uint32_t)i0 * stride;
+  sample.hi = (uint32_t)i1 * stride;
+  return sample;
+}
+
+//-----------------------------------------------------------------------------
+void CpuTonemapper::processRows(const Image &dst, const Image &src, int firstRow, int lastRow)
+//-----------------------------------------------------------------------------
+{
+  const int width = std::min(dst.width, src.width);
+  const bool inverse = (type == TONEMAP_INVERSE);
+  const bool deep = is10Bit(src.format);
+  const float maxCode = deep ? 1023.0f : 255.0f;
+  const AxisSample *table = deep ? axisTable10.data() : axisTable8.data();
+  const uint32_t codes = deep ? 1024 : 256;
+  const float *lut = lut3d.data();
+
+  for (int y = firstRow; y < lastRow; y++) {
+    const uint8_t *src_row = static_cast<const uint8_t *>(src.pixels) + (size_t)y * src.stride * 4;
+    uint8_t *dst_row = static_cast<uint8_t *>(dst.pixels) + (size_t)y * dst.stride * 4;
+
+    for (int x = 0; x < width; x++) {
+      uint32_t rgb[3];
+      float alpha;
+      readPixel(src.format, src_row, x, rgb, &alpha);
+
+      AxisSample r, g, b;
+      if (inverse && alpha < 1.0f) {
+        // The inverse shader works on straight alpha and passes transparent pixels through
+        if (alpha <= 0.0f) {
+          float rgba[4] = {rgb[0] / maxCode, rgb[1] / maxCode, rgb[2] / maxCode, alpha};
+          writePixel(dst.format, dst_row, x, rgba);
+          continue;
+        }
+        float scale = 1.0f / (alpha * maxCode);
+        r = axisSample(rgb[0] * scale, 0);
+        g = axisSample(rgb[1] * scale, 1);
+        b = axisSample(rgb[2] * scale, 2);
+      } else {
+        r = table[rgb[0]];
+        g = table[codes + rgb[1]];
+        b = table[2 * codes + rgb[2]];
+      }
+
+      // Trilinear 3D lut sample, all three channels interpolated at once
+      const float *p00 = lut + g.lo + b.lo;
+      const float *p01 = lut + g.hi + b.lo;
+      const float *p10 = lut + g.lo + b.hi;
+      const float *p11 = lut + g.hi + b.hi;
+      Vec4 c00 = lerp4(load4(p00 + r.lo), load4(p00 + r.hi), r.frac);
+      Vec4 c01 = lerp4(load4(p01 + r.lo), load4(p01 + r.hi), r.frac);
+      Vec4 c10 = lerp4(load4(p10 + r.lo), load4(p10 + r.hi), r.frac);
+      Vec4 c11 = lerp4(load4(p11 + r.lo), load4(p11 + r.hi), r.frac);
+      Vec4 out = lerp4(lerp4(c00, c01, g.frac), lerp4(c10, c11, g.frac), b.frac);
+
+      float result[4];
+      store4(result, out);
+      if (inverse) {
+        result[0] *= alpha;
+        result[1] *= alpha;
+        result[2] *= alpha;
+      }
+      // The forward shader leaves alpha unwritten, keep the source alpha
+      result[3] = alpha;
+      writePixel(dst.format, dst_row, x, result);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void CpuTonemapper::runBands(int rows, const std::function<void(int, int)> &job)
+//-----------------------------------------------------------------------------
+{
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    bandJob = &job;
+    jobRows = rows;
+    nextBand = 0;
+  }
+
+  // A task from an earlier blit which has not run yet joins this job once it does
+  for (BandTask &task : bandTasks) {
+    if (task.IsDone()) {
+      sdm::WorkerPool::Get()->Submit(sdm::WorkerPool::kLaneGeneral, &task);
+    }
+  }
+
+  runPendingBands();
+
+  // Only helpers working on a band are waited for, a general worker held up by a present never
+  // delays the blit
+  std::unique_lock<std::mutex> lock(jobMutex);
+  bandJob = NULL;
+  doneCond.wait(lock, [this] { return activeHelpers == 0; });
+}
+
+//-----------------------------------------------------------------------------
+void CpuTonemapper::runPendingBands()
+//-----------------------------------------------------------------------------
+{
+  while (true) {
+    int first = nextBand.fetch_add(1) * kBandRows;
+    if (first >= jobRows) {
+      break;
+    }
+    (*bandJob)(first, std::min(first + kBandRows, jobRows));
+  }
+}
+
+//-----------------------------------------------------------------------------
+void CpuTonemapper::helpBands()
+//-----------------------------------------------------------------------------
+{
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    if (!bandJob) {
+      return;
+    }
+    activeHelpers++;
+  }
+
+  runPendingBands();
+
+  std::lock_guard<std::mutex> lock(jobMutex);
+  if (--activeHelpers == 0) {
+    doneCond.notify_one();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void CpuTonemapper::BandTask::Run()
+//-----------------------------------------------------------------------------
+{
+  owner->helpBands();
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Not a Contribution.
+ *
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TONEMAPPER_CPUTONEMAPPER_H__
+#define __TONEMAPPER_CPUTONEMAPPER_H__
+
+#include <stdint.h>
+#include <utils/worker_pool.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct private_handle_t;
+
+// CPU version of the forward/inverse tonemap shaders. Applies the same
+// scale/offset, 1D xform lookup and trilinear 3D lut sample to linear
+// RGBA8888 and RGBA1010102 buffers, with the rows split in bands between
+// the calling thread and the general lane of the SDM WorkerPool. Used when
+// the GLES engine is not available or not wanted for the layer.
+class CpuTonemapper {
+ public:
+  struct Image {
+    void *pixels;
+    int width;
+    int height;
+    int stride;  // in pixels
+    int format;
+  };
+
+  ~CpuTonemapper();
+  static CpuTonemapper *build(int type, void *colorMap, int colorMapSize, void *lutXform,
+                              int lutXformSize);
+  static bool isFormatSupported(int format);
+  // Unlike Tonemapper::blit no fence is returned, the output is complete when the
+  // call returns. Returns 0 on success or a negative errno. srcFenceFd stays owned
+  // by the caller.
+  int blit(const void *dst, const void *src, int srcFenceFd);
+  int blitImage(const Image &dst, const Image &src);
+
+ private:
+  // Position of a channel value along its 3D lut axis: offsets of the two
+  // neighbouring slices, in floats, and the weight between them
+  struct AxisSample {
+    uint32_t lo;
+    uint32_t hi;
+    float frac;
+  };
+
+  // One per general worker, each takes bands of the current job next to the calling thread
+  static const int kNumBandTasks = 2;
+
+  class BandTask : public sdm::WorkerTask {
+   public:
+    CpuTonemapper *owner = NULL;
+
+   protected:
+    void Run();
+  };
+
+  CpuTonemapper();
+  int syncHandle(const private_handle_t *hnd, void *base, bool start, bool write);
+  AxisSample axisSample(float v, int channel) const;
+  void processRows(const Image &dst, const Image &src, int firstRow, int lastRow);
+  void runBands(int rows, const std::function<void(int, int)> &job);
+  void runPendingBands();
+  void helpBands();
+
+  int type;
+  int lut3dSize;
+  int lutXformSize;
+  // rgb + pad per entry so an entry can be loaded as one vector
+  std::vector<float> lut3d;
+  std::vector<float> lutXform;
+  // axisSample() of every 8 and 10 bit code, per channel
+  std::vector<AxisSample> axisTable8;
+  std::vector<AxisSample> axisTable10;
+
+  BandTask bandTasks[kNumBandTasks];
+  std::mutex jobMutex;
+  std::condition_variable doneCond;
+  const std::function<void(int, int)> *bandJob;
+  int jobRows;
+  std::atomic<int> nextBand;
+  uint32_t activeHelpers;
+  int ionFd;
+};
+
+#endif  //__TONEMAPPER_CPUTONEMAPPER_H__
@@ -32,3 +32,18 @@ Tonemapper *TonemapperFactory_GetInstance(int type, void *colorMap, int colorMap
 
   return tonemapper;
 }
+
+//----------------------------------------------------------------------------------------------------------------------------------------------------------
+CpuTonemapper *TonemapperFactory_GetCpuInstance(int type, void *colorMap, int colorMapSize,
+                                                void *lutXform, int lutXformSize)
+//----------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+  return CpuTonemapper::build(type, colorMap, colorMapSize, lutXform, lutXformSize);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------------------------------
+Compositor *TonemapperFactory_GetCompositor(bool isSecure)
+//----------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+  return Compositor::build(isSecure);
+}
@@ -20,6 +20,8 @@
 #ifndef __TONEMAPPER_TONEMAPPERFACTORY_H__
 #define __TONEMAPPER_TONEMAPPERFACTORY_H__
 
+#include "Compositor.h"
+#include "CpuTonemapper.h"
 #include "Tonemapper.h"
 
 #ifdef __cplusplus
@@ -30,6 +32,13 @@ extern "C" {
 Tonemapper *TonemapperFactory_GetInstance(int type, void *colorMap, int colorMapSize,
                                           void *lutXform, int lutXformSize, bool isSecure);
 
+// returns an instance of the CPU Tonemapper, non-secure linear RGBA buffers only
+CpuTonemapper *TonemapperFactory_GetCpuInstance(int type, void *colorMap, int colorMapSize,
+                                                void *lutXform, int lutXformSize);
+
+// returns an instance of the GPU layer compositor
+Compositor *TonemapperFactory_GetCompositor(bool isSecure);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Not a Contribution.
+ *
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+const char* blend_vertex_shader = "                                           "
+"#version 300 es                                                            \n"
+"precision highp float;                                                     \n"
+"layout(location = 0) in vec2 iUV;                                          \n"
+"out vec2 uv;                                                               \n"
+"void main()                                                                \n"
+"{                                                                          \n"
+"    vec2 positions[3];                                                     \n"
+"    positions[0] = vec2(-1.0f, 3.0f);                                      \n"
+"    positions[1] = vec2(-1.0f, -1.0f);                                     \n"
+"    positions[2] = vec2(3.0f, -1.0f);                                      \n"
+"    vec2 uvs[3];                                                           \n"
+"    uvs[0] = vec2(0.0f, 2.0f);                                             \n"
+"    uvs[1] = vec2(0.0f, 0.0f);                                             \n"
+"    uvs[2] = vec2(2.0f, 0.0f);                                             \n"
+"    gl_Position = vec4(positions[gl_VertexID], -1.0f, 1.0f);               \n"
+"    uv = uvs[gl_VertexID];                                                 \n"
+"}                                                                          \n";
+
+const char* blend_fragment_shader = ""
+    "#extension GL_OES_EGL_image_external_essl3 : require                       \n"
+    "precision highp float;                                                     \n"
+    "layout(binding = 0) uniform samplerExternalOES externalTexture;            \n"
+    "layout(location = 5) uniform vec4 crop;                                    \n"
+    "layout(location = 6) uniform vec2 alphaMode;                               \n"
+    "in vec2 uv;                                                                \n"
+    "out vec4 fs_color;                                                         \n"
+    "                                                                           \n"
+    "void main()                                                                \n"
+    "{                                                                          \n"
+    "vec4 rgba = texture(externalTexture, mix(crop.xy, crop.zw, uv));           \n"
+    "if (alphaMode.y == 0.0f) {                                                 \n"
+    "   rgba.a = 1.0f;                                                          \n"
+    "} else if (alphaMode.y == 2.0f) {                                          \n"
+    "   rgba.rgb *= rgba.a;                                                     \n"
+    "}                                                                          \n"
+    "fs_color = rgba * alphaMode.x;                                             \n"
+    "}                                                                          \n";
@@ -37,7 +37,12 @@ void engine_set3DInputBuffer(int binding, unsigned int textureID);
 void engine_setExternalInputBuffer(int binding, unsigned int textureID);
 void engine_setDestination(int id, int x, int y, int w, int h);
 void engine_setData2f(int loc, float* data);
+void engine_setData4f(int loc, float* data);
+void engine_setBlend(bool enable);
+void engine_clear(int);
 
 int engine_blit(int);
+void engine_draw(int);
+int engine_createFence();
 
 #endif  //__TONEMAPPER_ENGINE_H__
@@ -23,6 +23,7 @@
 
 void checkGlError(const char *, int);
 void checkEglError(const char *, int);
+void WaitOnNativeFence(int);
 
 class EngineContext {
     public:
@@ -134,6 +135,35 @@ void engine_setData2f(int location, float* data)
     GL(glUniform2f(location, data[0], data[1]));
 }
 
+//-----------------------------------------------------------------------------
+void engine_setData4f(int location, float* data)
+//-----------------------------------------------------------------------------
+{
+    GL(glUniform4f(location, data[0], data[1], data[2], data[3]));
+}
+
+//-----------------------------------------------------------------------------
+void engine_setBlend(bool enable)
+//-----------------------------------------------------------------------------
+{
+  if (enable) {
+    // sources are premultiplied by the shader
+    GL(glEnable(GL_BLEND));
+    GL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+  } else {
+    GL(glDisable(GL_BLEND));
+  }
+}
+
+//-----------------------------------------------------------------------------
+void engine_clear(int dstFenceFd)
+//-----------------------------------------------------------------------------
+{
+  WaitOnNativeFence(dstFenceFd);
+  GL(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+  GL(glClear(GL_COLOR_BUFFER_BIT));
+}
+
 //-----------------------------------------------------------------------------
 unsigned int engine_load3DTexture(void *colorMapData, int sz, int format)
 //-----------------------------------------------------------------------------
@@ -310,6 +340,26 @@ int engine_blit(int srcFenceFd)
   return fd;
 }
 
+//-----------------------------------------------------------------------------
+void engine_draw(int srcFenceFd)
+//-----------------------------------------------------------------------------
+{
+  WaitOnNativeFence(srcFenceFd);
+  float fullscreen_vertices[]{0.0f, 2.0f, 0.0f, 0.0f, 2.0f, 0.0f};
+  GL(glEnableVertexAttribArray(0));
+  GL(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, fullscreen_vertices));
+  GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+}
+
+//-----------------------------------------------------------------------------
+int engine_createFence()
+//-----------------------------------------------------------------------------
+{
+  int fd = CreateNativeFence();
+  GL(glFlush());
+  return fd;
+}
+
 //-----------------------------------------------------------------------------
 void checkGlError(const char *file, int line)
 //-----------------------------------------------------------------------------
@@ -38,6 +38,7 @@ LOCAL_CLANG                   := true
 LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps) $(kernel_deps)
 LOCAL_SRC_FILES               := gr_ion_alloc.cpp \
                                  gr_allocator.cpp \
+                                 gr_buf_pool.cpp \
                                  gr_buf_mgr.cpp \
                                  gr_device_impl.cpp
 
@@ -27,7 +27,9 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cutils/properties.h>
 #include <log/log.h>
+#include <string.h>
 #include <algorithm>
 #include <vector>
 
@@ -80,6 +82,10 @@ using std::shared_ptr;
 
 namespace gralloc1 {
 
+// Upper bounds on the memory parked in the recycling pool and on how long it stays there
+static const uint64_t kBufferPoolMaxBytes = 32 * 1024 * 1024;
+static const uint32_t kBufferPoolMaxAgeMs = 2000;
+
 static BufferInfo GetBufferInfo(const BufferDescriptor &descriptor) {
   return BufferInfo(descriptor.GetWidth(), descriptor.GetHeight(), descriptor.GetFormat(),
                     descriptor.GetProducerUsage(), descriptor.GetConsumerUsage());
@@ -97,14 +103,31 @@ bool Allocator::Init() {
   return true;
 }
 
+void Allocator::EnableBufferPool() {
+  // The property only acts as a global switch, the pool is never created unless the process
+  // asked for it. Buffers allocated before this call are not tracked and are freed as usual.
+  std::call_once(buffer_pool_once_, [this] {
+    char property[PROPERTY_VALUE_MAX];
+    if ((property_get(ENABLE_BUFFER_POOL_PROP, property, NULL) > 0) &&
+        (!strncmp(property, "1", PROPERTY_VALUE_MAX) ||
+         (!strncasecmp(property, "true", PROPERTY_VALUE_MAX)))) {
+      buffer_pool_ = new BufferPool(ion_allocator_, kBufferPoolMaxBytes, kBufferPoolMaxAgeMs);
+    }
+  });
+}
+
 Allocator::~Allocator() {
+  BufferPool *buffer_pool = buffer_pool_.load();
+  if (buffer_pool) {
+    delete buffer_pool;
+  }
   if (ion_allocator_) {
     delete ion_allocator_;
   }
 }
 
 int Allocator::AllocateMem(AllocData *alloc_data, gralloc1_producer_usage_t prod_usage,
-                           gralloc1_consumer_usage_t cons_usage) {
+                           gralloc1_consumer_usage_t cons_usage, bool use_pool) {
   int ret;
   alloc_data->uncached = UseUncached(prod_usage, cons_usage);
 
@@ -112,6 +135,12 @@ int Allocator::AllocateMem(AllocData *alloc_data, gralloc1_producer_usage_t prod
   GetIonHeapInfo(prod_usage, cons_usage, &alloc_data->heap_id, &alloc_data->alloc_type,
                  &alloc_data->flags);
 
+  BufferPool *buffer_pool = use_pool ? buffer_pool_.load() : NULL;
+  if (buffer_pool && buffer_pool->Acquire(alloc_data)) {
+    alloc_data->alloc_type |= private_handle_t::PRIV_FLAGS_USES_ION;
+    return 0;
+  }
+
   ret = ion_allocator_->AllocBuffer(alloc_data);
   if (ret >= 0) {
     alloc_data->alloc_type |= private_handle_t::PRIV_FLAGS_USES_ION;
@@ -138,8 +167,34 @@ int Allocator::ImportBuffer(int fd) {
   return -EINVAL;
 }
 
+bool Allocator::TrackPooledBuffer(uint64_t buffer_id, const AllocData &data) {
+  BufferPool *buffer_pool = buffer_pool_.load();
+  return buffer_pool && buffer_pool->Track(buffer_id, data);
+}
+
+int Allocator::FreePooledBuffer(uint64_t buffer_id, void *base, unsigned int size,
+                                unsigned int offset, int fd, int handle, int release_fence) {
+  BufferPool *buffer_pool = buffer_pool_.load();
+  if (buffer_pool &&
+      buffer_pool->Release(buffer_id, base, size, offset, fd, handle, release_fence)) {
+    return 0;
+  }
+
+  if (ion_allocator_) {
+    return ion_allocator_->FreeBuffer(base, size, offset, fd, handle);
+  }
+
+  return -EINVAL;
+}
+
 int Allocator::FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd,
                           int handle) {
+  // Parked buffers also age out on frees that do not go through the pool
+  BufferPool *buffer_pool = buffer_pool_.load();
+  if (buffer_pool) {
+    buffer_pool->Trim();
+  }
+
   if (ion_allocator_) {
     return ion_allocator_->FreeBuffer(base, size, offset, fd, handle);
   }
@@ -320,4 +375,11 @@ void Allocator::GetIonHeapInfo(gralloc1_producer_usage_t prod_usage,
 
   return;
 }
+void Allocator::Dump(std::ostringstream *os) {
+  BufferPool *buffer_pool = buffer_pool_.load();
+  if (buffer_pool) {
+    buffer_pool->Dump(os);
+  }
+}
+
 }  // namespace gralloc1
@@ -29,10 +29,14 @@
 #ifndef __GR_ALLOCATOR_H__
 #define __GR_ALLOCATOR_H__
 
+#include <atomic>
+#include <mutex>
+#include <sstream>
 #include <vector>
 
 #include "gralloc_priv.h"
 #include "gr_buf_descriptor.h"
+#include "gr_buf_pool.h"
 #include "gr_ion_alloc.h"
 #include "gr_utils.h"
 
@@ -43,12 +47,18 @@ class Allocator {
   Allocator();
   ~Allocator();
   bool Init();
+  // Opt-in for processes that exclusively own the buffers they allocate, see BufferPool
+  void EnableBufferPool();
   int MapBuffer(void **base, unsigned int size, unsigned int offset, int fd);
   int ImportBuffer(int fd);
   int FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd, int handle);
   int CleanBuffer(void *base, unsigned int size, unsigned int offset, int handle, int op, int fd);
   int AllocateMem(AllocData *data, gralloc1_producer_usage_t prod_usage,
-                  gralloc1_consumer_usage_t cons_usage);
+                  gralloc1_consumer_usage_t cons_usage, bool use_pool = false);
+  // Returns true if the buffer is tracked by the pool and must be freed with FreePooledBuffer
+  bool TrackPooledBuffer(uint64_t buffer_id, const AllocData &data);
+  int FreePooledBuffer(uint64_t buffer_id, void *base, unsigned int size, unsigned int offset,
+                       int fd, int handle, int release_fence = -1);
   // @return : index of the descriptor with maximum buffer size req
   bool CheckForBufferSharing(uint32_t num_descriptors,
                              const std::vector<std::shared_ptr<BufferDescriptor>>& descriptors,
@@ -56,12 +66,16 @@ class Allocator {
   int GetImplDefinedFormat(gralloc1_producer_usage_t prod_usage,
                            gralloc1_consumer_usage_t cons_usage, int format);
   bool UseUncached(gralloc1_producer_usage_t prod_usage, gralloc1_consumer_usage_t cons_usage);
+  void Dump(std::ostringstream *os);
 
  private:
   void GetIonHeapInfo(gralloc1_producer_usage_t prod_usage, gralloc1_consumer_usage_t cons_usage,
                       unsigned int *ion_heap_id, unsigned int *alloc_type, unsigned int *ion_flags);
 
   IonAlloc *ion_allocator_ = NULL;
+  std::once_flag buffer_pool_once_;
+  // Published once by EnableBufferPool() and read without the once flag afterwards
+  std::atomic<BufferPool *> buffer_pool_ = {nullptr};
 };
 
 }  // namespace gralloc1
@@ -19,6 +19,8 @@
 
 #define DEBUG 0
 
+#include <unistd.h>
+
 #include <iomanip>
 #include <utility>
 #include <vector>
@@ -49,7 +51,6 @@ BufferManager::BufferManager() : next_id_(0) {
     map_fb_mem_ = true;
   }
 
-  handles_map_.clear();
   allocator_ = new Allocator();
   allocator_->Init();
 }
@@ -121,7 +122,6 @@ gralloc1_error_t BufferManager::AllocateBuffers(uint32_t num_descriptors,
     return status;
   }
 
-  std::lock_guard<std::mutex> buffer_lock(buffer_lock_);
   if (shared && (max_buf_index >= 0)) {
     // Allocate one and duplicate/copy the handles for each descriptor
     if (AllocateBuffer(*descriptors[UINT(max_buf_index)], &out_buffers[max_buf_index])) {
@@ -183,13 +183,13 @@ void BufferManager::CreateSharedHandle(buffer_handle_t inbuffer, const BufferDes
                                                    buffer_type,
                                                    input->size,
                                                    (descriptor.GetProducerUsage() | descriptor.GetConsumerUsage()));
-  out_hnd->id = ++next_id_;
+  out_hnd->id = GetNextId();
   // TODO(user): Base address of shared handle and ion handles
-  RegisterHandleLocked(out_hnd, -1, -1);
+  RegisterHandle(out_hnd, -1, -1);
   *outbuffer = out_hnd;
 }
 
-gralloc1_error_t BufferManager::FreeBuffer(std::shared_ptr<Buffer> buf) {
+gralloc1_error_t BufferManager::FreeBuffer(std::shared_ptr<Buffer> buf, int release_fence) {
   auto hnd = buf->handle;
   ALOGD_IF(DEBUG, "FreeBuffer handle:%p", hnd);
 
@@ -198,8 +198,17 @@ gralloc1_error_t BufferManager::FreeBuffer(std::shared_ptr<Buffer> buf) {
     return GRALLOC1_ERROR_BAD_HANDLE;
   }
 
-  if (allocator_->FreeBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
-                             hnd->fd, buf->ion_handle_main) != 0) {
+  int err = 0;
+  // Memory going back to ion stays alive while the hardware still has it mapped, only recycled
+  // memory has to wait for the release fence.
+  if (buf->pooled) {
+    err = allocator_->FreePooledBuffer(hnd->id, reinterpret_cast<void *>(hnd->base), hnd->size,
+                                       hnd->offset, hnd->fd, buf->ion_handle_main, release_fence);
+  } else {
+    err = allocator_->FreeBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
+                                 hnd->fd, buf->ion_handle_main);
+  }
+  if (err != 0) {
     return GRALLOC1_ERROR_BAD_HANDLE;
   }
   if (hnd->fd_metadata >= 0) {
@@ -221,9 +230,28 @@ gralloc1_error_t BufferManager::FreeBuffer(std::shared_ptr<Buffer> buf) {
 
 void BufferManager::RegisterHandleLocked(const private_handle_t *hnd,
                                          int ion_handle,
-                                         int ion_handle_meta) {
-  auto buffer = std::make_shared<Buffer>(hnd, ion_handle, ion_handle_meta);
-  handles_map_.emplace(std::make_pair(hnd, buffer));
+                                         int ion_handle_meta,
+                                         bool pooled) {
+  auto buffer = std::make_shared<Buffer>(hnd, ion_handle, ion_handle_meta, pooled);
+  GetHandleShard(hnd).handles_map.emplace(std::make_pair(hnd, buffer));
+}
+
+void BufferManager::RegisterHandle(const private_handle_t *hnd, int ion_handle,
+                                   int ion_handle_meta, bool pooled) {
+  std::lock_guard<std::mutex> lock(GetHandleShard(hnd).lock);
+  RegisterHandleLocked(hnd, ion_handle, ion_handle_meta, pooled);
+}
+
+BufferManager::HandleShard &BufferManager::GetHandleShard(const private_handle_t *hnd) {
+  // Handles are heap allocated, drop the low bits that are the same for every allocation
+  uintptr_t key = reinterpret_cast<uintptr_t>(hnd);
+  key ^= key >> 12;
+  return handle_shards_[(key >> 4) % kHandleShardCount];
+}
+
+uint64_t BufferManager::GetNextId() {
+  // getpid() is read per allocation, so a forked child does not hand out its parent's ids
+  return (static_cast<uint64_t>(getpid()) << 32) | (++next_id_ & 0xFFFFFFFF);
 }
 
 gralloc1_error_t BufferManager::ImportHandleLocked(private_handle_t *hnd) {
@@ -263,8 +291,9 @@ gralloc1_error_t BufferManager::ImportHandleLocked(private_handle_t *hnd) {
 
 std::shared_ptr<BufferManager::Buffer>
 BufferManager::GetBufferFromHandleLocked(const private_handle_t *hnd) {
-  auto it = handles_map_.find(hnd);
-  if (it != handles_map_.end()) {
+  auto &handles_map = GetHandleShard(hnd).handles_map;
+  auto it = handles_map.find(hnd);
+  if (it != handles_map.end()) {
     return it->second;
   } else {
     return nullptr;
@@ -286,7 +315,7 @@ gralloc1_error_t BufferManager::MapBuffer(private_handle_t const *handle) {
 gralloc1_error_t BufferManager::RetainBuffer(private_handle_t const *hnd) {
   ALOGD_IF(DEBUG, "Retain buffer handle:%p id: %" PRIu64, hnd, hnd->id);
   gralloc1_error_t err = GRALLOC1_ERROR_NONE;
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetHandleShard(hnd).lock);
   auto buf = GetBufferFromHandleLocked(hnd);
   if (buf != nullptr) {
     buf->IncRef();
@@ -297,18 +326,19 @@ gralloc1_error_t BufferManager::RetainBuffer(private_handle_t const *hnd) {
   return err;
 }
 
-gralloc1_error_t BufferManager::ReleaseBuffer(private_handle_t const *hnd) {
+gralloc1_error_t BufferManager::ReleaseBuffer(private_handle_t const *hnd, int release_fence) {
   ALOGD_IF(DEBUG, "Release buffer handle:%p", hnd);
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  HandleShard &shard = GetHandleShard(hnd);
+  std::lock_guard<std::mutex> lock(shard.lock);
   auto buf = GetBufferFromHandleLocked(hnd);
   if (buf == nullptr) {
     ALOGE("Could not find handle: %p id: %" PRIu64, hnd, hnd->id);
     return GRALLOC1_ERROR_BAD_HANDLE;
   } else {
     if (buf->DecRef()) {
-      handles_map_.erase(hnd);
+      shard.handles_map.erase(hnd);
       // Unmap, close ion handle and close fd
-      FreeBuffer(buf);
+      FreeBuffer(buf, release_fence);
     }
   }
   return GRALLOC1_ERROR_NONE;
@@ -317,7 +347,7 @@ gralloc1_error_t BufferManager::ReleaseBuffer(private_handle_t const *hnd) {
 gralloc1_error_t BufferManager::LockBuffer(const private_handle_t *hnd,
                                            gralloc1_producer_usage_t prod_usage,
                                            gralloc1_consumer_usage_t cons_usage) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetHandleShard(hnd).lock);
   gralloc1_error_t err = GRALLOC1_ERROR_NONE;
   ALOGD_IF(DEBUG, "LockBuffer buffer handle:%p id: %" PRIu64, hnd, hnd->id);
 
@@ -363,7 +393,7 @@ gralloc1_error_t BufferManager::LockBuffer(const private_handle_t *hnd,
 }
 
 gralloc1_error_t BufferManager::UnlockBuffer(const private_handle_t *handle) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetHandleShard(handle).lock);
   gralloc1_error_t status = GRALLOC1_ERROR_NONE;
 
   private_handle_t *hnd = const_cast<private_handle_t *>(handle);
@@ -504,8 +534,8 @@ int BufferManager::AllocateBuffer(const BufferDescriptor &descriptor, buffer_han
   data.handle = (uintptr_t) handle;
   data.uncached = allocator_->UseUncached(prod_usage, cons_usage);
 
-  // Allocate buffer memory
-  err = allocator_->AllocateMem(&data, prod_usage, cons_usage);
+  // Allocate buffer memory, reusing a pooled buffer if the process enabled the pool
+  err = allocator_->AllocateMem(&data, prod_usage, cons_usage, true);
   if (err) {
     ALOGE("gralloc failed to allocate err=%s", strerror(-err));
     return err;
@@ -540,7 +570,7 @@ int BufferManager::AllocateBuffer(const BufferDescriptor &descriptor, buffer_han
                                                data.size,
                                                (prod_usage | cons_usage));
 
-  hnd->id = ++next_id_;
+  hnd->id = GetNextId();
   hnd->base = 0;
   hnd->base_metadata = 0;
   hnd->layer_count = layer_count;
@@ -554,7 +584,8 @@ int BufferManager::AllocateBuffer(const BufferDescriptor &descriptor, buffer_han
   }
 
   *handle = hnd;
-  RegisterHandleLocked(hnd, data.ion_handle, e_data.ion_handle);
+  bool pooled = allocator_->TrackPooledBuffer(hnd->id, data);
+  RegisterHandle(hnd, data.ion_handle, e_data.ion_handle, pooled);
   ALOGD_IF(DEBUG, "Allocated buffer handle: %p id: %" PRIu64, hnd, hnd->id);
   if (DEBUG) {
     private_handle_t::Dump(hnd);
@@ -813,7 +844,6 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
     } break;
 
     case GRALLOC1_MODULE_PERFORM_ALLOCATE_BUFFER: {
-      std::lock_guard<std::mutex> lock(buffer_lock_);
       int width = va_arg(args, int);
       int height = va_arg(args, int);
       int format = va_arg(args, int);
@@ -860,6 +890,21 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
       }
     } break;
 
+    case GRALLOC1_MODULE_PERFORM_ENABLE_BUFFER_POOL: {
+      allocator_->EnableBufferPool();
+    } break;
+
+    case GRALLOC1_MODULE_PERFORM_RELEASE_BUFFER_FENCED: {
+      private_handle_t *hnd = va_arg(args, private_handle_t *);
+      int release_fence = va_arg(args, int);
+
+      if (private_handle_t::validate(hnd) != 0) {
+        return GRALLOC1_ERROR_BAD_HANDLE;
+      }
+
+      return ReleaseBuffer(hnd, release_fence);
+    }
+
     default:
       break;
   }
@@ -918,30 +963,37 @@ gralloc1_error_t BufferManager::GetFlexLayout(const private_handle_t *hnd,
 }
 
 gralloc1_error_t BufferManager::Dump(std::ostringstream *os) {
-  std::lock_guard<std::mutex> buffer_lock(buffer_lock_);
-  for (auto it : handles_map_) {
-    auto buf = it.second;
-    auto hnd = buf->handle;
-    *os << "handle id: " << std::setw(4) << hnd->id;
-    *os << " fd: "       << std::setw(3) << hnd->fd;
-    *os << " fd_meta: "  << std::setw(3) << hnd->fd_metadata;
-    *os << " wxh: "      << std::setw(4) << hnd->width <<" x " << std::setw(4) <<  hnd->height;
-    *os << " uwxuh: "    << std::setw(4) << hnd->unaligned_width << " x ";
-    *os << std::setw(4)  <<  hnd->unaligned_height;
-    *os << " size: "     << std::setw(9) << hnd->size;
-    *os << std::hex << std::setfill('0');
-    *os << " priv_flags: " << "0x" << std::setw(8) << hnd->flags;
-    *os << " prod_usage: " << "0x" << std::setw(8) << hnd->usage;
-    *os << " cons_usage: " << "0x" << std::setw(8) << hnd->usage;
-    // TODO(user): get format string from qdutils
-    *os << " format: "     << "0x" << std::setw(8) << hnd->format;
-    *os << std::dec  << std::setfill(' ') << std::endl;
+  for (auto &shard : handle_shards_) {
+    std::lock_guard<std::mutex> shard_lock(shard.lock);
+    for (auto it : shard.handles_map) {
+      auto buf = it.second;
+      auto hnd = buf->handle;
+      *os << "handle id: " << std::setw(4) << hnd->id;
+      *os << " fd: "       << std::setw(3) << hnd->fd;
+      *os << " fd_meta: "  << std::setw(3) << hnd->fd_metadata;
+      *os << " wxh: "      << std::setw(4) << hnd->width <<" x " << std::setw(4) <<  hnd->height;
+      *os << " uwxuh: "    << std::setw(4) << hnd->unaligned_width << " x ";
+      *os << std::setw(4)  <<  hnd->unaligned_height;
+      *os << " size: "     << std::setw(9) << hnd->size;
+      *os << std::hex << std::setfill('0');
+      *os << " priv_flags: " << "0x" << std::setw(8) << hnd->flags;
+      *os << " prod_usage: " << "0x" << std::setw(8) << hnd->usage;
+      *os << " cons_usage: " << "0x" << std::setw(8) << hnd->usage;
+      // TODO(user): get format string from qdutils
+      *os << " format: "     << "0x" << std::setw(8) << hnd->format;
+      *os << std::dec  << std::setfill(' ') << std::endl;
+    }
   }
+
+  uint64_t hits = 0, misses = 0;
+  GetBufferGeometryCacheStats(&hits, &misses);
+  *os << "buffer geometry cache hits: " << hits << " misses: " << misses << std::endl;
+  allocator_->Dump(os);
   return GRALLOC1_ERROR_NONE;
 }
 
 gralloc1_error_t BufferManager::IsBufferImported(const private_handle_t *hnd) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetHandleShard(hnd).lock);
   auto buf = GetBufferFromHandleLocked(hnd);
   if (buf != nullptr) {
     return GRALLOC1_ERROR_NONE;
@@ -42,7 +42,8 @@ class BufferManager {
                                    const gralloc1_buffer_descriptor_t *descriptor_ids,
                                    buffer_handle_t *out_buffers);
   gralloc1_error_t RetainBuffer(private_handle_t const *hnd);
-  gralloc1_error_t ReleaseBuffer(private_handle_t const *hnd);
+  // A pooled buffer freed here is not reused before release_fence has signalled
+  gralloc1_error_t ReleaseBuffer(private_handle_t const *hnd, int release_fence = -1);
   gralloc1_error_t LockBuffer(const private_handle_t *hnd, gralloc1_producer_usage_t prod_usage,
                               gralloc1_consumer_usage_t cons_usage);
   gralloc1_error_t UnlockBuffer(const private_handle_t *hnd);
@@ -88,7 +89,11 @@ class BufferManager {
   gralloc1_error_t ImportHandleLocked(private_handle_t *hnd);
 
   // Creates a Buffer from the valid private handle and adds it to the map
-  void RegisterHandleLocked(const private_handle_t *hnd, int ion_handle, int ion_handle_meta);
+  void RegisterHandleLocked(const private_handle_t *hnd, int ion_handle, int ion_handle_meta,
+                            bool pooled = false);
+  // Same as above, takes the lock of the shard owning the handle
+  void RegisterHandle(const private_handle_t *hnd, int ion_handle, int ion_handle_meta,
+                      bool pooled = false);
 
   // Wrapper structure over private handle
   // Values associated with the private handle
@@ -103,30 +108,48 @@ class BufferManager {
     // and unused in the mapping process
     int ion_handle_main = -1;
     int ion_handle_meta = -1;
+    // Allocated in this process and tracked by the allocator's buffer pool under handle->id
+    bool pooled = false;
 
     Buffer() = delete;
-    explicit Buffer(const private_handle_t* h, int ih_main = -1, int ih_meta = -1):
+    explicit Buffer(const private_handle_t* h, int ih_main = -1, int ih_meta = -1,
+                    bool p = false):
         handle(h),
         ion_handle_main(ih_main),
-        ion_handle_meta(ih_meta) {
+        ion_handle_meta(ih_meta),
+        pooled(p) {
     }
     void IncRef() { ++ref_count; }
     bool DecRef() { return --ref_count == 0; }
   };
 
-  gralloc1_error_t FreeBuffer(std::shared_ptr<Buffer> buf);
+  gralloc1_error_t FreeBuffer(std::shared_ptr<Buffer> buf, int release_fence = -1);
+
+  // The handle table is split into shards selected by the handle address, so that
+  // retain/release/lock/unlock on unrelated buffers from different threads do not
+  // serialize on one mutex. All operations on a given handle go through the same shard.
+  // TODO(user): The private_handle_t is used as a key because the unique ID generated
+  // from next_id_ is not unique across processes. The correct way to resolve this would
+  // be to use the allocator over hwbinder
+  struct HandleShard {
+    std::mutex lock;
+    std::unordered_map<const private_handle_t*, std::shared_ptr<Buffer>> handles_map = {};
+  };
+  static const uint32_t kHandleShardCount = 16;
+
+  HandleShard &GetHandleShard(const private_handle_t *hnd);
+  // Buffer ids carry the allocating pid in their upper half, so that an id names one buffer
+  // across processes for as long as its allocator lives.
+  uint64_t GetNextId();
 
   // Get the wrapper Buffer object from the handle, returns nullptr if handle is not found
+  // The "Locked" helpers expect the caller to hold the lock of the handle's shard
   std::shared_ptr<Buffer> GetBufferFromHandleLocked(const private_handle_t *hnd);
 
   bool map_fb_mem_ = false;
   Allocator *allocator_ = NULL;
-  std::mutex buffer_lock_;
   std::mutex descriptor_lock_;
-  // TODO(user): The private_handle_t is used as a key because the unique ID generated
-  // from next_id_ is not unique across processes. The correct way to resolve this would
-  // be to use the allocator over hwbinder
-  std::unordered_map<const private_handle_t*, std::shared_ptr<Buffer>> handles_map_ = {};
+  HandleShard handle_shards_[kHandleShardCount];
   std::unordered_map<gralloc1_buffer_descriptor_t,
                      std::shared_ptr<BufferDescriptor>> descriptors_map_ = {};
   std::atomic<uint64_t> next_id_;
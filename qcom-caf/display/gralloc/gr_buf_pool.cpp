@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define DEBUG 0
+
+#include <log/log.h>
+#include <string.h>
+#include <sync/sync.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gralloc_priv.h"
+#include "gr_buf_pool.h"
+
+namespace gralloc1 {
+
+BufferPool::BufferPool(IonAlloc *ion_allocator, uint64_t max_bytes, uint32_t max_age_ms)
+  : ion_allocator_(ion_allocator), max_bytes_(max_bytes), max_age_ms_(max_age_ms) {
+}
+
+BufferPool::~BufferPool() {
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto &entry : free_list_) {
+    FreeEntry(entry);
+  }
+  free_list_.clear();
+  free_bytes_ = 0;
+}
+
+bool BufferPool::IsPoolable(const AllocData &data) {
+  // Secure buffers are never recycled, the content protection state of the
+  // memory cannot be reset from here.
+  return !(data.alloc_type & private_handle_t::PRIV_FLAGS_SECURE_BUFFER) && data.size;
+}
+
+int64_t BufferPool::GetTimeMs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool BufferPool::IsReleased(Entry *entry) {
+  if (entry->fence < 0) {
+    return true;
+  }
+
+  if (sync_wait(entry->fence, 0) != 0) {
+    return false;
+  }
+
+  close(entry->fence);
+  entry->fence = -1;
+  return true;
+}
+
+bool BufferPool::Acquire(AllocData *data) {
+  if (!IsPoolable(*data)) {
+    return false;
+  }
+
+  Key key;
+  key.size = data->size;
+  key.heap_id = data->heap_id;
+  key.flags = data->flags;
+  key.uncached = data->uncached;
+
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    TrimLocked(GetTimeMs());
+    bool busy = false;
+    auto it = free_list_.begin();
+    for (; it != free_list_.end(); it++) {
+      if (!(it->key == key)) {
+        continue;
+      }
+      if (IsReleased(&(*it))) {
+        break;
+      }
+      busy = true;
+    }
+
+    if (it == free_list_.end()) {
+      misses_++;
+      busy_ += busy ? 1 : 0;
+      return false;
+    }
+
+    entry = *it;
+    free_bytes_ -= key.size;
+    free_list_.erase(it);
+    hits_++;
+  }
+
+  // Zeroing is the expensive part of a reuse, it does not need the lock.
+  if (!ClearBuffer(entry)) {
+    ALOGE("%s: Failed to clear pooled buffer fd:%d size:%u", __FUNCTION__, entry.fd, key.size);
+    FreeEntry(entry);
+    return false;
+  }
+
+  data->fd = entry.fd;
+  data->ion_handle = entry.ion_handle;
+  ALOGD_IF(DEBUG, "%s: Reused buffer fd:%d size:%u", __FUNCTION__, data->fd, key.size);
+  return true;
+}
+
+bool BufferPool::Track(uint64_t buffer_id, const AllocData &data) {
+  if (!IsPoolable(data) || data.size > max_bytes_) {
+    return false;
+  }
+
+  Key key;
+  key.size = data.size;
+  key.heap_id = data.heap_id;
+  key.flags = data.flags;
+  key.uncached = data.uncached;
+
+  std::lock_guard<std::mutex> lock(lock_);
+  tracked_[buffer_id] = key;
+  return true;
+}
+
+bool BufferPool::Release(uint64_t buffer_id, void *base, unsigned int size, unsigned int offset,
+                         int fd, int ion_handle, int release_fence) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = tracked_.find(buffer_id);
+  if (it == tracked_.end()) {
+    TrimLocked(GetTimeMs());
+    return false;
+  }
+
+  Key key = it->second;
+  tracked_.erase(it);
+  if (key.size != size) {
+    TrimLocked(GetTimeMs());
+    return false;
+  }
+
+  Entry entry;
+  entry.key = key;
+  entry.fd = fd;
+  entry.ion_handle = ion_handle;
+  if (release_fence >= 0) {
+    entry.fence = dup(release_fence);
+    if (entry.fence < 0) {
+      TrimLocked(GetTimeMs());
+      return false;
+    }
+  }
+
+  // Parked buffers are kept unmapped, the caller's mapping is released here as well
+  if (base && ion_allocator_->UnmapBuffer(base, size, offset) != 0) {
+    if (entry.fence >= 0) {
+      close(entry.fence);
+    }
+    TrimLocked(GetTimeMs());
+    return false;
+  }
+
+  entry.release_time_ms = GetTimeMs();
+  free_list_.push_front(entry);
+  free_bytes_ += key.size;
+  TrimLocked(entry.release_time_ms);
+
+  return true;
+}
+
+bool BufferPool::ClearBuffer(const Entry &entry) {
+  const Key &key = entry.key;
+  void *addr = nullptr;
+  if (ion_allocator_->MapBuffer(&addr, key.size, 0, entry.fd) != 0) {
+    return false;
+  }
+
+  memset(addr, 0, key.size);
+  if (!key.uncached) {
+    ion_allocator_->CleanBuffer(addr, key.size, 0, entry.ion_handle, CACHE_CLEAN, entry.fd);
+  }
+
+  return ion_allocator_->UnmapBuffer(addr, key.size, 0) == 0;
+}
+
+void BufferPool::Trim() {
+  std::lock_guard<std::mutex> lock(lock_);
+  TrimLocked(GetTimeMs());
+}
+
+void BufferPool::FreeEntry(const Entry &entry) {
+  // The kernel keeps the memory alive for as long as the hardware still has it mapped
+  if (entry.fence >= 0) {
+    close(entry.fence);
+  }
+  ion_allocator_->FreeBuffer(nullptr, entry.key.size, 0, entry.fd, entry.ion_handle);
+}
+
+void BufferPool::TrimLocked(int64_t now_ms) {
+  while (!free_list_.empty()) {
+    const Entry &oldest = free_list_.back();
+    if (free_bytes_ <= max_bytes_ && (now_ms - oldest.release_time_ms) < max_age_ms_) {
+      break;
+    }
+    free_bytes_ -= oldest.key.size;
+    FreeEntry(oldest);
+    free_list_.pop_back();
+    evictions_++;
+  }
+}
+
+void BufferPool::Dump(std::ostringstream *os) {
+  std::lock_guard<std::mutex> lock(lock_);
+  *os << "buffer pool entries: " << free_list_.size() << " bytes: " << free_bytes_;
+  *os << " hits: " << hits_ << " misses: " << misses_ << " (" << busy_ << " still in use)";
+  *os << " evictions: " << evictions_;
+  *os << std::endl;
+}
+
+}  // namespace gralloc1
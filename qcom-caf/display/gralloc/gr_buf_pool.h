@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __GR_BUF_POOL_H__
+#define __GR_BUF_POOL_H__
+
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include "gr_ion_alloc.h"
+
+namespace gralloc1 {
+
+// Keeps recently freed, non secure ion buffers around for a short while so that a
+// subsequent allocation of the same size from the same heap can reuse them instead of
+// going back to the kernel. A buffer may still be read by the display or the GPU when it
+// is freed, so it is parked with its release fence and only handed out again once that
+// has signalled. It is zeroed at that point, so a reused buffer looks exactly like a
+// freshly allocated one and the free path stays cheap.
+//
+// Buffers are tracked by the buffer id assigned by the allocating process, fd numbers are
+// reused by the kernel as soon as they are closed. Only buffers allocated in this process
+// are tracked; imported and shared handles are never pooled. The pool is meant for
+// processes that exclusively own the buffers they allocate (e.g. the composer allocating
+// its own scratch buffers) and is only created on their explicit request, see
+// Allocator::EnableBufferPool(). It must never be enabled in the allocator service, where
+// a freed buffer may still be held by a client.
+class BufferPool {
+ public:
+  BufferPool(IonAlloc *ion_allocator, uint64_t max_bytes, uint32_t max_age_ms);
+  ~BufferPool();
+
+  // Fills fd, ion_handle and size from a pooled buffer matching data. Returns false on a miss.
+  bool Acquire(AllocData *data);
+  // Starts tracking the buffer with the given id, allocated or acquired with data.
+  // Returns false if the buffer can never be pooled.
+  bool Track(uint64_t buffer_id, const AllocData &data);
+  // Returns true if the buffer was parked in the pool, in which case the caller must not free it.
+  // release_fence stays owned by the caller.
+  bool Release(uint64_t buffer_id, void *base, unsigned int size, unsigned int offset, int fd,
+               int ion_handle, int release_fence);
+  // Drops parked buffers that exceed the size or age limits.
+  void Trim();
+  void Dump(std::ostringstream *os);
+
+ private:
+  struct Key {
+    unsigned int size = 0;
+    unsigned int heap_id = 0;
+    unsigned int flags = 0;
+    bool uncached = false;
+
+    bool operator==(const Key &other) const {
+      return size == other.size && heap_id == other.heap_id && flags == other.flags &&
+             uncached == other.uncached;
+    }
+  };
+
+  struct Entry {
+    Key key;
+    int fd = -1;
+    int ion_handle = -1;
+    int fence = -1;  // Duplicate of the release fence, -1 once it has signalled
+    int64_t release_time_ms = 0;
+  };
+
+  static bool IsPoolable(const AllocData &data);
+  static int64_t GetTimeMs();
+  static bool IsReleased(Entry *entry);
+  bool ClearBuffer(const Entry &entry);
+  void FreeEntry(const Entry &entry);
+  void TrimLocked(int64_t now_ms);
+
+  IonAlloc *ion_allocator_ = nullptr;
+  uint64_t max_bytes_ = 0;
+  int64_t max_age_ms_ = 0;
+  std::mutex lock_;
+  // Buffers handed out by the allocator, keyed by buffer id
+  std::unordered_map<uint64_t, Key> tracked_ = {};
+  // Parked buffers, most recently released first
+  std::list<Entry> free_list_ = {};
+  uint64_t free_bytes_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t busy_ = 0;  // Misses with a match still in use by the hardware
+  uint64_t evictions_ = 0;
+};
+
+}  // namespace gralloc1
+
+#endif  // __GR_BUF_POOL_H__
@@ -32,8 +32,13 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#ifdef GRALLOC_USE_MEMFD
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
 #include <linux/msm_ion.h>
-#if TARGET_ION_ABI_VERSION >= 2
+#endif
+#if TARGET_ION_ABI_VERSION >= 2 && !defined(GRALLOC_USE_MEMFD)
 #include <ion/ion.h>
 #include <linux/dma-buf.h>
 #endif
@@ -63,7 +68,64 @@ bool IonAlloc::Init() {
   return true;
 }
 
-#if TARGET_ION_ABI_VERSION >= 2  // Use libion APIs for new ion
+#if defined(GRALLOC_USE_MEMFD)  // Host stand-in, buffers are anonymous memfds
+
+int IonAlloc::OpenIonDevice() {
+  // There is no device to talk to, any non negative value marks the allocator initialized
+  return 0;
+}
+
+void IonAlloc::CloseIonDevice() {
+  ion_dev_fd_ = FD_INIT;
+}
+
+int IonAlloc::AllocBuffer(AllocData *data) {
+  ATRACE_CALL();
+  int fd = static_cast<int>(syscall(__NR_memfd_create, "gralloc", 0));
+  if (fd < 0) {
+    ALOGE("memfd_create failed with error - %s", strerror(errno));
+    return -errno;
+  }
+
+  if (ftruncate(fd, data->size)) {
+    int err = -errno;
+    ALOGE("ftruncate to %u failed with error - %s", data->size, strerror(errno));
+    close(fd);
+    return err;
+  }
+
+  data->fd = fd;
+  data->ion_handle = fd;
+  ALOGD_IF(DEBUG, "memfd: Allocated buffer size:%u fd:%d", data->size, data->fd);
+
+  return 0;
+}
+
+int IonAlloc::FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd,
+                         int /*ion_handle*/) {
+  ATRACE_CALL();
+  int err = 0;
+  ALOGD_IF(DEBUG, "memfd: Freeing buffer base:%p size:%u fd:%d", base, size, fd);
+
+  if (base) {
+    err = UnmapBuffer(base, size, offset);
+  }
+
+  close(fd);
+  return err;
+}
+
+int IonAlloc::ImportBuffer(int fd) {
+  return fd;
+}
+
+int IonAlloc::CleanBuffer(void * /*base*/, unsigned int /*size*/, unsigned int /*offset*/,
+                          int /*handle*/, int /*op*/, int /*fd*/) {
+  // memfd pages are always coherent with the CPU
+  return 0;
+}
+
+#elif TARGET_ION_ABI_VERSION >= 2  // Use libion APIs for new ion
 
 int IonAlloc::OpenIonDevice() {
   return ion_open();
@@ -30,7 +30,10 @@
 #ifndef __GR_ION_ALLOC_H__
 #define __GR_ION_ALLOC_H__
 
+#ifndef GRALLOC_USE_MEMFD
 #include <linux/msm_ion.h>
+#endif
+#include <stdint.h>
 
 #define FD_INIT -1
 
@@ -70,7 +73,7 @@ class IonAlloc {
   int UnmapBuffer(void *base, unsigned int size, unsigned int offset);
   int CleanBuffer(void *base, unsigned int size, unsigned int offset, int handle, int op, int fd);
  private:
-#ifndef TARGET_ION_ABI_VERSION
+#if !defined(TARGET_ION_ABI_VERSION) && !defined(GRALLOC_USE_MEMFD)
   const char *kIonDevice = "/dev/ion";
 #endif
 
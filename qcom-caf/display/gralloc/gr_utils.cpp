@@ -29,6 +29,7 @@
 
 #include <media/msm_media_info.h>
 #include <algorithm>
+#include <mutex>
 #include "gr_adreno_info.h"
 #include "gr_utils.h"
 
@@ -344,14 +345,92 @@ unsigned int GetSize(const BufferInfo &info, unsigned int alignedw,
   return size;
 }
 
-void GetBufferSizeAndDimensions(const BufferInfo &info, unsigned int *size, unsigned int *alignedw,
-                                unsigned int *alignedh) {
-  GraphicsMetadata graphics_metadata = {};
-  GetBufferSizeAndDimensions(info, size, alignedw, alignedh, &graphics_metadata);
+// Size and alignment only depend on the requested geometry, format and usage, and the same few
+// combinations are queried over and over, e.g. for every layer by the composer. Remember the most
+// recently used results; graphics metadata is not cached as it is only needed on allocation.
+class BufferGeometryCache {
+ public:
+  bool Lookup(const BufferInfo &info, unsigned int *size, unsigned int *alignedw,
+              unsigned int *alignedh) {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto &entry : entries_) {
+      if (entry.last_use && IsSameInfo(entry.info, info)) {
+        entry.last_use = ++tick_;
+        *size = entry.size;
+        *alignedw = entry.alignedw;
+        *alignedh = entry.alignedh;
+        hits_++;
+        return true;
+      }
+    }
+    misses_++;
+    return false;
+  }
+
+  void Insert(const BufferInfo &info, unsigned int size, unsigned int alignedw,
+              unsigned int alignedh) {
+    // Failed computations are not cached, so that they keep getting logged.
+    if (!size) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    Entry *victim = &entries_[0];
+    for (auto &entry : entries_) {
+      if (entry.last_use && IsSameInfo(entry.info, info)) {
+        victim = &entry;
+        break;
+      }
+      if (entry.last_use < victim->last_use) {
+        victim = &entry;
+      }
+    }
+    victim->info = info;
+    victim->size = size;
+    victim->alignedw = alignedw;
+    victim->alignedh = alignedh;
+    victim->last_use = ++tick_;
+  }
+
+  void GetStats(uint64_t *hits, uint64_t *misses) {
+    std::lock_guard<std::mutex> lock(lock_);
+    *hits = hits_;
+    *misses = misses_;
+  }
+
+ private:
+  static const int kMaxEntries = 32;
+
+  struct Entry {
+    BufferInfo info = BufferInfo(0, 0, 0);
+    unsigned int size = 0;
+    unsigned int alignedw = 0;
+    unsigned int alignedh = 0;
+    uint64_t last_use = 0;  // 0 marks an unused entry
+  };
+
+  static bool IsSameInfo(const BufferInfo &info1, const BufferInfo &info2) {
+    return info1.width == info2.width && info1.height == info2.height &&
+           info1.format == info2.format && info1.layer_count == info2.layer_count &&
+           info1.prod_usage == info2.prod_usage && info1.cons_usage == info2.cons_usage;
+  }
+
+  std::mutex lock_;
+  Entry entries_[kMaxEntries];
+  uint64_t tick_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+static BufferGeometryCache buffer_geometry_cache;
+
+void GetBufferGeometryCacheStats(uint64_t *hits, uint64_t *misses) {
+  buffer_geometry_cache.GetStats(hits, misses);
 }
 
-void GetBufferSizeAndDimensions(const BufferInfo &info, unsigned int *size, unsigned int *alignedw,
-                                unsigned int *alignedh, GraphicsMetadata *graphics_metadata) {
+static void ComputeBufferSizeAndDimensions(const BufferInfo &info, unsigned int *size,
+                                           unsigned int *alignedw, unsigned int *alignedh,
+                                           GraphicsMetadata *graphics_metadata) {
   int buffer_type = GetBufferType(info.format);
   if (CanUseAdrenoForSize(buffer_type, (info.prod_usage | info.cons_usage))) {
     GetGpuResourceSizeAndDimensions(info, size, alignedw, alignedh, graphics_metadata);
@@ -359,6 +438,30 @@ void GetBufferSizeAndDimensions(const BufferInfo &info, unsigned int *size, unsi
     GetAlignedWidthAndHeight(info, alignedw, alignedh);
     *size = GetSize(info, *alignedw, *alignedh);
   }
+
+  buffer_geometry_cache.Insert(info, *size, *alignedw, *alignedh);
+}
+
+void GetBufferSizeAndDimensions(const BufferInfo &info, unsigned int *size, unsigned int *alignedw,
+                                unsigned int *alignedh) {
+  if (buffer_geometry_cache.Lookup(info, size, alignedw, alignedh)) {
+    return;
+  }
+
+  GraphicsMetadata graphics_metadata = {};
+  ComputeBufferSizeAndDimensions(info, size, alignedw, alignedh, &graphics_metadata);
+}
+
+void GetBufferSizeAndDimensions(const BufferInfo &info, unsigned int *size, unsigned int *alignedw,
+                                unsigned int *alignedh, GraphicsMetadata *graphics_metadata) {
+  // Buffers laid out by Adreno need their graphics metadata populated, which is not cached.
+  int buffer_type = GetBufferType(info.format);
+  if (!CanUseAdrenoForSize(buffer_type, (info.prod_usage | info.cons_usage)) &&
+      buffer_geometry_cache.Lookup(info, size, alignedw, alignedh)) {
+    return;
+  }
+
+  ComputeBufferSizeAndDimensions(info, size, alignedw, alignedh, graphics_metadata);
 }
 
 void GetYuvUbwcSPPlaneInfo(uint64_t base, uint32_t width, uint32_t height,
@@ -110,6 +110,7 @@ void GetBufferSizeAndDimensions(const BufferInfo &d, unsigned int *size, unsigne
                                 unsigned int *alignedh, GraphicsMetadata *graphics_metadata);
 void GetAlignedWidthAndHeight(const BufferInfo &d, unsigned int *aligned_w,
                               unsigned int *aligned_h);
+void GetBufferGeometryCacheStats(uint64_t *hits, uint64_t *misses);
 int GetYUVPlaneInfo(const private_handle_t *hnd, struct android_ycbcr *ycbcr);
 int GetRgbDataAddress(private_handle_t *hnd, void **rgb_data);
 bool IsUBwcFormat(int format);
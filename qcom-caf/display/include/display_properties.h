@@ -79,6 +79,7 @@
 #define DISABLE_UBWC_PROP                    GRALLOC_PROP("disable_ubwc")
 #define ENABLE_FB_UBWC_PROP                  GRALLOC_PROP("enable_fb_ubwc")
 #define MAP_FB_MEMORY_PROP                   GRALLOC_PROP("map_fb_memory")
+#define ENABLE_BUFFER_POOL_PROP              GRALLOC_PROP("enable_buffer_pool")
 
 #define MAX_BLIT_FACTOR_PROP                 DISPLAY_PROP("max_blit_factor")
 #define DISABLE_SECURE_INLINE_ROTATOR_PROP   DISPLAY_PROP("disable_secure_inline_rotator")
@@ -87,6 +88,11 @@
 #define DISABLE_INLINE_ROTATOR_PROP          DISPLAY_PROP("disable_inline_rotator")
 #define DISABLE_FB_CROPPING_PROP             DISPLAY_PROP("disable_fb_cropping")
 #define PRIORITIZE_CACHE_COMPOSITION_PROP    DISPLAY_PROP("prioritize_cache_comp")
+#define ENABLE_COMP_RESULT_CACHE_PROP        DISPLAY_PROP("enable_comp_result_cache")
+#define ENABLE_CPU_TONEMAPPER_PROP           DISPLAY_PROP("enable_cpu_tonemapper")
+#define ENABLE_FRAME_STATS_PROP              DISPLAY_PROP("enable_frame_stats")
+#define ENABLE_LAYER_CACHE_PROP              DISPLAY_PROP("enable_layer_cache")
+#define ENABLE_ASYNC_PRESENT_PROP            DISPLAY_PROP("enable_async_present")
 
 #define DISABLE_HDR_LUT_GEN                  DISPLAY_PROP("disable_hdr_lut_gen")
 #define ENABLE_DEFAULT_COLOR_MODE            DISPLAY_PROP("enable_default_color_mode")
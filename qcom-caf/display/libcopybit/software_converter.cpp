@@ -29,9 +29,63 @@
 
 #include <log/log.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "software_converter.h"
 
+/* Interleave two planes into one: dst[2i] = first[i], dst[2i+1] = second[i] */
+static void interleave_planes(unsigned char *dst, const unsigned char *first,
+                              const unsigned char *second, size_t count)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t pair;
+        pair.val[0] = vld1q_u8(first + i);
+        pair.val[1] = vld1q_u8(second + i);
+        vst2q_u8(dst + 2 * i, pair);
+    }
+#elif defined(__SSE2__)
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(first + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(second + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[2 * i] = first[i];
+        dst[2 * i + 1] = second[i];
+    }
+}
+
+/* Copy rows of row_bytes between planes of different strides */
+static void copy_plane(unsigned char *dst, size_t dst_stride,
+                       const unsigned char *src, size_t src_stride,
+                       size_t row_bytes, size_t rows)
+{
+    if (!rows) {
+        return;
+    }
+
+    // Same pitch on both sides, the plane is one contiguous block
+    if (src_stride == dst_stride) {
+        memcpy(dst, src, src_stride * (rows - 1) + row_bytes);
+        return;
+    }
+
+    for (size_t i = 0; i < rows; i++) {
+        memcpy(dst, src, row_bytes);
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
 /** Convert YV12 to YCrCb_420_SP */
 int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_handle)
 {
@@ -60,63 +114,16 @@ int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_h
     unsigned char* oldChroma = (unsigned char*)(hnd->base + y_size);
     memcpy((char *)yv12_handle->base,(char *)hnd->base,y_size);
 
-#if defined(__ARM_HAVE_NEON) && !defined(__aarch64__)
-   /* interleave */
     if(!chromaPadding) {
-        unsigned char * t1 = newChroma;
-        unsigned char * t2 = oldChroma;
-        unsigned char * t3 = t2 + chromaSize/2;
-        for(unsigned int i=0; i < (chromaSize/2)>>3; i++) {
-            __asm__ __volatile__ (
-                                    "vld1.u8 d0, [%0]! \n"
-                                    "vld1.u8 d1, [%1]! \n"
-                                    "vst2.u8 {d0, d1}, [%2]! \n"
-                                    :"+r"(t2), "+r"(t3), "+r"(t1)
-                                    :
-                                    :"memory","d0","d1"
-                                 );
-
-        }
-    }
-#else  //__ARM_HAVE_NEON
-    if(!chromaPadding) {
-        for(unsigned int i = 0; i< chromaSize/2; i++) {
-            newChroma[i*2]   = oldChroma[i];
-            newChroma[i*2+1] = oldChroma[i+chromaSize/2];
-        }
-
-    }
-#endif
-    // If the image is not aligned to 16 pixels,
-    // convert using the C routine below
-    // r1 tracks the row of the source buffer
-    // r2 tracks the row of the destination buffer
-    // The width/2 checks are to avoid copying
-    // from the padding
-
-    if(chromaPadding) {
-        unsigned int r1 = 0, r2 = 0, i = 0, j = 0;
-        while(r1 < height/2) {
-            if(j == width) {
-                j = 0;
-                r2++;
-                continue;
-            }
-            if (j+1 == width) {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                r2++;
-                newChroma[r2*width] = oldChroma[r1*c_width+i+c_size];
-                j = 1;
-            } else {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                newChroma[r2*width + j + 1] = oldChroma[r1*c_width+i+c_size];
-                j+=2;
-            }
-            i++;
-            if (i == width/2 ) {
-                i = 0;
-                r1++;
-            }
+        // Cr plane followed by the Cb plane, interleave them as CrCb
+        interleave_planes(newChroma, oldChroma, oldChroma + chromaSize/2, chromaSize/2);
+    } else {
+        // The chroma planes are padded to c_width, the destination is
+        // packed, each source row yields width/2 CrCb pairs
+        unsigned int c_row = width/2;
+        for(unsigned int r = 0; r < height/2; r++) {
+            interleave_planes(newChroma + r*c_row*2, oldChroma + r*c_width,
+                              oldChroma + r*c_width + c_size, c_row);
         }
     }
 
@@ -145,28 +152,22 @@ static int copy_source_to_destination(const uintptr_t src_base,
          return COPYBIT_FAILURE;
     }
 
-    int width = info.width;
-    int height = info.height;
+    size_t width = info.width;
+    size_t height = info.height;
+    size_t src_stride = info.src_stride;
+    size_t dst_stride = info.dst_stride;
     unsigned char *src = (unsigned char*)src_base;
     unsigned char *dst = (unsigned char*)dst_base;
 
     // Copy the luma
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, width);
-        src += info.src_stride;
-        dst += info.dst_stride;
-    }
+    copy_plane(dst, dst_stride, src, src_stride, width, height);
 
-    // Copy plane 1
+    // Copy plane 1, the interleaved chroma rows are copied up to the
+    // smaller of the two strides so the last row stays inside the plane
     src = (unsigned char*)(src_base + info.src_plane1_offset);
     dst = (unsigned char*)(dst_base + info.dst_plane1_offset);
-    width = width/2;
-    height = height/2;
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, info.src_stride);
-        src += info.src_stride;
-        dst += info.dst_stride;
-    }
+    copy_plane(dst, dst_stride, src, src_stride,
+               (src_stride < dst_stride) ? src_stride : dst_stride, height/2);
     return 0;
 }
 
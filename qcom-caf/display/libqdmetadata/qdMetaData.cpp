@@ -36,10 +36,14 @@
 #include <gralloctypes/Gralloc4.h>
 #endif
 #include <log/log.h>
+#include <stddef.h>
 #include <string.h>
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <cinttypes>
+#include <list>
+#include <mutex>
 
 static int colorMetaDataToColorSpace(ColorMetaData in, ColorSpace_t *out) {
   if (in.colorPrimaries == ColorPrimaries_BT601_6_525 ||
@@ -147,6 +151,9 @@ static bool getGralloc4Array(MetaData_t *metadata, int32_t paramType) {
     case SET_VIDEO_TS_INFO:
       return metadata
           ->isVendorMetadataSet[GET_VENDOR_METADATA_STATUS_INDEX(QTI_VIDEO_TS_INFO)];
+    case SET_WRITEBACK_FRAME_INFO:
+      return metadata
+          ->isVendorMetadataSet[GET_VENDOR_METADATA_STATUS_INDEX(QTI_WRITEBACK_FRAME_INFO)];
     case GET_S3D_FORMAT:
       return metadata->isVendorMetadataSet[GET_VENDOR_METADATA_STATUS_INDEX(QTI_S3D_FORMAT)];
     default:
@@ -210,6 +217,10 @@ static void setGralloc4Array(MetaData_t *metadata, int32_t paramType, bool isSet
       metadata->isVendorMetadataSet[GET_VENDOR_METADATA_STATUS_INDEX(QTI_VIDEO_TS_INFO)] =
           isSet;
       break;
+    case SET_WRITEBACK_FRAME_INFO:
+      metadata->isVendorMetadataSet[GET_VENDOR_METADATA_STATUS_INDEX(QTI_WRITEBACK_FRAME_INFO)] =
+          isSet;
+      break;
     case S3D_FORMAT:
       metadata->isVendorMetadataSet[GET_VENDOR_METADATA_STATUS_INDEX(QTI_S3D_FORMAT)] = isSet;
       break;
@@ -226,6 +237,96 @@ static void setGralloc4Array(MetaData_t *metadata, int32_t paramType, bool isSet
 }
 #endif
 
+// Records whether paramType holds a value, both in the gralloc4 status arrays and in the
+// operation mask that lets copies skip unset payloads.
+static void setParamState(MetaData_t *metadata, int32_t paramType, bool isSet) {
+  setGralloc4Array(metadata, paramType, isSet);
+  // Writers predating the version stamp kept operation the same way, their bits stay valid.
+  metadata->version = QD_METADATA_VERSION;
+  if (isSet) {
+    metadata->operation |= paramType;
+  } else {
+    metadata->operation &= ~paramType;
+  }
+}
+
+// Called once a change is fully written. A reader that sees the new generation then sees the new
+// payload too, instead of caching the old one under the new generation.
+static void bumpGeneration(MetaData_t *metadata) {
+  __atomic_fetch_add(&metadata->generation, 1, __ATOMIC_RELEASE);
+}
+
+static bool isParamSet(MetaData_t *metadata, int32_t paramType) {
+#ifndef __QTI_NO_GRALLOC4__
+  // The mapper updates the status arrays without going through this library, so they remain
+  // the authority on what is set.
+  return getGralloc4Array(metadata, paramType);
+#else
+  if (metadata->version != QD_METADATA_VERSION) {
+    return true;
+  }
+  return (metadata->operation & paramType) != 0;
+#endif
+}
+
+// Copies src over dst field by field. The large payloads (graphics metadata, video histogram,
+// CVP metadata, reserved region) make up almost all of MetaData_t but are rarely set, so they
+// are only copied when set and only up to their used length. Everything else is small and
+// copied as is.
+static void copyMetaDataDelta(MetaData_t *src, MetaData_t *dst) {
+  static_assert(offsetof(MetaData_t, graphics_metadata) <
+                offsetof(MetaData_t, video_histogram_stats) &&
+                offsetof(MetaData_t, video_histogram_stats) < offsetof(MetaData_t, cvpMetadata) &&
+                offsetof(MetaData_t, cvpMetadata) < offsetof(MetaData_t, crop) &&
+                offsetof(MetaData_t, reservedRegion) < offsetof(MetaData_t, isStandardMetadataSet),
+                "copyMetaDataDelta relies on the MetaData_t field order");
+  if (src == dst) {
+    return;
+  }
+
+  // Readers compare generations of the same buffer, so dst keeps counting from its own.
+  uint32_t generation = dst->generation + 1;
+  auto src_bytes = reinterpret_cast<const uint8_t *>(src);
+  auto dst_bytes = reinterpret_cast<uint8_t *>(dst);
+  auto copyRange = [&](size_t begin, size_t end) {
+    memcpy(dst_bytes + begin, src_bytes + begin, end - begin);
+  };
+  copyRange(0, offsetof(MetaData_t, graphics_metadata));
+  copyRange(offsetof(MetaData_t, crop), offsetof(MetaData_t, reservedRegion));
+  copyRange(offsetof(MetaData_t, isStandardMetadataSet), sizeof(MetaData_t));
+
+  if (isParamSet(src, SET_GRAPHICS_METADATA)) {
+    // Raw payload without a meaningful length, copy all of it
+    dst->graphics_metadata = src->graphics_metadata;
+  }
+
+  dst->video_histogram_stats.stat_len = 0;
+  if (isParamSet(src, SET_VIDEO_HISTOGRAM_STATS)) {
+    auto &in = src->video_histogram_stats;
+    auto &out = dst->video_histogram_stats;
+    memcpy(out.stats_info, in.stats_info,
+           std::min(in.stat_len, static_cast<uint32_t>(VIDEO_HISTOGRAM_STATS_SIZE)));
+    memcpy(&out.stat_len, &in.stat_len,
+           sizeof(VideoHistogramMetadata) - offsetof(VideoHistogramMetadata, stat_len));
+  }
+
+  dst->cvpMetadata.size = 0;
+  if (isParamSet(src, SET_CVP_METADATA)) {
+    auto &in = src->cvpMetadata;
+    auto &out = dst->cvpMetadata;
+    memcpy(out.payload, in.payload, std::min(in.size, static_cast<uint32_t>(CVP_METADATA_SIZE)));
+    out.size = in.size;
+    memcpy(&out.capture_frame_rate, &in.capture_frame_rate,
+           sizeof(CVPMetadata) - offsetof(CVPMetadata, capture_frame_rate));
+  }
+
+  auto &in_region = src->reservedRegion;
+  dst->reservedRegion.size = in_region.size;
+  memcpy(dst->reservedRegion.data, in_region.data,
+         std::min(in_region.size, static_cast<uint32_t>(RESERVED_REGION_SIZE)));
+
+  __atomic_store_n(&dst->generation, generation, __ATOMIC_RELEASE);
+}
 
 unsigned long getMetaDataSize() {
     return static_cast<unsigned long>(ROUND_UP_PAGESIZE(sizeof(MetaData_t)));
@@ -236,6 +337,28 @@ unsigned long getMetaDataSizeWithReservedRegion(uint64_t reserved_size) {
   return static_cast<unsigned long>(ROUND_UP_PAGESIZE(sizeof(MetaData_t) + reserved_size));
 }
 
+// Maps the metadata of fd including the reserved region that may follow it.
+static void *mapMetaData(int fd, unsigned long *size) {
+    *size = getMetaDataSize();
+    void *base = mmap(NULL, *size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == reinterpret_cast<void*>(MAP_FAILED)) {
+        ALOGE("%s: metadata mmap failed - fd: %d err: %s", __func__, fd, strerror(errno));
+        return nullptr;
+    }
+    auto metadata = reinterpret_cast<MetaData_t *>(base);
+    if (metadata->reservedSize) {
+      auto reserved_size = metadata->reservedSize;
+      munmap(base, *size);
+      *size = getMetaDataSizeWithReservedRegion(reserved_size);
+      base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (base == reinterpret_cast<void *>(MAP_FAILED)) {
+        ALOGE("%s: metadata mmap failed - fd: %d err: %s", __func__, fd, strerror(errno));
+        return nullptr;
+      }
+    }
+    return base;
+}
+
 static int validateAndMap(private_handle_t* handle) {
     if (private_handle_t::validate(handle)) {
         ALOGE("%s: Private handle is invalid - handle:%p", __func__, handle);
@@ -247,42 +370,68 @@ static int validateAndMap(private_handle_t* handle) {
     }
 
     if (!handle->base_metadata) {
-        auto size = getMetaDataSize();
-        void *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
-                handle->fd_metadata, 0);
-        if (base == reinterpret_cast<void*>(MAP_FAILED)) {
-            ALOGE("%s: metadata mmap failed - handle:%p fd: %d err: %s",
-                __func__, handle, handle->fd_metadata, strerror(errno));
+        unsigned long size = 0;
+        void *base = mapMetaData(handle->fd_metadata, &size);
+        if (!base) {
+            ALOGE("%s: metadata map failed - handle:%p", __func__, handle);
             return -1;
         }
         handle->base_metadata = (uintptr_t) base;
-        auto metadata = reinterpret_cast<MetaData_t *>(handle->base_metadata);
-        if (metadata->reservedSize) {
-          auto reserved_size = metadata->reservedSize;
-          munmap(reinterpret_cast<void *>(handle->base_metadata), getMetaDataSize());
-          handle->base_metadata = 0;
-          size = getMetaDataSizeWithReservedRegion(reserved_size);
-          void *new_base =
-              mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle->fd_metadata, 0);
-          if (new_base == reinterpret_cast<void *>(MAP_FAILED)) {
-            ALOGE("%s: metadata mmap failed - handle:%p fd: %d err: %s", __func__, handle,
-                  handle->fd_metadata, strerror(errno));
-            return -1;
-          }
-          handle->base_metadata = (uintptr_t)new_base;
-        }
     }
     return 0;
 }
 
-static void unmapAndReset(private_handle_t *handle) {
-    if (private_handle_t::validate(handle) == 0 && handle->base_metadata) {
-      // If reservedSize is 0, the return value will be the same as getMetaDataSize
-      auto metadata = reinterpret_cast<MetaData_t *>(handle->base_metadata);
-      auto size = getMetaDataSizeWithReservedRegion(metadata->reservedSize);
-      munmap(reinterpret_cast<void *>(handle->base_metadata), size);
-      handle->base_metadata = 0;
+// Clients that clone and delete native handles cannot keep the mapping in the handle, so the
+// *AndUnmap variants would mmap and munmap the metadata on every access. The most recent
+// mappings are kept here instead, keyed by buffer id. All ION buffers share one inode on this
+// kernel, so neither the file nor the fd number can identify the buffer. Gralloc puts the
+// allocating pid in the upper half of the id, which makes it unique across processes, and any
+// handle or clone carrying an id refers to the same metadata.
+struct MetaDataMapping {
+  uint64_t id;
+  void *base;
+  unsigned long size;
+};
+
+static const size_t kMaxCachedMappings = 8;
+static std::mutex gMappingLock;
+// Most recently used first
+static std::list<MetaDataMapping> gMappings;
+
+template <class Fn>
+static int accessMetaDataCached(private_handle_t *handle, Fn fn) {
+    if (private_handle_t::validate(handle)) {
+        ALOGE("%s: Private handle is invalid - handle:%p", __func__, handle);
+        return -1;
     }
+    if (handle->fd_metadata < 0) {
+      return -1;
+    }
+    if (handle->base_metadata) {
+      // Mapped and owned by the handle already
+      return fn(reinterpret_cast<MetaData_t *>(handle->base_metadata));
+    }
+
+    std::lock_guard<std::mutex> lock(gMappingLock);
+    auto it = std::find_if(gMappings.begin(), gMappings.end(), [&](const MetaDataMapping &m) {
+      return m.id == handle->id;
+    });
+    if (it != gMappings.end()) {
+      gMappings.splice(gMappings.begin(), gMappings, it);
+    } else {
+      MetaDataMapping mapping = {handle->id, nullptr, 0};
+      mapping.base = mapMetaData(handle->fd_metadata, &mapping.size);
+      if (!mapping.base) {
+        return -1;
+      }
+      gMappings.push_front(mapping);
+      if (gMappings.size() > kMaxCachedMappings) {
+        munmap(gMappings.back().base, gMappings.back().size);
+        gMappings.pop_back();
+      }
+    }
+
+    return fn(reinterpret_cast<MetaData_t *>(gMappings.front().base));
 }
 
 int setMetaData(private_handle_t *handle, DispParamType paramType,
@@ -294,13 +443,10 @@ int setMetaData(private_handle_t *handle, DispParamType paramType,
                          paramType, param);
 }
 
-int setMetaDataVa(MetaData_t *data, DispParamType paramType,
-                  void *param) {
-    if (data == nullptr)
-        return -EINVAL;
+static int writeMetaDataVa(MetaData_t *data, DispParamType paramType, void *param) {
     // If parameter is NULL reset the specific MetaData Key
     if (!param) {
-      setGralloc4Array(data, paramType, false);
+      setParamState(data, paramType, false);
       switch (paramType) {
         case SET_VIDEO_PERF_MODE:
           data->isVideoPerfMode = 0;
@@ -311,6 +457,9 @@ int setMetaDataVa(MetaData_t *data, DispParamType paramType,
         case SET_VIDEO_HISTOGRAM_STATS:
           data->video_histogram_stats.stat_len = 0;
           break;
+        case SET_WRITEBACK_FRAME_INFO:
+          data->wbFrameInfo = {};
+          break;
         default:
           ALOGE("Unknown paramType %d", paramType);
           break;
@@ -319,7 +468,7 @@ int setMetaDataVa(MetaData_t *data, DispParamType paramType,
        return 0;
     }
 
-    setGralloc4Array(data, paramType, true);
+    setParamState(data, paramType, true);
     switch (paramType) {
         case PP_PARAM_INTERLACED:
             data->interlaced = *((int32_t *)param);
@@ -388,7 +537,7 @@ int setMetaDataVa(MetaData_t *data, DispParamType paramType,
                  memcpy(data->cvpMetadata.reserved, cvpMetadata->reserved,
                         (8 * sizeof(uint32_t)));
              } else {
-               setGralloc4Array(data, paramType, false);
+               setParamState(data, paramType, false);
                ALOGE("%s: cvp metadata length %d is more than max size %d", __func__,
                      cvpMetadata->size, CVP_METADATA_SIZE);
                return -EINVAL;
@@ -407,7 +556,7 @@ int setMetaDataVa(MetaData_t *data, DispParamType paramType,
                 data->video_histogram_stats.decode_width = vidstats->decode_width;
                 data->video_histogram_stats.decode_height = vidstats->decode_height;
             } else {
-              setGralloc4Array(data, paramType, false);
+              setParamState(data, paramType, false);
               ALOGE("%s: video stats length %u is more than max size %u", __func__,
                     vidstats->stat_len, VIDEO_HISTOGRAM_STATS_SIZE);
               return -EINVAL;
@@ -417,6 +566,9 @@ int setMetaDataVa(MetaData_t *data, DispParamType paramType,
         case SET_VIDEO_TS_INFO:
             data->videoTsInfo = *((VideoTimestampInfo *)param);
             break;
+        case SET_WRITEBACK_FRAME_INFO:
+            data->wbFrameInfo = *((WritebackFrameInfo *)param);
+            break;
         default:
             ALOGE("Unknown paramType %d", paramType);
             break;
@@ -424,6 +576,16 @@ int setMetaDataVa(MetaData_t *data, DispParamType paramType,
     return 0;
 }
 
+int setMetaDataVa(MetaData_t *data, DispParamType paramType,
+                  void *param) {
+    if (data == nullptr)
+        return -EINVAL;
+    // Failed writes still change the set state of paramType
+    int ret = writeMetaDataVa(data, paramType, param);
+    bumpGeneration(data);
+    return ret;
+}
+
 int clearMetaData(private_handle_t *handle, DispParamType paramType) {
     auto err = validateAndMap(handle);
     if (err != 0)
@@ -435,7 +597,7 @@ int clearMetaData(private_handle_t *handle, DispParamType paramType) {
 int clearMetaDataVa(MetaData_t *data, DispParamType paramType) {
     if (data == nullptr)
         return -EINVAL;
-    data->operation &= ~paramType;
+    setParamState(data, paramType, false);
     switch (paramType) {
         case SET_VIDEO_PERF_MODE:
             data->isVideoPerfMode = 0;
@@ -446,10 +608,14 @@ int clearMetaDataVa(MetaData_t *data, DispParamType paramType) {
         case SET_VIDEO_HISTOGRAM_STATS:
             data->video_histogram_stats.stat_len = 0;
             break;
+        case SET_WRITEBACK_FRAME_INFO:
+            data->wbFrameInfo = {};
+            break;
         default:
             ALOGE("Unknown paramType %d", paramType);
             break;
     }
+    bumpGeneration(data);
     return 0;
 }
 
@@ -462,6 +628,17 @@ int getMetaData(private_handle_t *handle, DispFetchParamType paramType,
                          paramType, param);
 }
 
+int getMetaDataGeneration(private_handle_t *handle, uint32_t *generation) {
+    if (generation == nullptr)
+        return -EINVAL;
+    int ret = validateAndMap(handle);
+    if (ret != 0)
+        return ret;
+    MetaData_t *data = reinterpret_cast<MetaData_t *>(handle->base_metadata);
+    *generation = __atomic_load_n(&data->generation, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
 int getMetaDataVa(MetaData_t *data, DispFetchParamType paramType,
                   void *param) {
     // Make sure we send 0 only if the operation queried is present
@@ -563,6 +740,9 @@ int getMetaDataVa(MetaData_t *data, DispFetchParamType paramType,
         case GET_VIDEO_TS_INFO:
           *((VideoTimestampInfo *)param) = data->videoTsInfo;
           break;
+        case GET_WRITEBACK_FRAME_INFO:
+          *((WritebackFrameInfo *)param) = data->wbFrameInfo;
+          break;
         default:
             ALOGE("Unknown paramType %d", paramType);
             ret = -EINVAL;
@@ -582,7 +762,7 @@ int copyMetaData(struct private_handle_t *src, struct private_handle_t *dst) {
 
     MetaData_t *src_data = reinterpret_cast <MetaData_t *>(src->base_metadata);
     MetaData_t *dst_data = reinterpret_cast <MetaData_t *>(dst->base_metadata);
-    *dst_data = *src_data;
+    copyMetaDataDelta(src_data, dst_data);
     return 0;
 }
 
@@ -596,7 +776,7 @@ int copyMetaDataVaToHandle(MetaData_t *src_data, struct private_handle_t *dst) {
         return err;
 
     MetaData_t *dst_data = reinterpret_cast <MetaData_t *>(dst->base_metadata);
-    *dst_data = *src_data;
+    copyMetaDataDelta(src_data, dst_data);
     return 0;
 }
 
@@ -610,7 +790,7 @@ int copyMetaDataHandleToVa(struct private_handle_t *src, MetaData_t *dst_data) {
         return err;
 
     MetaData_t *src_data = reinterpret_cast <MetaData_t *>(src->base_metadata);
-    *dst_data = *src_data;
+    copyMetaDataDelta(src_data, dst_data);
     return 0;
 }
 
@@ -622,21 +802,21 @@ int copyMetaDataVaToVa(MetaData_t *src_data, MetaData_t *dst_data) {
     if (dst_data == nullptr)
         return err;
 
-    *dst_data = *src_data;
+    copyMetaDataDelta(src_data, dst_data);
     return 0;
 }
 
 int setMetaDataAndUnmap(struct private_handle_t *handle, enum DispParamType paramType,
                         void *param) {
-    auto ret = setMetaData(handle, paramType, param);
-    unmapAndReset(handle);
-    return ret;
+    return accessMetaDataCached(handle, [&](MetaData_t *data) {
+      return setMetaDataVa(data, paramType, param);
+    });
 }
 
 int getMetaDataAndUnmap(struct private_handle_t *handle,
                         enum DispFetchParamType paramType,
                         void *param) {
-    auto ret = getMetaData(handle, paramType, param);
-    unmapAndReset(handle);
-    return ret;
+    return accessMetaDataCached(handle, [&](MetaData_t *data) {
+      return getMetaDataVa(data, paramType, param);
+    });
 }
@@ -81,6 +81,7 @@ public:
         GET_COMPOSER_STATUS = 39, // Get composer init status-true if primary display init is done
 	SET_STAND_BY_MODE = 40, //Set stand by mode for MDP hardware.
         GET_PANEL_RESOLUTION = 41, // Get Panel Resolution
+        GET_FRAME_STATS = 42, // Get frame timing histograms of a display
         COMMAND_LIST_END = 400,
     };
 
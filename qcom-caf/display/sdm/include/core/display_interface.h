@@ -685,6 +685,15 @@ class DisplayInterface {
                                               LayerBufferFormat format,
                                               const ColorMetaData &color_metadata) = 0;
 
+  /*! @brief Method to check whether the display can write its composed output into a buffer
+      of the given format. Applicable only to displays with an output buffer (virtual).
+
+    @param[in] format output buffer format
+
+    @return \link DisplayError \endlink
+  */
+  virtual DisplayError GetOutputBufferSupport(LayerBufferFormat format) = 0;
+
   /*! @brief Method to dynamically set DSI clock rate.
 
       @param[in] bitclk DSI bit clock in HZ.
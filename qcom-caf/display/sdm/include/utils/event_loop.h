@@ -0,0 +1,84 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __EVENT_LOOP_H__
+#define __EVENT_LOOP_H__
+
+#include <core/sdm_types.h>
+#include <stdint.h>
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace sdm {
+
+// Process wide epoll loop shared by all display event sources (vsync, idle, thermal and power
+// collapse nodes of every display) and the hotplug uevent listener, so that they are served by
+// one urgent priority thread instead of one blocking thread each.
+// Handlers run on the loop thread and are passed the ready epoll events of their fd.
+class EventLoop {
+ public:
+  typedef std::function<void(uint32_t events)> Handler;
+
+  static EventLoop *Get();
+  DisplayError Register(int fd, uint32_t events, const Handler &handler);
+  // Once this returns the handler of fd is neither running nor called again. Safe to call from
+  // within a handler.
+  DisplayError Unregister(int fd);
+
+ private:
+  struct Source {
+    int fd = -1;
+    Handler handler;
+  };
+
+  EventLoop() { }
+  DisplayError Start();
+  void Run();
+
+  static const int kMaxEvents = 16;
+  std::mutex mutex_;
+  std::condition_variable dispatch_cv_;
+  std::thread thread_;
+  std::thread::id thread_id_;
+  int epoll_fd_ = -1;
+  // Sources are keyed by a registration id rather than the fd, so that a stale event for a
+  // closed and reused fd is never delivered to the new owner.
+  std::map<uint64_t, std::shared_ptr<Source>> sources_;
+  std::map<int, uint64_t> fd_to_id_;
+  uint64_t next_id_ = 1;
+  uint64_t dispatching_id_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __EVENT_LOOP_H__
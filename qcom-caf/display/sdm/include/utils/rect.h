@@ -51,6 +51,7 @@ namespace sdm {
   LayerRect Union(const LayerRect &rect1, const LayerRect &rect2);
   LayerRect Intersection(const LayerRect &rect1, const LayerRect &rect2);
   LayerRect Subtract(const LayerRect &rect1, const LayerRect &rect2);
+  void Coalesce(std::vector<LayerRect> *rects);
   LayerRect Reposition(const LayerRect &rect1, const int &x_offset, const int &y_offset);
   void SplitLeftRight(const LayerRect &in_rect, uint32_t split_count, uint32_t align_x,
                       bool flip_horizontal, LayerRect *out_rects);
@@ -30,12 +30,12 @@
 #ifndef __SYNC_TASK_H__
 #define __SYNC_TASK_H__
 
-#include <thread>
-#include <mutex>
-#include <condition_variable>   // NOLINT
+#include <utils/worker_pool.h>
 
 namespace sdm {
 
+// Runs the tasks of one handler on a lane of the process wide WorkerPool, one at a time and in
+// the order they were started.
 template <class TaskCode>
 class SyncTask {
  public:
@@ -52,90 +52,49 @@ class SyncTask {
     virtual void OnTask(const TaskCode &task_code, TaskContext *task_context) = 0;
   };
 
-  explicit SyncTask(TaskHandler &task_handler) : task_handler_(task_handler) {
-    // Block caller thread until worker thread has started and ready to listen to task commands.
-    // Worker thread will signal as soon as callback is received in the new thread.
-    std::unique_lock<std::mutex> caller_lock(caller_mutex_);
-    std::thread worker_thread(SyncTaskThread, this);
-    worker_thread_.swap(worker_thread);
-    caller_cv_.wait(caller_lock);
-  }
+  explicit SyncTask(TaskHandler &task_handler, WorkerPool::Lane lane = WorkerPool::kLaneGeneral)
+    : task_(task_handler), lane_(lane) { }
 
   ~SyncTask() {
-    // Task code does not matter here.
-    PerformTask(task_code_, nullptr, true);
-    worker_thread_.join();
+    task_.Wait();
   }
 
   void PerformTask(const TaskCode &task_code, TaskContext *task_context) {
-    PerformTask(task_code, task_context, false);
+    PerformTaskAsync(task_code, task_context);
+    task_.Wait();
   }
 
- private:
-  void PerformTask(const TaskCode &task_code, TaskContext *task_context, bool terminate) {
-    std::unique_lock<std::mutex> caller_lock(caller_mutex_);
-
-    // New scope to limit scope of worker lock to this block.
-    {
-      // Set task command code and notify worker thread.
-      std::unique_lock<std::mutex> worker_lock(worker_mutex_);
-      task_code_ = task_code;
-      task_context_ = task_context;
-      worker_thread_exit_ = terminate;
-      pending_code_ = true;
-      worker_cv_.notify_one();
-    }
-
-    // Wait for worker thread to finish and signal.
-    caller_cv_.wait(caller_lock);
+  // Starts the task and returns without waiting for it, after the previous task has completed.
+  // The context must stay valid until WaitForTask() returns.
+  void PerformTaskAsync(const TaskCode &task_code, TaskContext *task_context) {
+    task_.Wait();
+    task_.task_code_ = task_code;
+    task_.task_context_ = task_context;
+    WorkerPool::Get()->Submit(lane_, &task_);
   }
 
-  static void SyncTaskThread(SyncTask *sync_task) {
-    if (sync_task) {
-      sync_task->OnThreadCallback();
-    }
-  }
+  void WaitForTask() { task_.Wait(); }
+  bool IsTaskDone() { return task_.IsDone(); }
 
-  void OnThreadCallback() {
-    // Acquire worker lock and start waiting for events.
-    // Wait must start before caller thread can post events, otherwise posted events will be lost.
-    // Caller thread will be blocked until worker thread signals readiness.
-    std::unique_lock<std::mutex> worker_lock(worker_mutex_);
-
-    // New scope to limit scope of caller lock to this block.
-    {
-      // Signal caller thread that worker thread is ready to listen to events.
-      std::unique_lock<std::mutex> caller_lock(caller_mutex_);
-      caller_cv_.notify_one();
-    }
-
-    while (!worker_thread_exit_) {
-      // Add predicate to handle spurious interrupts.
-      // Wait for caller thread to signal new command codes.
-      worker_cv_.wait(worker_lock, [this] { return pending_code_; });
+ private:
+  class Task : public WorkerTask {
+   public:
+    explicit Task(TaskHandler &task_handler) : task_handler_(task_handler) { }
 
-      // Call task handler which is implemented by the caller.
-      if (!worker_thread_exit_) {
-        task_handler_.OnTask(task_code_, task_context_);
-      }
+    TaskCode task_code_ = {};
+    TaskContext *task_context_ = nullptr;
 
-      pending_code_ = false;
-      // Notify completion of current task to the caller thread which is blocked.
-      std::unique_lock<std::mutex> caller_lock(caller_mutex_);
-      caller_cv_.notify_one();
+   protected:
+    void Run() {
+      task_handler_.OnTask(task_code_, task_context_);
     }
-  }
 
-  TaskHandler &task_handler_;
-  TaskCode task_code_;
-  TaskContext *task_context_ = nullptr;
-  std::thread worker_thread_;
-  std::mutex caller_mutex_;
-  std::mutex worker_mutex_;
-  std::condition_variable caller_cv_;
-  std::condition_variable worker_cv_;
-  bool worker_thread_exit_ = false;
-  bool pending_code_ = false;
+   private:
+    TaskHandler &task_handler_;
+  };
+
+  Task task_;
+  WorkerPool::Lane lane_;
 };
 
 }  // namespace sdm
@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __VSYNC_MODEL_H__
+#define __VSYNC_MODEL_H__
+
+#include <stdint.h>
+#include <mutex>
+
+namespace sdm {
+
+// Tracks the phase and period of a display's vsync from hardware timestamps and predicts future
+// vsync times. The period is a least squares fit over a sliding window of recent timestamps,
+// each placed on the vsync grid so that missed samples do not skew it. Timestamps far off the
+// predicted grid are rejected; a run of them is treated as a phase change and restarts the model.
+class VsyncModel {
+ public:
+  // Restarts the model around the nominal period of the active mode.
+  void Reset(int64_t nominal_period_ns);
+  void AddSample(int64_t timestamp_ns);
+  // Returns the time of the index'th vsync strictly after time_ns, where index 0 is the first,
+  // or 0 if no vsync has been seen since the last reset.
+  int64_t PredictVsync(int64_t time_ns, uint32_t index);
+  // Returns the fitted period, or the nominal period until enough samples were seen.
+  int64_t GetPeriod();
+  // Returns the number of samples rejected as outliers since the last reset.
+  uint32_t GetOutlierCount();
+
+ private:
+  static const uint32_t kWindowSize = 20;
+  static const uint32_t kMinFitSamples = 6;
+  static const uint32_t kMaxConsecutiveOutliers = 3;
+  // A sample off the grid by more than 1/kOutlierDivisor of a period is rejected.
+  static const int64_t kOutlierDivisor = 5;
+  // A fit deviating from the nominal period by more than 1/kMaxDriftDivisor is discarded.
+  static const int64_t kMaxDriftDivisor = 10;
+
+  void Restart(int64_t timestamp_ns);
+  void Fit();
+
+  std::mutex lock_;
+  int64_t nominal_period_ns_ = 0;
+  int64_t period_ns_ = 0;
+  int64_t anchor_ns_ = 0;  // A vsync on the fitted grid
+  int64_t samples_[kWindowSize] = {};
+  uint32_t num_samples_ = 0;
+  uint32_t next_sample_ = 0;
+  uint32_t consecutive_outliers_ = 0;
+  uint32_t outlier_count_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __VSYNC_MODEL_H__
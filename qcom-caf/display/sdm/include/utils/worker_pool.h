@@ -0,0 +1,127 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+namespace sdm {
+
+// A unit of work run on a WorkerPool thread. The submitter owns the task, keeps it alive while it
+// is in flight and waits on it as the completion handle.
+class WorkerTask {
+ public:
+  virtual ~WorkerTask() { }
+  // Returns once Run() has returned on the worker, or right away if the task is not in flight.
+  // Spins briefly before it sleeps, as most tasks complete within microseconds.
+  void Wait();
+  bool IsDone() { return state_.load(std::memory_order_acquire) == kStateDone; }
+
+ protected:
+  virtual void Run() = 0;
+
+ private:
+  friend class WorkerPool;
+
+  enum : uint32_t {
+    kStateDone,
+    kStateQueued,
+    kStateWaited,  // Queued, and a thread sleeps on its completion
+  };
+
+  void Complete();
+
+  std::atomic<uint32_t> state_ { kStateDone };
+};
+
+// Process wide pool of worker threads, replacing a thread per task owner. Tasks are handed over
+// through lock free queues, workers spin briefly for the next task before they sleep on a futex,
+// so back to back tasks do not pay for a wake up and idle workers do not burn the CPU.
+// Threads of a lane are started on its first task.
+class WorkerPool {
+ public:
+  enum Lane {
+    // A single thread. EGL contexts are current on one thread at a time, so all GL work of the
+    // process is created, run and destroyed here.
+    kLaneGL,
+    // Any of kNumGeneralWorkers threads, for work that runs concurrently with the caller.
+    kLaneGeneral,
+    // A single thread for long CPU bound work, such as CPU tone mapping, which would hold up GL
+    // work and could wait on a present occupying a general thread.
+    kLaneCpu,
+    kLaneMax,
+  };
+
+  static WorkerPool *Get();
+  // Queues task on lane, after waiting for it if it is still in flight. A task must not wait on
+  // a task of its own lane.
+  void Submit(Lane lane, WorkerTask *task);
+
+ private:
+  static const uint32_t kQueueSize = 64;
+  static const uint32_t kCacheLineSize = 64;
+  // Two displays present concurrently with the primary.
+  static const uint32_t kNumGeneralWorkers = 2;
+
+  struct Slot {
+    std::atomic<uint32_t> sequence { 0 };
+    WorkerTask *task = nullptr;
+  };
+
+  // Bounded multi producer, multi consumer ring. A slot's sequence tells whether it is free for
+  // the producer at that position or holds a task for the consumer at that position.
+  // The producer and consumer positions are kept on cache lines of their own.
+  struct Queue {
+    Slot slots[kQueueSize];
+    uint8_t pad0[kCacheLineSize];
+    std::atomic<uint32_t> enqueue_pos { 0 };
+    uint8_t pad1[kCacheLineSize];
+    std::atomic<uint32_t> dequeue_pos { 0 };
+    uint8_t pad2[kCacheLineSize];
+    // Futex word bumped on every push, and the number of workers sleeping on it.
+    std::atomic<uint32_t> event { 0 };
+    std::atomic<uint32_t> sleepers { 0 };
+    std::once_flag started;
+  };
+
+  WorkerPool();
+  bool TryPush(Queue *queue, WorkerTask *task);
+  bool TryPop(Queue *queue, WorkerTask **task);
+  WorkerTask *Pop(Queue *queue);
+  void Run(Lane lane, uint32_t index);
+
+  Queue queues_[kLaneMax];
+};
+
+}  // namespace sdm
+
+#endif  // __WORKER_POOL_H__
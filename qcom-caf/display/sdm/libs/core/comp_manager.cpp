@@ -296,6 +296,8 @@ void CompManager::PrePrepare(Handle display_ctx, HWLayers *hw_layers) {
   display_comp_ctx->strategy->Start(&hw_layers->info, &display_comp_ctx->max_strategies,
                                     display_comp_ctx->pu_constraints);
   display_comp_ctx->remaining_strategies = display_comp_ctx->max_strategies;
+  display_comp_ctx->strategy_prepared = false;
+  display_comp_ctx->gpu_fallback = false;
 }
 
 DisplayError CompManager::Prepare(Handle display_ctx, HWLayers *hw_layers) {
@@ -314,6 +316,7 @@ DisplayError CompManager::Prepare(Handle display_ctx, HWLayers *hw_layers) {
 
   bool exit = false;
   uint32_t &count = display_comp_ctx->remaining_strategies;
+  uint32_t start_count = count;
   for (; !exit && count > 0; count--) {
     error = display_comp_ctx->strategy->GetNextStrategy(&display_comp_ctx->constraints);
     if (error != kErrorNone) {
@@ -329,23 +332,85 @@ DisplayError CompManager::Prepare(Handle display_ctx, HWLayers *hw_layers) {
     }
   }
 
+  // Prepare runs again with the remaining strategies when validation rejects the last one, only
+  // the strategies tried by this call are added. The frame is counted once in PostPrepare.
+  display_comp_ctx->stats.strategy_attempts += start_count - count;
+  display_comp_ctx->strategy_prepared = true;
+
   if (error != kErrorNone) {
     resource_intf_->Stop(display_resource_ctx, hw_layers);
     DLOGE("Composition strategies exhausted for display = %d", display_comp_ctx->display_type);
     return error;
   }
 
+  const HWLayersInfo &layer_info = hw_layers->info;
+  uint32_t gpu_layer_count = 0;
+  for (uint32_t i = 0; i < layer_info.app_layer_count; i++) {
+    if (layer_info.stack->layers.at(i)->composition == kCompositionGPU) {
+      gpu_layer_count++;
+    }
+  }
+  display_comp_ctx->gpu_fallback = gpu_layer_count &&
+                                   (gpu_layer_count == layer_info.app_layer_count);
+
   error = resource_intf_->Stop(display_resource_ctx, hw_layers);
 
   return error;
 }
 
+bool CompManager::CanReplayComposition(Handle display_ctx) {
+  SCOPE_LOCK(locker_);
+
+  return IsReplayAllowed(reinterpret_cast<DisplayCompositionContext *>(display_ctx));
+}
+
+bool CompManager::IsReplayAllowed(const DisplayCompositionContext *display_comp_ctx) {
+  // A composition replayed from an earlier frame was chosen without knowledge of the current
+  // resource split between displays or of any fallback that has kicked in since.
+  return !safe_mode_ && !display_comp_ctx->idle_fallback && !display_comp_ctx->thermal_fallback_ &&
+         (registered_displays_.count() <= 1);
+}
+
+DisplayError CompManager::PrepareCached(Handle display_ctx, HWLayers *hw_layers) {
+  SCOPE_LOCK(locker_);
+
+  DisplayCompositionContext *display_comp_ctx =
+                             reinterpret_cast<DisplayCompositionContext *>(display_ctx);
+  Handle &display_resource_ctx = display_comp_ctx->display_resource_ctx;
+
+  // Rechecked under the lock, a fallback may have kicked in since DisplayBase checked.
+  if (!IsReplayAllowed(display_comp_ctx)) {
+    return kErrorNotSupported;
+  }
+
+  resource_intf_->Start(display_resource_ctx);
+
+  DisplayError error = resource_intf_->Prepare(display_resource_ctx, hw_layers);
+  if (error != kErrorNone) {
+    resource_intf_->Stop(display_resource_ctx, hw_layers);
+    return error;
+  }
+
+  display_comp_ctx->stats.replayed_frames++;
+
+  return resource_intf_->Stop(display_resource_ctx, hw_layers);
+}
+
 DisplayError CompManager::PostPrepare(Handle display_ctx, HWLayers *hw_layers) {
   SCOPE_LOCK(locker_);
   DisplayCompositionContext *display_comp_ctx =
                              reinterpret_cast<DisplayCompositionContext *>(display_ctx);
   Handle &display_resource_ctx = display_comp_ctx->display_resource_ctx;
 
+  if (display_comp_ctx->strategy_prepared) {
+    CompositionStats &stats = display_comp_ctx->stats;
+    stats.frames++;
+    if (display_comp_ctx->gpu_fallback) {
+      stats.gpu_fallback_frames++;
+    }
+    display_comp_ctx->strategy_prepared = false;
+  }
+
   DisplayError error = kErrorNone;
   error = resource_intf_->PostPrepare(display_resource_ctx, hw_layers);
   if (error != kErrorNone) {
@@ -608,4 +673,12 @@ bool CompManager::SetDisplayState(Handle display_ctx,
   return true;
 }
 
+void CompManager::GetCompositionStats(Handle display_ctx, CompositionStats *stats) {
+  SCOPE_LOCK(locker_);
+  DisplayCompositionContext *display_comp_ctx =
+                             reinterpret_cast<DisplayCompositionContext *>(display_ctx);
+
+  *stats = display_comp_ctx->stats;
+}
+
 }  // namespace sdm
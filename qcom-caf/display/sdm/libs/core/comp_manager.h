@@ -36,6 +36,13 @@
 
 namespace sdm {
 
+struct CompositionStats {
+  uint64_t frames = 0;               // Frames prepared through strategy selection
+  uint64_t strategy_attempts = 0;    // Strategies tried across those frames
+  uint64_t gpu_fallback_frames = 0;  // Frames where every app layer ended up on GPU
+  uint64_t replayed_frames = 0;      // Frames prepared from a cached composition
+};
+
 class CompManager {
  public:
   DisplayError Init(const HWResourceInfo &hw_res_info_, ExtensionInterface *extension_intf,
@@ -53,6 +60,9 @@ class CompManager {
                                   const DisplayConfigVariableInfo &fb_config);
   void PrePrepare(Handle display_ctx, HWLayers *hw_layers);
   DisplayError Prepare(Handle display_ctx, HWLayers *hw_layers);
+  // Whether a composition cached on an earlier frame may be replayed on this display now.
+  bool CanReplayComposition(Handle display_ctx);
+  DisplayError PrepareCached(Handle display_ctx, HWLayers *hw_layers);
   DisplayError Commit(Handle display_ctx, HWLayers *hw_layers);
   DisplayError PostPrepare(Handle display_ctx, HWLayers *hw_layers);
   DisplayError ReConfigure(Handle display_ctx, HWLayers *hw_layers);
@@ -75,6 +85,7 @@ class CompManager {
   DisplayError SetCompositionState(Handle display_ctx, LayerComposition composition_type,
                                    bool enable);
   DisplayError ControlDpps(bool enable);
+  void GetCompositionStats(Handle display_ctx, CompositionStats *stats);
 
  private:
   static const int kMaxThermalLevel = 3;
@@ -89,6 +100,8 @@ class CompManager {
     DisplayType display_type = kPrimary;
     uint32_t max_strategies = 0;
     uint32_t remaining_strategies = 0;
+    bool strategy_prepared = false;  // Prepare ran for the current frame
+    bool gpu_fallback = false;       // and its last successful call put every app layer on GPU
     bool idle_fallback = false;
     bool thermal_fallback_ = false;
     // Using primary panel flag of hw panel to configure Constraints. We do not need other hw
@@ -98,8 +111,11 @@ class CompManager {
     PUConstraints pu_constraints = {};
     bool scaled_composition = false;
     DisplayConfigVariableInfo fb_config = {};
+    CompositionStats stats = {};
   };
 
+  bool IsReplayAllowed(const DisplayCompositionContext *display_comp_ctx);
+
   Locker locker_;
   ResourceInterface *resource_intf_ = NULL;
   std::bitset<kDisplayMax> registered_displays_;  // Bit mask of registered displays
@@ -0,0 +1,264 @@
+/*
+* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <iterator>
+
+#include "composition_cache.h"
+
+#define __CLASS__ "CompositionCache"
+
+namespace sdm {
+
+static const uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+static const uint64_t kFnvPrime = 0x100000001b3ULL;
+
+static inline void HashBytes(const void *data, size_t size, uint64_t *hash) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    *hash ^= bytes[i];
+    *hash *= kFnvPrime;
+  }
+}
+
+template <class T>
+static inline void Hash(const T &value, uint64_t *hash) {
+  HashBytes(&value, sizeof(value), hash);
+}
+
+static inline void HashRect(const LayerRect &rect, uint64_t *hash) {
+  Hash(rect.left, hash);
+  Hash(rect.top, hash);
+  Hash(rect.right, hash);
+  Hash(rect.bottom, hash);
+}
+
+uint64_t CompositionCache::GetFingerprint(const LayerStack &layer_stack, uint32_t app_layer_count,
+                                          const HWMixerAttributes &mixer_attributes,
+                                          const DisplayConfigVariableInfo &fb_config,
+                                          uint32_t max_mixer_stages) {
+  uint64_t hash = kFnvOffsetBasis;
+  LayerStackFlags stack_flags = layer_stack.flags;
+
+  // Geometry changes are already reflected in the per layer attributes below.
+  stack_flags.geometry_changed = 0;
+  Hash(stack_flags.flags, &hash);
+  Hash(mixer_attributes.width, &hash);
+  Hash(mixer_attributes.height, &hash);
+  Hash(fb_config.x_pixels, &hash);
+  Hash(fb_config.y_pixels, &hash);
+  Hash(max_mixer_stages, &hash);
+  Hash(app_layer_count, &hash);
+
+  // Layers are hashed in z-order, so reordering the same set of layers yields a new fingerprint.
+  for (Layer *layer : layer_stack.layers) {
+    const LayerBuffer &buffer = layer->input_buffer;
+
+    Hash(layer->composition, &hash);
+    HashRect(layer->src_rect, &hash);
+    HashRect(layer->dst_rect, &hash);
+    for (const LayerRect &rect : layer->visible_regions) {
+      HashRect(rect, &hash);
+    }
+    Hash(layer->blending, &hash);
+    Hash(layer->transform.rotation, &hash);
+    Hash(layer->transform.flip_horizontal, &hash);
+    Hash(layer->transform.flip_vertical, &hash);
+    Hash(layer->plane_alpha, &hash);
+    Hash(layer->frame_rate, &hash);
+    Hash(layer->solid_fill_color, &hash);
+    Hash(layer->flags.flags, &hash);
+
+    Hash(buffer.width, &hash);
+    Hash(buffer.height, &hash);
+    Hash(buffer.unaligned_width, &hash);
+    Hash(buffer.unaligned_height, &hash);
+    Hash(buffer.format, &hash);
+    Hash(buffer.flags.flags, &hash);
+    Hash(buffer.s3d_format, &hash);
+    Hash(buffer.igc, &hash);
+    Hash(buffer.color_metadata.colorPrimaries, &hash);
+    Hash(buffer.color_metadata.range, &hash);
+    Hash(buffer.color_metadata.transfer, &hash);
+    Hash(buffer.color_metadata.matrixCoefficients, &hash);
+  }
+
+  return hash;
+}
+
+bool CompositionCache::IsCacheable(const HWLayers &hw_layers) {
+  const HWLayersInfo &info = hw_layers.info;
+
+  // Rotator sessions and destination scalar data are owned by the resource manager and the
+  // extension respectively, and cannot outlive the frame they were created for.
+  if (!info.dest_scale_info_map.empty() || info.hw_layers.size() > kMaxSDELayers) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < info.hw_layers.size(); i++) {
+    if (hw_layers.config[i].hw_rotator_session.hw_block_count) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+CompositionCache::Entry *CompositionCache::Find(uint64_t fingerprint) {
+  for (Entry &entry : entries_) {
+    if (entry.fingerprint == fingerprint) {
+      return &entry;
+    }
+  }
+
+  return nullptr;
+}
+
+bool CompositionCache::Restore(uint64_t fingerprint, HWLayers *hw_layers) {
+  HWLayersInfo &info = hw_layers->info;
+  Entry *entry = Find(fingerprint);
+
+  if (!entry || entry->composition.size() != info.app_layer_count) {
+    misses_++;
+    return false;
+  }
+
+  std::vector<Layer *> &layers = info.stack->layers;
+  saved_composition_.resize(info.app_layer_count);
+  saved_request_.resize(info.app_layer_count);
+  for (uint32_t i = 0; i < info.app_layer_count; i++) {
+    saved_composition_[i] = layers.at(i)->composition;
+    saved_request_[i] = layers.at(i)->request;
+    layers.at(i)->composition = entry->composition[i];
+    layers.at(i)->request = entry->request[i];
+  }
+
+  info.hw_layers = entry->info.hw_layers;
+  std::copy(entry->info.index, entry->info.index + kMaxSDELayers, info.index);
+  // The cached layers carry the buffers of the frame they were inserted with, whose fds may be
+  // closed and reused by now. Validate checks the buffers of this frame instead.
+  for (uint32_t i = 0; i < info.hw_layers.size(); i++) {
+    const LayerBuffer &buffer = layers.at(info.index[i])->input_buffer;
+    LayerBuffer &hw_buffer = info.hw_layers.at(i).input_buffer;
+    std::copy(std::begin(buffer.planes), std::end(buffer.planes), hw_buffer.planes);
+    hw_buffer.size = buffer.size;
+    hw_buffer.buffer_id = buffer.buffer_id;
+    hw_buffer.acquire_fence_fd = buffer.acquire_fence_fd;
+  }
+  info.dest_scale_info_map.clear();
+  std::copy(entry->info.roi_index, entry->info.roi_index + kMaxSDELayers, info.roi_index);
+  info.left_frame_roi = entry->info.left_frame_roi;
+  info.right_frame_roi = entry->info.right_frame_roi;
+  info.partial_fb_roi = entry->info.partial_fb_roi;
+  info.roi_split = entry->info.roi_split;
+  info.use_hw_cursor = entry->info.use_hw_cursor;
+  std::copy(entry->config, entry->config + kMaxSDELayers, hw_layers->config);
+
+  entry->last_use = ++tick_;
+  hits_++;
+
+  DLOGV_IF(kTagDisplay, "Replaying composition for fingerprint %" PRIx64, fingerprint);
+
+  return true;
+}
+
+void CompositionCache::Insert(uint64_t fingerprint, const HWLayers &hw_layers) {
+  const HWLayersInfo &info = hw_layers.info;
+  Entry *entry = Find(fingerprint);
+
+  if (!entry) {
+    if (entries_.size() < kMaxEntries) {
+      entries_.push_back(Entry());
+      entry = &entries_.back();
+    } else {
+      entry = &*std::min_element(entries_.begin(), entries_.end(),
+                                 [](const Entry &a, const Entry &b) {
+                                   return a.last_use < b.last_use;
+                                 });
+      evictions_++;
+    }
+    inserts_++;
+  }
+
+  entry->fingerprint = fingerprint;
+  entry->last_use = ++tick_;
+  entry->composition.resize(info.app_layer_count);
+  entry->request.resize(info.app_layer_count);
+  for (uint32_t i = 0; i < info.app_layer_count; i++) {
+    entry->composition[i] = info.stack->layers.at(i)->composition;
+    entry->request[i] = info.stack->layers.at(i)->request;
+  }
+
+  entry->info.hw_layers = info.hw_layers;
+  for (Layer &layer : entry->info.hw_layers) {
+    // Buffer handles and fences are refreshed from the layer stack in Commit().
+    layer.input_buffer.acquire_fence_fd = -1;
+    layer.input_buffer.release_fence_fd = -1;
+  }
+  std::copy(info.index, info.index + kMaxSDELayers, entry->info.index);
+  std::copy(info.roi_index, info.roi_index + kMaxSDELayers, entry->info.roi_index);
+  entry->info.left_frame_roi = info.left_frame_roi;
+  entry->info.right_frame_roi = info.right_frame_roi;
+  entry->info.partial_fb_roi = info.partial_fb_roi;
+  entry->info.roi_split = info.roi_split;
+  entry->info.use_hw_cursor = info.use_hw_cursor;
+  std::copy(hw_layers.config, hw_layers.config + kMaxSDELayers, entry->config);
+}
+
+void CompositionCache::Evict(uint64_t fingerprint, HWLayers *hw_layers) {
+  std::vector<Layer *> &layers = hw_layers->info.stack->layers;
+  for (uint32_t i = 0; i < saved_composition_.size(); i++) {
+    layers.at(i)->composition = saved_composition_[i];
+    layers.at(i)->request = saved_request_[i];
+  }
+
+  for (auto it = entries_.begin(); it != entries_.end(); it++) {
+    if (it->fingerprint == fingerprint) {
+      entries_.erase(it);
+      break;
+    }
+  }
+
+  replay_failures_++;
+}
+
+void CompositionCache::Clear() {
+  evictions_ += entries_.size();
+  entries_.clear();
+}
+
+void CompositionCache::AppendDump(std::ostringstream *os) {
+  uint64_t lookups = hits_ + misses_;
+  uint64_t hit_rate = lookups ? (hits_ * 100 / lookups) : 0;
+
+  *os << "\ncomposition cache: entries: " << entries_.size() << "/" << kMaxEntries;
+  *os << " hits: " << hits_ << " misses: " << misses_ << " (" << hit_rate << "% hit)";
+  *os << " replay failures: " << replay_failures_ << " inserts: " << inserts_;
+  *os << " evictions: " << evictions_;
+}
+
+}  // namespace sdm
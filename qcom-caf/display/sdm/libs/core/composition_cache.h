@@ -0,0 +1,81 @@
+/*
+* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __COMPOSITION_CACHE_H__
+#define __COMPOSITION_CACHE_H__
+
+#include <core/layer_stack.h>
+#include <private/hw_info_types.h>
+#include <sstream>
+#include <vector>
+
+namespace sdm {
+
+// Remembers the outcome of strategy selection for recently seen layer stacks. A layer stack is
+// identified by a fingerprint over every layer attribute the strategy looks at, so a hit lets the
+// display replay the previous composition and go straight to resource allocation and validation.
+class CompositionCache {
+ public:
+  static uint64_t GetFingerprint(const LayerStack &layer_stack, uint32_t app_layer_count,
+                                 const HWMixerAttributes &mixer_attributes,
+                                 const DisplayConfigVariableInfo &fb_config,
+                                 uint32_t max_mixer_stages);
+  static bool IsCacheable(const HWLayers &hw_layers);
+
+  bool Restore(uint64_t fingerprint, HWLayers *hw_layers);
+  void Insert(uint64_t fingerprint, const HWLayers &hw_layers);
+  // Drops fingerprint after its replay was rejected, and gives the layers back the composition
+  // and request Restore() replaced, so that the strategy sees the stack it was handed.
+  void Evict(uint64_t fingerprint, HWLayers *hw_layers);
+  void Clear();
+  void AppendDump(std::ostringstream *os);
+
+ private:
+  static const uint32_t kMaxEntries = 8;
+
+  struct Entry {
+    uint64_t fingerprint = 0;
+    uint64_t last_use = 0;
+    std::vector<LayerComposition> composition = {};  // Per app layer composition
+    std::vector<LayerRequest> request = {};          // Per app layer request
+    HWLayersInfo info = {};
+    HWLayerConfig config[kMaxSDELayers] = {};
+  };
+
+  Entry *Find(uint64_t fingerprint);
+
+  std::vector<Entry> entries_ = {};
+  std::vector<LayerComposition> saved_composition_ = {};  // Of the frame being replayed
+  std::vector<LayerRequest> saved_request_ = {};
+  uint64_t tick_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t replay_failures_ = 0;
+  uint64_t inserts_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __COMPOSITION_CACHE_H__
@@ -114,6 +114,7 @@ DisplayError DisplayBase::Init() {
   }
 
   Debug::Get()->GetProperty(DISABLE_HDR_LUT_GEN, &disable_hdr_lut_gen_);
+  Debug::Get()->GetProperty(ENABLE_COMP_RESULT_CACHE_PROP, &comp_cache_enabled_);
 
   return kErrorNone;
 
@@ -145,6 +146,20 @@ DisplayError DisplayBase::Deinit() {
   return kErrorNone;
 }
 
+bool DisplayBase::CanUseCompositionCache(LayerStack *layer_stack) {
+  if (!comp_cache_enabled_ || layer_stack->flags.hdr_present) {
+    return false;
+  }
+
+  // Partial update derives a new ROI from the dirty regions of every frame.
+  if (hw_panel_info_.partial_update && partial_update_control_) {
+    return false;
+  }
+
+  // Checked before Restore, so that these frames do not go through a rejected replay.
+  return comp_manager_->CanReplayComposition(display_comp_ctx_);
+}
+
 void DisplayBase::CheckMinMixerResolution(uint32_t *width, uint32_t *height) {
   HWDisplayAttributes display_attributes = {};
   hw_intf_->GetDisplayAttributes(mixer_config_index_, &display_attributes);
@@ -259,6 +274,29 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
   }
 
   comp_manager_->PrePrepare(display_comp_ctx_, &hw_layers_);
+
+  uint64_t fingerprint = 0;
+  bool use_cache = CanUseCompositionCache(layer_stack);
+  if (use_cache) {
+    fingerprint = CompositionCache::GetFingerprint(*layer_stack, hw_layers_.info.app_layer_count,
+                                                   mixer_attributes_, fb_config_,
+                                                   max_mixer_stages_);
+    if (comp_cache_.Restore(fingerprint, &hw_layers_)) {
+      error = comp_manager_->PrepareCached(display_comp_ctx_, &hw_layers_);
+      if (error == kErrorNone) {
+        error = hw_intf_->Validate(&hw_layers_);
+      }
+      if (error == kErrorNone || error == kErrorShutDown) {
+        needs_validate_ = (error != kErrorNone);
+        comp_manager_->PostPrepare(display_comp_ctx_, &hw_layers_);
+        return error;
+      }
+
+      // Replay was rejected, fall back to a full strategy selection for this frame.
+      comp_cache_.Evict(fingerprint, &hw_layers_);
+    }
+  }
+
   while (true) {
     error = comp_manager_->Prepare(display_comp_ctx_, &hw_layers_);
     if (error != kErrorNone) {
@@ -277,6 +315,10 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
     }
   }
 
+  if (use_cache && error == kErrorNone && CompositionCache::IsCacheable(hw_layers_)) {
+    comp_cache_.Insert(fingerprint, hw_layers_);
+  }
+
   comp_manager_->PostPrepare(display_comp_ctx_, &hw_layers_);
 
   DLOGI_IF(kTagDisplay, "Exiting Prepare for display type : %d", display_type_);
@@ -358,6 +400,7 @@ DisplayError DisplayBase::Flush(bool secure) {
     return kErrorPermission;
   }
   hw_layers_.info.hw_layers.clear();
+  comp_cache_.Clear();
   error = hw_intf_->Flush(secure);
   if (error == kErrorNone) {
     comp_manager_->Purge(display_comp_ctx_);
@@ -497,6 +540,7 @@ DisplayError DisplayBase::SetDisplayState(DisplayState state) {
   }
 
   if (error == kErrorNone) {
+    comp_cache_.Clear();
     active_ = active;
     state_ = state;
     comp_manager_->SetDisplayState(display_comp_ctx_, state, display_type_);
@@ -538,6 +582,7 @@ DisplayError DisplayBase::SetMaxMixerStages(uint32_t max_mixer_stages) {
 
   if (error == kErrorNone) {
     max_mixer_stages_ = max_mixer_stages;
+    comp_cache_.Clear();
   }
 
   return error;
@@ -561,6 +606,21 @@ std::string DisplayBase::Dump() {
 
   DisplayConfigVariableInfo &info = attrib;
 
+  CompositionStats comp_stats = {};
+  comp_manager_->GetCompositionStats(display_comp_ctx_, &comp_stats);
+  os << "\nframes: " << comp_stats.frames << " strategy attempts: " << comp_stats.strategy_attempts;
+  if (comp_stats.frames) {
+    os.precision(2);
+    os << " (" << std::fixed << FLOAT(comp_stats.strategy_attempts) / FLOAT(comp_stats.frames)
+      << " per frame) GPU fallback: " << comp_stats.gpu_fallback_frames * 100 / comp_stats.frames
+      << "%";
+  }
+  os << " replayed: " << comp_stats.replayed_frames;
+
+  if (comp_cache_enabled_) {
+    comp_cache_.AppendDump(&os);
+  }
+
   uint32_t num_hw_layers = UINT32(hw_layers_.info.hw_layers.size());
 
   if (num_hw_layers == 0) {
@@ -1080,6 +1140,7 @@ DisplayError DisplayBase::ReconfigureDisplay() {
   display_attributes_ = display_attributes;
   mixer_attributes_ = mixer_attributes;
   hw_panel_info_ = hw_panel_info;
+  comp_cache_.Clear();
 
   DLOGV("Display reconfigured.");
   return kErrorNone;
@@ -1314,6 +1375,7 @@ bool DisplayBase::IsPrimaryDisplay() {
 DisplayError DisplayBase::SetCompositionState(LayerComposition composition_type, bool enable) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
 
+  comp_cache_.Clear();
   return comp_manager_->SetCompositionState(display_comp_ctx_, composition_type, enable);
 }
 
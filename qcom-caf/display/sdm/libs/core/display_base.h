@@ -37,6 +37,7 @@
 #include "hw_interface.h"
 #include "comp_manager.h"
 #include "color_manager.h"
+#include "composition_cache.h"
 #include "hw_events_interface.h"
 
 namespace sdm {
@@ -114,6 +115,9 @@ class DisplayBase : public DisplayInterface {
   virtual DisplayError GetClientTargetSupport(uint32_t width, uint32_t height,
                                               LayerBufferFormat format,
                                               const ColorMetaData &color_metadata);
+  virtual DisplayError GetOutputBufferSupport(LayerBufferFormat format) {
+    return kErrorNotSupported;
+  }
   virtual std::string Dump();
   virtual DisplayError SetDynamicDSIClock(uint64_t bitclk) {
     return kErrorNotSupported;
@@ -147,6 +151,7 @@ class DisplayBase : public DisplayInterface {
   DisplayError GetHdrColorMode(std::string *color_mode, bool *found_hdr);
   bool IsSupportColorModeAttribute(const std::string &color_mode);
   void CheckMinMixerResolution(uint32_t *width, uint32_t *height);
+  bool CanUseCompositionCache(LayerStack *layer_stack);
 
   recursive_mutex recursive_mutex_;
   DisplayType display_type_;
@@ -187,6 +192,8 @@ class DisplayBase : public DisplayInterface {
   uint32_t panel_config_index_ = 0;
   uint32_t mixer_config_index_ = 0;
   bool dest_scale_enabled_ = false;
+  int comp_cache_enabled_ = 0;
+  CompositionCache comp_cache_;
 };
 
 }  // namespace sdm
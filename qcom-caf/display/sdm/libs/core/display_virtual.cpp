@@ -68,11 +68,32 @@ DisplayError DisplayVirtual::Init() {
       max_mixer_stages = std::min(UINT32(property_value), hw_resource_info.num_blending_stages);
     }
     DisplayBase::SetMaxMixerStages(max_mixer_stages);
+
+    auto it = hw_resource_info.supported_formats_map.find(kHWWBIntfOutput);
+    if (it != hw_resource_info.supported_formats_map.end()) {
+      wb_output_formats_ = it->second;
+    }
   }
 
   return error;
 }
 
+DisplayError DisplayVirtual::GetOutputBufferSupport(LayerBufferFormat format) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+
+  // Drivers that do not advertise writeback formats are assumed to accept any format.
+  if (wb_output_formats_.empty()) {
+    return kErrorNone;
+  }
+
+  if (std::find(wb_output_formats_.begin(), wb_output_formats_.end(), format) ==
+      wb_output_formats_.end()) {
+    return kErrorNotSupported;
+  }
+
+  return kErrorNone;
+}
+
 DisplayError DisplayVirtual::GetNumVariableInfoConfigs(uint32_t *count) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
   *count = 1;
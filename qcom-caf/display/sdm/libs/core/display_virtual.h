@@ -26,6 +26,7 @@
 #define __DISPLAY_VIRTUAL_H__
 
 #include <private/hw_info_types.h>
+#include <vector>
 #include "display_base.h"
 
 namespace sdm {
@@ -58,11 +59,15 @@ class DisplayVirtual : public DisplayBase {
   virtual DisplayError SetDetailEnhancerData(const DisplayDetailEnhancerData &de_data) {
     return kErrorNotSupported;
   }
+  virtual DisplayError GetOutputBufferSupport(LayerBufferFormat format);
   virtual DisplayError ValidateGPUTargetParams() {
     // TODO(user): Validate GPU target for virtual display when query display attributes
     // on virtual display is functional.
     return kErrorNone;
   }
+
+ private:
+  std::vector<LayerBufferFormat> wb_output_formats_ = {};
 };
 
 }  // namespace sdm
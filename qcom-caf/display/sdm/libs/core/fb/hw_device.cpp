@@ -52,6 +52,7 @@
 #include "hw_hdmi.h"
 #include "hw_virtual.h"
 #include "hw_info_interface.h"
+#include "hw_sysfs_reader.h"
 
 #define __CLASS__ "HWDevice"
 
@@ -784,6 +785,9 @@ int HWDevice::GetFBNodeIndex(HWDeviceType device_type) {
 }
 
 void HWDevice::PopulateHWPanelInfo() {
+  // Always read the nodes of this device afresh, it is either being brought up or was just
+  // reconfigured by this process without a uevent.
+  HWSysfsReader::Get()->InvalidatePanelInfo(fb_node_index_);
   hw_panel_info_ = HWPanelInfo();
   GetHWPanelInfoByNode(fb_node_index_, &hw_panel_info_);
   DLOGI("Device type = %d, Display Port = %d, Display Mode = %d, Device Node = %d, Is Primary = %d",
@@ -809,21 +813,17 @@ void HWDevice::PopulateBitClkRates() {
   }
 
   char bitclk_str[kMaxStringLength] = {'\0'};
-  char bitclk_path[kMaxStringLength] = {'\0'};
-  snprintf(bitclk_path, sizeof(bitclk_path), "%s%d/supported_bitclk", fb_path_, fb_node_index_);
-  int fd = Sys::open_(bitclk_path, O_RDONLY);
-  if (fd < 0) {
+  string bitclk_path = fb_path_ + to_string(fb_node_index_) + "/supported_bitclk";
+  ssize_t length = HWSysfsReader::Get()->Read(bitclk_path, bitclk_str, sizeof(bitclk_str));
+  if (length < 0) {
     DLOGE("BitClk file open failed.");
     return;
   }
 
-  ssize_t length = Sys::pread_(fd, bitclk_str, sizeof(bitclk_str) - 1, 0);
-  if (length <= 0) {
-    DLOGE("%s: bitclk_modes file empty");
-    Sys::close_(fd);
+  if (length == 0) {
+    DLOGE("bitclk_modes file empty");
     return;
   }
-  Sys::close_(fd);
 
   DLOGI("Bit Clk string: %s", bitclk_str);
   bitclk_str[length] = '\0';
@@ -849,117 +849,115 @@ void HWDevice::PopulateBitClkRates() {
 
 }
 
-void HWDevice::GetHWPanelNameByNode(int device_node, HWPanelInfo *panel_info) {
-  string file_name = fb_path_ + to_string(device_node) + "/msm_fb_panel_info";
+void HWDevice::GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info) {
+  HWSysfsReader *sysfs_reader = HWSysfsReader::Get();
+  if (sysfs_reader->GetPanelInfo(device_node, panel_info)) {
+    return;
+  }
 
-  Sys::fstream fs(file_name, fstream::in);
-  if (!fs.is_open()) {
+  string file_name = fb_path_ + to_string(device_node) + "/msm_fb_panel_info";
+  char data[kMaxSysfsLength] = { 0 };
+  if (sysfs_reader->Read(file_name, data, sizeof(data)) < 0) {
     DLOGW("Failed to open msm_fb_panel_info node device node %d", device_node);
     return;
   }
 
-  string line;
-  while (Sys::getline_(fs, line)) {
-    uint32_t token_count = 0;
-    const uint32_t max_count = 10;
-    char *tokens[max_count] = { NULL };
-    if (!ParseLine(line.c_str(), "=\n", tokens, max_count, &token_count)) {
-      if (!strncmp(tokens[0], "panel_name", strlen("panel_name"))) {
-        snprintf(panel_info->panel_name, sizeof(panel_info->panel_name), "%s", tokens[1]);
-        break;
-      }
+  // The node is a block of "key=value" lines, parsed in place in a single pass.
+  char *line = data;
+  while (line && *line) {
+    char *next_line = strchr(line, '\n');
+    if (next_line) {
+      *next_line++ = '\0';
     }
-  }
-}
 
-void HWDevice::GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info) {
-  string file_name = fb_path_ + to_string(device_node) + "/msm_fb_panel_info";
+    char *value = strchr(line, '=');
+    if (!value) {
+      line = next_line;
+      continue;
+    }
+    *value++ = '\0';
 
-  Sys::fstream fs(file_name, fstream::in);
-  if (!fs.is_open()) {
-    DLOGW("Failed to open msm_fb_panel_info node device node %d", device_node);
-    return;
-  }
+    char *key = line;
+    while (*key == ' ') {
+      key++;
+    }
 
-  string line;
-  while (Sys::getline_(fs, line)) {
-    uint32_t token_count = 0;
-    const uint32_t max_count = 10;
-    char *tokens[max_count] = { NULL };
-    if (!ParseLine(line.c_str(), tokens, max_count, &token_count)) {
-      if (!strncmp(tokens[0], "pu_en", strlen("pu_en"))) {
-        panel_info->partial_update = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "xstart", strlen("xstart"))) {
-        panel_info->left_align = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "walign", strlen("walign"))) {
-        panel_info->width_align = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "ystart", strlen("ystart"))) {
-        panel_info->top_align = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "halign", strlen("halign"))) {
-        panel_info->height_align = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "min_w", strlen("min_w"))) {
-        panel_info->min_roi_width = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "min_h", strlen("min_h"))) {
-        panel_info->min_roi_height = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "roi_merge", strlen("roi_merge"))) {
-        panel_info->needs_roi_merge = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "dyn_fps_en", strlen("dyn_fps_en"))) {
-        panel_info->dynamic_fps = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "dfps_porch_mode", strlen("dfps_porch_mode"))) {
-        panel_info->dfps_porch_mode = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "is_pingpong_split", strlen("is_pingpong_split"))) {
-        panel_info->ping_pong_split = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "min_fps", strlen("min_fps"))) {
-        panel_info->min_fps = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "max_fps", strlen("max_fps"))) {
-        panel_info->max_fps = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "primary_panel", strlen("primary_panel"))) {
-        panel_info->is_primary_panel = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "is_pluggable", strlen("is_pluggable"))) {
-        panel_info->is_pluggable = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "pu_roi_cnt", strlen("pu_roi_cnt"))) {
-        panel_info->left_roi_count = UINT32(atoi(tokens[1]));
-        panel_info->right_roi_count = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "is_hdr_enabled", strlen("is_hdr_enabled"))) {
-        panel_info->hdr_enabled = atoi(tokens[1]);
-      } else if (!strncmp(tokens[0], "peak_brightness", strlen("peak_brightness"))) {
-        panel_info->peak_luminance = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "average_brightness", strlen("average_brightness"))) {
-        panel_info->average_luminance = UINT32(panel_info->peak_luminance +
-                                            panel_info->blackness_level) / 2;
-      } else if (!strncmp(tokens[0], "blackness_level", strlen("blackness_level"))) {
-        panel_info->blackness_level = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "white_chromaticity_x", strlen("white_chromaticity_x"))) {
-        panel_info->primaries.white_point[0] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "white_chromaticity_y", strlen("white_chromaticity_y"))) {
-        panel_info->primaries.white_point[1] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "red_chromaticity_x", strlen("red_chromaticity_x"))) {
-        panel_info->primaries.red[0] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "red_chromaticity_y", strlen("red_chromaticity_y"))) {
-        panel_info->primaries.red[1] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "green_chromaticity_x", strlen("green_chromaticity_x"))) {
-        panel_info->primaries.green[0] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "green_chromaticity_y", strlen("green_chromaticity_y"))) {
-        panel_info->primaries.green[1] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "blue_chromaticity_x", strlen("blue_chromaticity_x"))) {
-        panel_info->primaries.blue[0] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "blue_chromaticity_y", strlen("blue_chromaticity_y"))) {
-        panel_info->primaries.blue[1] = UINT32(atoi(tokens[1]));
-      } else if (!strncmp(tokens[0], "panel_orientation", strlen("panel_orientation"))) {
-        int32_t panel_orient = atoi(tokens[1]);
-        panel_info->panel_orientation.flip_horizontal = ((panel_orient & MDP_FLIP_LR) > 0);
-        panel_info->panel_orientation.flip_vertical = ((panel_orient & MDP_FLIP_UD) > 0);
-        panel_info->panel_orientation.rotation = ((panel_orient & MDP_ROT_90) > 0);
-      } else if (!strncmp(tokens[0], "dyn_bitclk_en", strlen("dyn_bitclk_en"))) {
-        panel_info->bitclk_update = atoi(tokens[1]);
-      }
+    if (!strncmp(key, "pu_en", strlen("pu_en"))) {
+      panel_info->partial_update = atoi(value);
+    } else if (!strncmp(key, "xstart", strlen("xstart"))) {
+      panel_info->left_align = atoi(value);
+    } else if (!strncmp(key, "walign", strlen("walign"))) {
+      panel_info->width_align = atoi(value);
+    } else if (!strncmp(key, "ystart", strlen("ystart"))) {
+      panel_info->top_align = atoi(value);
+    } else if (!strncmp(key, "halign", strlen("halign"))) {
+      panel_info->height_align = atoi(value);
+    } else if (!strncmp(key, "min_w", strlen("min_w"))) {
+      panel_info->min_roi_width = atoi(value);
+    } else if (!strncmp(key, "min_h", strlen("min_h"))) {
+      panel_info->min_roi_height = atoi(value);
+    } else if (!strncmp(key, "roi_merge", strlen("roi_merge"))) {
+      panel_info->needs_roi_merge = atoi(value);
+    } else if (!strncmp(key, "dyn_fps_en", strlen("dyn_fps_en"))) {
+      panel_info->dynamic_fps = atoi(value);
+    } else if (!strncmp(key, "dfps_porch_mode", strlen("dfps_porch_mode"))) {
+      panel_info->dfps_porch_mode = atoi(value);
+    } else if (!strncmp(key, "is_pingpong_split", strlen("is_pingpong_split"))) {
+      panel_info->ping_pong_split = atoi(value);
+    } else if (!strncmp(key, "min_fps", strlen("min_fps"))) {
+      panel_info->min_fps = UINT32(atoi(value));
+    } else if (!strncmp(key, "max_fps", strlen("max_fps"))) {
+      panel_info->max_fps = UINT32(atoi(value));
+    } else if (!strncmp(key, "primary_panel", strlen("primary_panel"))) {
+      panel_info->is_primary_panel = atoi(value);
+    } else if (!strncmp(key, "is_pluggable", strlen("is_pluggable"))) {
+      panel_info->is_pluggable = atoi(value);
+    } else if (!strncmp(key, "pu_roi_cnt", strlen("pu_roi_cnt"))) {
+      panel_info->left_roi_count = UINT32(atoi(value));
+      panel_info->right_roi_count = UINT32(atoi(value));
+    } else if (!strncmp(key, "is_hdr_enabled", strlen("is_hdr_enabled"))) {
+      panel_info->hdr_enabled = atoi(value);
+    } else if (!strncmp(key, "peak_brightness", strlen("peak_brightness"))) {
+      panel_info->peak_luminance = UINT32(atoi(value));
+    } else if (!strncmp(key, "average_brightness", strlen("average_brightness"))) {
+      panel_info->average_luminance = UINT32(panel_info->peak_luminance +
+                                          panel_info->blackness_level) / 2;
+    } else if (!strncmp(key, "blackness_level", strlen("blackness_level"))) {
+      panel_info->blackness_level = UINT32(atoi(value));
+    } else if (!strncmp(key, "white_chromaticity_x", strlen("white_chromaticity_x"))) {
+      panel_info->primaries.white_point[0] = UINT32(atoi(value));
+    } else if (!strncmp(key, "white_chromaticity_y", strlen("white_chromaticity_y"))) {
+      panel_info->primaries.white_point[1] = UINT32(atoi(value));
+    } else if (!strncmp(key, "red_chromaticity_x", strlen("red_chromaticity_x"))) {
+      panel_info->primaries.red[0] = UINT32(atoi(value));
+    } else if (!strncmp(key, "red_chromaticity_y", strlen("red_chromaticity_y"))) {
+      panel_info->primaries.red[1] = UINT32(atoi(value));
+    } else if (!strncmp(key, "green_chromaticity_x", strlen("green_chromaticity_x"))) {
+      panel_info->primaries.green[0] = UINT32(atoi(value));
+    } else if (!strncmp(key, "green_chromaticity_y", strlen("green_chromaticity_y"))) {
+      panel_info->primaries.green[1] = UINT32(atoi(value));
+    } else if (!strncmp(key, "blue_chromaticity_x", strlen("blue_chromaticity_x"))) {
+      panel_info->primaries.blue[0] = UINT32(atoi(value));
+    } else if (!strncmp(key, "blue_chromaticity_y", strlen("blue_chromaticity_y"))) {
+      panel_info->primaries.blue[1] = UINT32(atoi(value));
+    } else if (!strncmp(key, "panel_orientation", strlen("panel_orientation"))) {
+      int32_t panel_orient = atoi(value);
+      panel_info->panel_orientation.flip_horizontal = ((panel_orient & MDP_FLIP_LR) > 0);
+      panel_info->panel_orientation.flip_vertical = ((panel_orient & MDP_FLIP_UD) > 0);
+      panel_info->panel_orientation.rotation = ((panel_orient & MDP_ROT_90) > 0);
+    } else if (!strncmp(key, "dyn_bitclk_en", strlen("dyn_bitclk_en"))) {
+      panel_info->bitclk_update = atoi(value);
+    } else if (!strncmp(key, "panel_name", strlen("panel_name"))) {
+      snprintf(panel_info->panel_name, sizeof(panel_info->panel_name), "%s", value);
     }
+
+    line = next_line;
   }
 
   GetHWDisplayPortAndMode(device_node, panel_info);
   GetSplitInfo(device_node, panel_info);
-  GetHWPanelNameByNode(device_node, panel_info);
   GetHWPanelMaxBrightnessFromNode(panel_info);
+  sysfs_reader->SetPanelInfo(device_node, *panel_info);
 }
 
 void HWDevice::GetHWDisplayPortAndMode(int device_node, HWPanelInfo *panel_info) {
@@ -970,18 +968,13 @@ void HWDevice::GetHWDisplayPortAndMode(int device_node, HWPanelInfo *panel_info)
   *mode = kModeDefault;
 
   string file_name = fb_path_ + to_string(device_node) + "/msm_fb_type";
-
-  Sys::fstream fs(file_name, fstream::in);
-  if (!fs.is_open()) {
+  char data[kMaxStringLength] = { 0 };
+  if (HWSysfsReader::Get()->Read(file_name, data, sizeof(data)) < 0) {
     DLOGW("File not found %s", file_name.c_str());
     return;
   }
 
-  string line;
-  if (!Sys::getline_(fs, line)) {
-    return;
-  }
-
+  string line(data);
   if ((strncmp(line.c_str(), "mipi dsi cmd panel", strlen("mipi dsi cmd panel")) == 0)) {
     *port = kPortDSI;
     *mode = kModeCommand;
@@ -1011,9 +1004,8 @@ void HWDevice::GetHWDisplayPortAndMode(int device_node, HWPanelInfo *panel_info)
 void HWDevice::GetSplitInfo(int device_node, HWPanelInfo *panel_info) {
   // Split info - for MDSS Version 5 - No need to check version here
   string file_name = fb_path_ + to_string(device_node) + "/msm_fb_split";
-
-  Sys::fstream fs(file_name, fstream::in);
-  if (!fs.is_open()) {
+  char data[kMaxStringLength] = { 0 };
+  if (HWSysfsReader::Get()->Read(file_name, data, sizeof(data)) < 0) {
     DLOGW("File not found %s", file_name.c_str());
     return;
   }
@@ -1022,37 +1014,24 @@ void HWDevice::GetSplitInfo(int device_node, HWPanelInfo *panel_info) {
   uint32_t token_count = 0;
   const uint32_t max_count = 10;
   char *tokens[max_count] = { NULL };
-  string line;
-  if (Sys::getline_(fs, line)) {
-    if (!ParseLine(line.c_str(), tokens, max_count, &token_count)) {
-      panel_info->split_info.left_split = UINT32(atoi(tokens[0]));
-      panel_info->split_info.right_split = UINT32(atoi(tokens[1]));
-    }
+  if (!ParseLine(data, tokens, max_count, &token_count) && token_count >= 2) {
+    panel_info->split_info.left_split = UINT32(atoi(tokens[0]));
+    panel_info->split_info.right_split = UINT32(atoi(tokens[1]));
   }
 }
 
 void HWDevice::GetHWPanelMaxBrightnessFromNode(HWPanelInfo *panel_info) {
   char brightness[kMaxStringLength] = { 0 };
-  char kMaxBrightnessNode[64] = { 0 };
-
-  snprintf(kMaxBrightnessNode, sizeof(kMaxBrightnessNode), "%s",
-           "/sys/class/leds/lcd-backlight/max_brightness");
+  const char *kMaxBrightnessNode = "/sys/class/leds/lcd-backlight/max_brightness";
 
   panel_info->panel_max_brightness = 0;
-  int fd = Sys::open_(kMaxBrightnessNode, O_RDONLY);
-  if (fd < 0) {
-    DLOGW("Failed to open max brightness node = %s, error = %s", kMaxBrightnessNode,
-          strerror(errno));
-    return;
-  }
-
-  if (Sys::pread_(fd, brightness, sizeof(brightness), 0) > 0) {
+  if (HWSysfsReader::Get()->Read(kMaxBrightnessNode, brightness, sizeof(brightness)) > 0) {
     panel_info->panel_max_brightness = atoi(brightness);
     DLOGI("Max brightness level = %d", panel_info->panel_max_brightness);
   } else {
-    DLOGW("Failed to read max brightness level. error = %s", strerror(errno));
+    DLOGW("Failed to read max brightness node = %s, error = %s", kMaxBrightnessNode,
+          strerror(errno));
   }
-  Sys::close_(fd);
 }
 
 int HWDevice::ParseLine(const char *input, char *tokens[], const uint32_t max_token,
@@ -108,6 +108,7 @@ class HWDevice : public HWInterface {
   };
 
   static const int kMaxStringLength = 1024;
+  static const int kMaxSysfsLength = 4096;  // Size of a sysfs attribute page
   static const int kNumPhysicalDisplays = 2;
   // This indicates the number of fb devices created in the driver for all interfaces. Any addition
   // of new fb devices should be added here.
@@ -127,7 +128,6 @@ class HWDevice : public HWInterface {
   void PopulateHWPanelInfo();
   void PopulateBitClkRates();
   void GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info);
-  void GetHWPanelNameByNode(int device_node, HWPanelInfo *panel_info);
   void GetHWDisplayPortAndMode(int device_node, HWPanelInfo *panel_info);
   void GetSplitInfo(int device_node, HWPanelInfo *panel_info);
   void GetHWPanelMaxBrightnessFromNode(HWPanelInfo *panel_info);
@@ -32,12 +32,12 @@
 #include <stdlib.h>
 #include <math.h>
 #include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
-#include <sys/resource.h>
-#include <sys/prctl.h>
 #include <utils/debug.h>
+#include <utils/event_loop.h>
 #include <utils/sys.h>
-#include <pthread.h>
 #include <algorithm>
 #include <vector>
 #include <map>
@@ -49,35 +49,28 @@
 
 namespace sdm {
 
-pollfd HWEvents::InitializePollFd(HWEventData *event_data) {
+int HWEvents::InitializeEventFd(HWEventData *event_data) {
   char node_path[kMaxStringLength] = {0};
   char data[kMaxStringLength] = {0};
-  pollfd poll_fd = {0};
-  poll_fd.fd = -1;
 
+  // The shared event loop is never torn down, so there is no exit node to listen on.
   if (event_data->event_type == HWEvent::EXIT) {
-    // Create an eventfd to be used to unblock the poll system call when
-    // a thread is exiting.
-    poll_fd.fd = Sys::eventfd_(0, 0);
-    poll_fd.events |= POLLIN;
-    exit_fd_ = poll_fd.fd;
-  } else {
-    snprintf(node_path, sizeof(node_path), "%s%d/%s", fb_path_, fb_num_,
-             map_event_to_node_[event_data->event_type]);
-    poll_fd.fd = Sys::open_(node_path, O_RDONLY);
-    poll_fd.events |= POLLPRI | POLLERR;
+    return -1;
   }
 
-  if (poll_fd.fd < 0) {
+  snprintf(node_path, sizeof(node_path), "%s%d/%s", fb_path_, fb_num_,
+           map_event_to_node_[event_data->event_type]);
+  int fd = Sys::open_(node_path, O_RDONLY);
+  if (fd < 0) {
     DLOGW("open failed for display=%d event=%s, error=%s", fb_num_,
           map_event_to_node_[event_data->event_type], strerror(errno));
-    return poll_fd;
+    return fd;
   }
 
-  // Read once on all fds to clear data on all fds.
-  Sys::pread_(poll_fd.fd, data , kMaxStringLength, 0);
+  // Read once to clear any pending data on the node.
+  Sys::pread_(fd, data , kMaxStringLength, 0);
 
-  return poll_fd;
+  return fd;
 }
 
 DisplayError HWEvents::SetEventParser(HWEvent event_type, HWEventData *event_data) {
@@ -114,7 +107,7 @@ void HWEvents::PopulateHWEventData() {
     HWEventData event_data;
     event_data.event_type = event_list_[i];
     SetEventParser(event_list_[i], &event_data);
-    poll_fds_[i] = InitializePollFd(&event_data);
+    event_fds_[i] = InitializeEventFd(&event_data);
     event_data_list_.push_back(event_data);
   }
 }
@@ -127,92 +120,78 @@ DisplayError HWEvents::Init(int fb_num, HWEventHandler *event_handler,
   event_handler_ = event_handler;
   fb_num_ = fb_num;
   event_list_ = event_list;
-  poll_fds_.resize(event_list_.size());
-  event_thread_name_ += " - " + std::to_string(fb_num_);
+  event_fds_.resize(event_list_.size(), -1);
   map_event_to_node_ = {{HWEvent::VSYNC, "vsync_event"}, {HWEvent::EXIT, "thread_exit"},
     {HWEvent::IDLE_NOTIFY, "idle_notify"}, {HWEvent::SHOW_BLANK_EVENT, "show_blank_event"},
     {HWEvent::THERMAL_LEVEL, "msm_fb_thermal_level"}, {HWEvent::IDLE_POWER_COLLAPSE, "idle_power_collapse"}};
 
   PopulateHWEventData();
 
-  if (pthread_create(&event_thread_, NULL, &DisplayEventThread, this) < 0) {
-    DLOGE("Failed to start %s, error = %s", event_thread_name_.c_str());
-    return kErrorResources;
+  for (uint32_t i = 0; i < event_list_.size(); i++) {
+    if (event_fds_[i] < 0) {
+      continue;
+    }
+
+    DisplayError error = EventLoop::Get()->Register(event_fds_[i], EPOLLPRI | EPOLLERR,
+                                                    [this, i](uint32_t events) {
+                                                      HandleEvent(i, events);
+                                                    });
+    if (error != kErrorNone) {
+      DLOGE("Failed to register display=%d event=%s with the event loop", fb_num_,
+            map_event_to_node_[event_list_[i]]);
+      Deinit();
+      return error;
+    }
   }
 
   return kErrorNone;
 }
 
 DisplayError HWEvents::Deinit() {
-  exit_threads_ = true;
-  Sys::pthread_cancel_(event_thread_);
-
-  uint64_t exit_value = 1;
-  ssize_t write_size = Sys::write_(exit_fd_, &exit_value, sizeof(uint64_t));
-  if (write_size != sizeof(uint64_t))
-    DLOGW("Error triggering exit_fd_ (%d). write size = %d, error = %s", exit_fd_, write_size,
-          strerror(errno));
-
-  pthread_join(event_thread_, NULL);
+  for (uint32_t i = 0; i < event_fds_.size(); i++) {
+    if (event_fds_[i] < 0) {
+      continue;
+    }
 
-  for (uint32_t i = 0; i < event_list_.size(); i++) {
-    Sys::close_(poll_fds_[i].fd);
-    poll_fds_[i].fd = -1;
+    EventLoop::Get()->Unregister(event_fds_[i]);
+    Sys::close_(event_fds_[i]);
+    event_fds_[i] = -1;
   }
 
   return kErrorNone;
 }
 
-void* HWEvents::DisplayEventThread(void *context) {
-  if (context) {
-    return reinterpret_cast<HWEvents *>(context)->DisplayEventHandler();
-  }
-
-  return NULL;
-}
-
-void* HWEvents::DisplayEventHandler() {
+void HWEvents::HandleEvent(uint32_t index, uint32_t events) {
   char data[kMaxStringLength] = {0};
 
-  prctl(PR_SET_NAME, event_thread_name_.c_str(), 0, 0, 0);
-  setpriority(PRIO_PROCESS, 0, kThreadPriorityUrgent);
-
-  while (!exit_threads_) {
-    int error = Sys::poll_(poll_fds_.data(), UINT32(event_list_.size()), -1);
+  if ((events & EPOLLPRI) && (Sys::pread_(event_fds_[index], data, kMaxStringLength - 1, 0) > 0)) {
+    (this->*(event_data_list_[index]).event_parser)(data);
+  }
+}
 
-    if (error <= 0) {
-      DLOGW("poll failed. error = %s", strerror(errno));
-      continue;
-    }
+// Parses the decimal value the driver prints after a "key=" prefix, without the locale and base
+// detection overhead of strtoll on the vsync path.
+static int64_t ParseEventValue(const char *data, const char *key, size_t key_length) {
+  if (strncmp(data, key, key_length)) {
+    return 0;
+  }
 
-    for (uint32_t event = 0; event < event_list_.size(); event++) {
-      pollfd &poll_fd = poll_fds_[event];
-
-      if (event_list_.at(event) == HWEvent::EXIT) {
-        if ((poll_fd.revents & POLLIN) && (Sys::read_(poll_fd.fd, data, kMaxStringLength) > 0)) {
-          (this->*(event_data_list_[event]).event_parser)(data);
-        }
-      } else {
-        if ((poll_fd.revents & POLLPRI) &&
-                (Sys::pread_(poll_fd.fd, data, kMaxStringLength, 0) > 0)) {
-          (this->*(event_data_list_[event]).event_parser)(data);
-        }
-      }
-    }
+  const char *digit = data + key_length;
+  bool negative = (*digit == '-');
+  if (negative) {
+    digit++;
   }
 
-  pthread_exit(0);
+  int64_t value = 0;
+  for (; *digit >= '0' && *digit <= '9'; digit++) {
+    value = value * 10 + (*digit - '0');
+  }
 
-  return NULL;
+  return negative ? -value : value;
 }
 
 void HWEvents::HandleVSync(char *data) {
-  int64_t timestamp = 0;
-  if (!strncmp(data, "VSYNC=", strlen("VSYNC="))) {
-    timestamp = strtoll(data + strlen("VSYNC="), NULL, 0);
-  }
-
-  event_handler_->VSync(timestamp);
+  event_handler_->VSync(ParseEventValue(data, "VSYNC=", sizeof("VSYNC=") - 1));
 }
 
 void HWEvents::HandleIdleTimeout(char *data) {
@@ -220,10 +199,7 @@ void HWEvents::HandleIdleTimeout(char *data) {
 }
 
 void HWEvents::HandleThermal(char *data) {
-  int64_t thermal_level = 0;
-  if (!strncmp(data, "thermal_level=", strlen("thermal_level="))) {
-    thermal_level = strtoll(data + strlen("thermal_level="), NULL, 0);
-  }
+  int64_t thermal_level = ParseEventValue(data, "thermal_level=", sizeof("thermal_level=") - 1);
 
   DLOGI("Received thermal notification with thermal level = %d", thermal_level);
 
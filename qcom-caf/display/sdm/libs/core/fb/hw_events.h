@@ -25,7 +25,6 @@
 #ifndef __HW_EVENTS_H__
 #define __HW_EVENTS_H__
 
-#include <sys/poll.h>
 #include <string>
 #include <vector>
 #include <map>
@@ -55,8 +54,7 @@ class HWEvents : public HWEventsInterface {
     EventParser event_parser {};
   };
 
-  static void* DisplayEventThread(void *context);
-  void* DisplayEventHandler();
+  void HandleEvent(uint32_t index, uint32_t events);
   void HandleVSync(char *data);
   void HandleBlank(char *data) { }
   void HandleIdleTimeout(char *data);
@@ -65,19 +63,15 @@ class HWEvents : public HWEventsInterface {
   void HandleIdlePowerCollapse(char *data);
   void PopulateHWEventData();
   DisplayError SetEventParser(HWEvent event_type, HWEventData *event_data);
-  pollfd InitializePollFd(HWEventData *event_data);
+  int InitializeEventFd(HWEventData *event_data);
 
   HWEventHandler *event_handler_ = {};
   vector<HWEvent> event_list_ = {};
   vector<HWEventData> event_data_list_ = {};
-  vector<pollfd> poll_fds_ = {};
+  vector<int> event_fds_ = {};
   map<HWEvent, const char *> map_event_to_node_ = {};
-  pthread_t event_thread_ = {};
-  std::string event_thread_name_ = "SDM_EventThread";
-  bool exit_threads_ = false;
   const char* fb_path_ = "/sys/devices/virtual/graphics/fb";
   int fb_num_ = -1;
-  int exit_fd_ = -1;
 };
 
 }  // namespace sdm
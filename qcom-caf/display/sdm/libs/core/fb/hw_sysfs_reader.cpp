@@ -0,0 +1,153 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <utils/debug.h>
+#include <utils/event_loop.h>
+#include <utils/sys.h>
+
+#include "hw_sysfs_reader.h"
+
+#define __CLASS__ "HWSysfsReader"
+
+namespace sdm {
+
+HWSysfsReader *HWSysfsReader::Get() {
+  // Lives for the life of the process, like the event loop it listens on.
+  static HWSysfsReader *sysfs_reader = new HWSysfsReader();
+  return sysfs_reader;
+}
+
+HWSysfsReader::HWSysfsReader() {
+  ListenUEvents();
+}
+
+void HWSysfsReader::ListenUEvents() {
+#ifndef SDM_VIRTUAL_DRIVER
+  uevent_fd_ = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                      NETLINK_KOBJECT_UEVENT);
+  if (uevent_fd_ < 0) {
+    DLOGW("Failed to open uevent socket, error = %s", strerror(errno));
+    return;
+  }
+
+  struct sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 0xffffffff;
+  if (bind(uevent_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      EventLoop::Get()->Register(uevent_fd_, EPOLLIN, [this](uint32_t events) {
+        HandleUEvent(events);
+      }) != kErrorNone) {
+    DLOGW("Failed to listen to uevents, error = %s", strerror(errno));
+    close(uevent_fd_);
+    uevent_fd_ = -1;
+  }
+#endif
+}
+
+void HWSysfsReader::HandleUEvent(uint32_t events) {
+  char uevent[1024];
+  bool display_event = false;
+
+  // Drain the socket; hotplug, mode and panel changes all arrive as uevents on fb or switch
+  // devices, after which any cached panel info may be stale.
+  ssize_t length = 0;
+  while ((length = recv(uevent_fd_, uevent, sizeof(uevent) - 1, 0)) > 0) {
+    uevent[length] = '\0';
+    if (strstr(uevent, "/graphics/fb") || strstr(uevent, "/switch/")) {
+      display_event = true;
+    }
+  }
+
+  // Any error other than an empty socket, ENOBUFS in particular, means uevents were dropped and
+  // one of them may have been a display event.
+  if (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+    DLOGW("Lost uevents, error = %s", strerror(errno));
+    display_event = true;
+  }
+
+  if (display_event) {
+    InvalidatePanelInfo(-1);
+  }
+}
+
+ssize_t HWSysfsReader::Read(const std::string &path, char *buffer, size_t size) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = node_fds_.find(path);
+  if (it == node_fds_.end() || it->second < 0) {
+    // Nodes that failed to open are retried, as pluggable devices may create them later.
+    int fd = Sys::open_(path.c_str(), O_RDONLY | O_CLOEXEC);
+    it = node_fds_.insert(it, std::make_pair(path, fd));
+    it->second = fd;
+    if (fd < 0) {
+      return -1;
+    }
+  }
+
+  ssize_t length = Sys::pread_(it->second, buffer, size - 1, 0);
+  if (length < 0) {
+    Sys::close_(it->second);
+    it->second = -1;
+    return -1;
+  }
+
+  buffer[length] = '\0';
+  return length;
+}
+
+bool HWSysfsReader::GetPanelInfo(int device_node, HWPanelInfo *panel_info) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = panel_info_.find(device_node);
+  if (it == panel_info_.end()) {
+    return false;
+  }
+
+  *panel_info = it->second;
+  return true;
+}
+
+void HWSysfsReader::SetPanelInfo(int device_node, const HWPanelInfo &panel_info) {
+  std::lock_guard<std::mutex> lock(lock_);
+  // Without a uevent listener nothing would invalidate the cache.
+  if (uevent_fd_ >= 0) {
+    panel_info_[device_node] = panel_info;
+  }
+}
+
+void HWSysfsReader::InvalidatePanelInfo(int device_node) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (device_node < 0) {
+    panel_info_.clear();
+  } else {
+    panel_info_.erase(device_node);
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,61 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_SYSFS_READER_H__
+#define __HW_SYSFS_READER_H__
+
+#include <private/hw_info_types.h>
+#include <sys/types.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace sdm {
+
+// Process wide reader for the fb sysfs nodes queried on display init, hotplug and mode changes.
+// Nodes are opened once and re-read with pread, which makes sysfs regenerate their contents.
+// Panel info parsed from the nodes of each fb device is cached until a display uevent arrives.
+class HWSysfsReader {
+ public:
+  static HWSysfsReader *Get();
+  // Reads the node into buffer and NUL terminates it. Returns the length read or -1.
+  ssize_t Read(const std::string &path, char *buffer, size_t size);
+  bool GetPanelInfo(int device_node, HWPanelInfo *panel_info);
+  void SetPanelInfo(int device_node, const HWPanelInfo &panel_info);
+  void InvalidatePanelInfo(int device_node);
+
+ private:
+  HWSysfsReader();
+  void ListenUEvents();
+  void HandleUEvent(uint32_t events);
+
+  std::mutex lock_;
+  std::map<std::string, int> node_fds_;  // -1 for nodes that failed to open
+  std::map<int, HWPanelInfo> panel_info_;
+  int uevent_fd_ = -1;
+};
+
+}  // namespace sdm
+
+#endif  // __HW_SYSFS_READER_H__
@@ -79,6 +79,11 @@ DisplayError ResourceDefault::Init() {
     return kErrorParameters;
   }
 
+  if (num_pipe_ > kMaxPipes) {
+    DLOGE("Number of H/W pipes %d exceeds %d", num_pipe_, kMaxPipes);
+    return kErrorParameters;
+  }
+
   src_pipes_.resize(num_pipe_);
 
   // Priority order of pipes: VIG, RGB, DMA
@@ -108,6 +113,7 @@ DisplayError ResourceDefault::Init() {
 
   for (uint32_t i = 0; i < num_pipe_; i++) {
     src_pipes_[i].priority = INT(i);
+    type_mask_[src_pipes_[i].type] |= (UINT64(1) << i);
   }
 
   DLOGI("hw_rev=%x, DMA=%d RGB=%d VIG=%d", hw_res_info_.hw_revision, hw_res_info_.num_dma_pipe,
@@ -127,6 +133,12 @@ DisplayError ResourceDefault::Init() {
   src_pipes_[rgb_index + 1].owner = kPipeOwnerKernelMode;
 #endif
 
+  for (uint32_t i = 0; i < num_pipe_; i++) {
+    if (src_pipes_[i].owner == kPipeOwnerUserMode) {
+      free_mask_ |= (UINT64(1) << i);
+    }
+  }
+
   return error;
 }
 
@@ -246,11 +258,7 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
     return error;
   }
 
-  for (uint32_t i = 0; i < num_pipe_; i++) {
-    if (src_pipes_[i].hw_block_id == hw_block_id && src_pipes_[i].owner == kPipeOwnerUserMode) {
-      src_pipes_[i].ResetState();
-    }
-  }
+  ReleasePipes(hw_block_id);
 
   uint32_t left_index = num_pipe_;
   uint32_t right_index = num_pipe_;
@@ -264,7 +272,7 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
   // left pipe is needed
   if (left_pipe->valid) {
     need_scale = IsScalingNeeded(left_pipe);
-    left_index = GetPipe(hw_block_id, need_scale);
+    left_index = GetPipe(display_resource_ctx, kPipeLeft, need_scale);
     if (left_index >= num_pipe_) {
       DLOGV_IF(kTagResources, "Get left pipe failed: hw_block_id = %d, need_scale = %d",
                hw_block_id, need_scale);
@@ -289,7 +297,7 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
 
   need_scale = IsScalingNeeded(right_pipe);
 
-  right_index = GetPipe(hw_block_id, need_scale);
+  right_index = GetPipe(display_resource_ctx, kPipeRight, need_scale);
   if (right_index >= num_pipe_) {
     DLOGV_IF(kTagResources, "Get right pipe failed: hw_block_id = %d, need_scale = %d", hw_block_id,
              need_scale);
@@ -345,10 +353,11 @@ DisplayError ResourceDefault::PostCommit(Handle display_ctx, HWLayers *hw_layers
 
   // handoff pipes which are used by splash screen
   if ((frame_count == 0) && (hw_block_id == kHWPrimary)) {
-    for (uint32_t i = 0; i < num_pipe_; i++) {
-      if (src_pipes_[i].hw_block_id == hw_block_id && src_pipes_[i].owner == kPipeOwnerKernelMode) {
-        src_pipes_[i].owner = kPipeOwnerUserMode;
-      }
+    uint64_t pipes = block_mask_[hw_block_id];
+    while (pipes) {
+      uint32_t i = UINT32(__builtin_ctzll(pipes));
+      pipes &= pipes - 1;
+      src_pipes_[i].owner = kPipeOwnerUserMode;
     }
   }
 
@@ -365,13 +374,7 @@ void ResourceDefault::Purge(Handle display_ctx) {
 
   DisplayResourceContext *display_resource_ctx =
                           reinterpret_cast<DisplayResourceContext *>(display_ctx);
-  HWBlockType hw_block_id = display_resource_ctx->hw_block_id;
-
-  for (uint32_t i = 0; i < num_pipe_; i++) {
-    if (src_pipes_[i].hw_block_id == hw_block_id && src_pipes_[i].owner == kPipeOwnerUserMode) {
-      src_pipes_[i].ResetState();
-    }
-  }
+  ReleasePipes(display_resource_ctx->hw_block_id);
   DLOGV_IF(kTagResources, "display id = %d", display_resource_ctx->hw_block_id);
 }
 
@@ -381,50 +384,54 @@ DisplayError ResourceDefault::SetMaxMixerStages(Handle display_ctx, uint32_t max
   return kErrorNone;
 }
 
-uint32_t ResourceDefault::SearchPipe(HWBlockType hw_block_id, SourcePipe *src_pipes,
-                                uint32_t num_pipe) {
-  uint32_t index = num_pipe_;
-  SourcePipe *src_pipe;
-
-  // search the pipe being used
-  for (uint32_t i = 0; i < num_pipe; i++) {
-    src_pipe = &src_pipes[i];
-    if (src_pipe->owner == kPipeOwnerUserMode && src_pipe->hw_block_id == kHWBlockMax) {
-      index = src_pipe->index;
-      src_pipe->hw_block_id = hw_block_id;
-      break;
-    }
-  }
+uint32_t ResourceDefault::AcquirePipe(uint32_t position, HWBlockType hw_block_id) {
+  uint64_t pipe = UINT64(1) << position;
+  free_mask_ &= ~pipe;
+  block_mask_[hw_block_id] |= pipe;
+  src_pipes_[position].hw_block_id = hw_block_id;
 
-  return index;
+  return position;
+}
+
+void ResourceDefault::ReleasePipes(HWBlockType hw_block_id) {
+  // Only user mode pipes are ever assigned to a block, so all of them go back to the free set.
+  uint64_t pipes = block_mask_[hw_block_id];
+  free_mask_ |= pipes;
+  block_mask_[hw_block_id] = 0;
+  while (pipes) {
+    uint32_t i = UINT32(__builtin_ctzll(pipes));
+    pipes &= pipes - 1;
+    src_pipes_[i].ResetState();
+  }
 }
 
 uint32_t ResourceDefault::NextPipe(PipeType type, HWBlockType hw_block_id) {
-  uint32_t num_pipe = 0;
-  SourcePipe *src_pipes = NULL;
+  if (type != kPipeTypeVIG && type != kPipeTypeRGB) {
+    type = kPipeTypeDMA;
+  }
 
-  switch (type) {
-  case kPipeTypeVIG:
-    src_pipes = &src_pipes_[0];
-    num_pipe = hw_res_info_.num_vig_pipe;
-    break;
-  case kPipeTypeRGB:
-    src_pipes = &src_pipes_[hw_res_info_.num_vig_pipe];
-    num_pipe = hw_res_info_.num_rgb_pipe;
-    break;
-  case kPipeTypeDMA:
-  default:
-    src_pipes = &src_pipes_[hw_res_info_.num_vig_pipe + hw_res_info_.num_rgb_pipe];
-    num_pipe = hw_res_info_.num_dma_pipe;
-    break;
+  // Pipes of a type are laid out in priority order, so the lowest free bit is the first free pipe.
+  uint64_t available = free_mask_ & type_mask_[type];
+  if (!available) {
+    return num_pipe_;
   }
 
-  return SearchPipe(hw_block_id, src_pipes, num_pipe);
+  return AcquirePipe(UINT32(__builtin_ctzll(available)), hw_block_id);
 }
 
-uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_id, bool need_scale) {
+uint32_t ResourceDefault::GetPipe(DisplayResourceContext *display_resource_ctx, PipeSide side,
+                                  bool need_scale) {
+  HWBlockType hw_block_id = display_resource_ctx->hw_block_id;
+  PipeCache &cache = display_resource_ctx->pipe_cache[side];
   uint32_t index = num_pipe_;
 
+  // Keep the previous frame's pipe when the layer has the same scaling needs, so that an unchanged
+  // layer is not moved to another pipe.
+  if (cache.position < num_pipe_ && cache.need_scale == need_scale &&
+      (free_mask_ & (UINT64(1) << cache.position))) {
+    return AcquirePipe(cache.position, hw_block_id);
+  }
+
   // The default behavior is to assume RGB and VG pipes have scalars
   if (!need_scale) {
     index = NextPipe(kPipeTypeDMA, hw_block_id);
@@ -438,6 +445,11 @@ uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_id, bool need_scale) {
     index = NextPipe(kPipeTypeVIG, hw_block_id);
   }
 
+  if (index < num_pipe_) {
+    cache.position = index;
+    cache.need_scale = need_scale;
+  }
+
   return index;
 }
 
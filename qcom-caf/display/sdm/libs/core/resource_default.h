@@ -78,6 +78,9 @@ class ResourceDefault : public ResourceInterface {
     kMaxDecimationDownScaleRatio = 16,
   };
 
+  // Pipe availability is tracked in 64 bit masks indexed by position in src_pipes_.
+  static const uint32_t kMaxPipes = 64;
+
   struct SourcePipe {
     PipeType type;
     PipeOwner owner;
@@ -92,11 +95,27 @@ class ResourceDefault : public ResourceInterface {
     inline void ResetState() { hw_block_id = kHWBlockMax;}
   };
 
+  enum PipeSide {
+    kPipeLeft,
+    kPipeRight,
+    kPipeSideMax,
+  };
+
+  // Pipe picked for each side of the FB layer in the previous frame, and whether it was picked
+  // for a scaled layer. An unchanged layer takes its previous pipe back when it is still free.
+  struct PipeCache {
+    uint32_t position;
+    bool need_scale;
+
+    PipeCache() : position(kMaxPipes), need_scale(false) { }
+  };
+
   struct DisplayResourceContext {
     HWDisplayAttributes display_attributes;
     HWBlockType hw_block_id;
     uint64_t frame_count;
     HWMixerAttributes mixer_attributes;
+    PipeCache pipe_cache[kPipeSideMax];
 
     DisplayResourceContext() : hw_block_id(kHWBlockMax), frame_count(0) { }
   };
@@ -110,8 +129,9 @@ class ResourceDefault : public ResourceInterface {
   DisplayError Init();
   DisplayError Deinit();
   uint32_t NextPipe(PipeType pipe_type, HWBlockType hw_block_id);
-  uint32_t SearchPipe(HWBlockType hw_block_id, SourcePipe *src_pipes, uint32_t num_pipe);
-  uint32_t GetPipe(HWBlockType hw_block_id, bool need_scale);
+  uint32_t AcquirePipe(uint32_t position, HWBlockType hw_block_id);
+  void ReleasePipes(HWBlockType hw_block_id);
+  uint32_t GetPipe(DisplayResourceContext *display_resource_ctx, PipeSide side, bool need_scale);
   bool IsScalingNeeded(const HWPipeInfo *pipe_info);
   DisplayError Config(DisplayResourceContext *display_resource_ctx, HWLayers *hw_layers);
   DisplayError DisplaySplitConfig(DisplayResourceContext *display_resource_ctx,
@@ -142,6 +162,9 @@ class ResourceDefault : public ResourceInterface {
   HWBlockContext hw_block_ctx_[kHWBlockMax];
   std::vector<SourcePipe> src_pipes_;
   uint32_t num_pipe_ = 0;
+  uint64_t type_mask_[kPipeTypeCursor + 1] = {};  // Pipes of each type
+  uint64_t free_mask_ = 0;                        // User mode pipes not assigned to a block
+  uint64_t block_mask_[kHWBlockMax] = {};         // Pipes assigned to each block
 };
 
 }  // namespace sdm
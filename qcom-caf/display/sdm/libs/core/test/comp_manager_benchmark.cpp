@@ -0,0 +1,564 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless composition benchmark. Drives CompManager through the per frame sequence DisplayBase
+// uses (PrePrepare, Prepare, PostPrepare, Commit, PostCommit) with synthetic layer stacks on an
+// msm8996 like MDP resource description, without a display, a driver or gralloc.
+//
+// Each stack is run twice:
+//   default   - no extension, so Strategy falls back to GPU and ResourceDefault reserves pipes
+//               for the framebuffer target. This is the path taken without libsdmextension.
+//   synthetic - BenchExtension below. Its strategy tries full MDP composition first and then
+//               moves one more bottom layer into the GPU target per attempt, its resource manager
+//               rejects a strategy when the layers need more pipes or blend stages than the
+//               hardware has, and hands the GPU target back to ResourceDefault.
+// The synthetic strategy is a stand-in for the closed source one, it gives CompManager a multi
+// attempt loop to exercise; absolute numbers measure CompManager and ResourceDefault only.
+//
+// Usage: sdm_comp_manager_benchmark [frames]
+// Exits with a non zero status if any frame fails to prepare or commit.
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utils/constants.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "../comp_manager.h"
+#include "../resource_default.h"
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace sdm {
+
+namespace {
+
+const uint32_t kPanelWidth = 1080;
+const uint32_t kPanelHeight = 1920;
+const uint32_t kDefaultFrames = 5000;
+const uint32_t kWarmupFrames = 100;
+
+bool IsScaled(const Layer &layer) {
+  const LayerRect &src = layer.src_rect;
+  const LayerRect &dst = layer.dst_rect;
+  return ((src.right - src.left) != (dst.right - dst.left)) ||
+         ((src.bottom - src.top) != (dst.bottom - dst.top));
+}
+
+// Stand-in for the extension strategy: attempt n puts the bottom n app layers on GPU.
+class BenchStrategy : public StrategyInterface {
+ public:
+  virtual DisplayError Start(HWLayersInfo *hw_layers_info, uint32_t *max_attempts) {
+    hw_layers_info_ = hw_layers_info;
+    gpu_layers_ = 0;
+    *max_attempts = hw_layers_info->app_layer_count + 1;
+    return kErrorNone;
+  }
+
+  virtual DisplayError GetNextStrategy(StrategyConstraints *constraints) {
+    uint32_t app_layer_count = hw_layers_info_->app_layer_count;
+    if (constraints->safe_mode) {
+      gpu_layers_ = app_layer_count;
+    }
+
+    // Skip splits which program more layers than the constraints allow.
+    while (gpu_layers_ <= app_layer_count) {
+      uint32_t sde_layers = app_layer_count - gpu_layers_ + (gpu_layers_ ? 1 : 0);
+      if (sde_layers <= constraints->max_layers && sde_layers <= UINT32(kMaxSDELayers)) {
+        break;
+      }
+      gpu_layers_++;
+    }
+
+    if (gpu_layers_ > app_layer_count) {
+      return kErrorNotSupported;
+    }
+
+    LayerStack *layer_stack = hw_layers_info_->stack;
+    uint32_t count = 0;
+    hw_layers_info_->hw_layers.clear();
+    if (gpu_layers_) {
+      hw_layers_info_->index[count++] = hw_layers_info_->gpu_target_index;
+      hw_layers_info_->hw_layers.push_back(
+          *layer_stack->layers.at(hw_layers_info_->gpu_target_index));
+    }
+    for (uint32_t i = 0; i < app_layer_count; i++) {
+      Layer *layer = layer_stack->layers.at(i);
+      layer->request.flags.request_flags = 0;
+      if (i < gpu_layers_) {
+        layer->composition = kCompositionGPU;
+        continue;
+      }
+      layer->composition = kCompositionSDE;
+      hw_layers_info_->index[count++] = i;
+      hw_layers_info_->hw_layers.push_back(*layer);
+    }
+    gpu_layers_++;
+
+    return kErrorNone;
+  }
+
+  virtual DisplayError Stop() { return kErrorNone; }
+  virtual DisplayError Reconfigure(const HWPanelInfo &hw_panel_info,
+                                   const HWResourceInfo &hw_res_info,
+                                   const HWMixerAttributes &mixer_attributes,
+                                   const DisplayConfigVariableInfo &fb_config) {
+    return kErrorNone;
+  }
+  virtual DisplayError SetCompositionState(LayerComposition composition_type, bool enable) {
+    return kErrorNone;
+  }
+  virtual DisplayError Purge() { return kErrorNone; }
+  virtual DisplayError SetIdleTimeoutMs(uint32_t active_ms) { return kErrorNone; }
+
+ private:
+  HWLayersInfo *hw_layers_info_ = NULL;
+  uint32_t gpu_layers_ = 0;
+};
+
+// Budgets pipes and blend stages for multi layer strategies, the framebuffer target alone is
+// reserved by ResourceDefault.
+class BenchResource : public ResourceInterface {
+ public:
+  explicit BenchResource(const HWResourceInfo &hw_res_info) : hw_res_info_(hw_res_info) { }
+
+  DisplayError Init() {
+    return ResourceDefault::CreateResourceDefault(hw_res_info_, &default_);
+  }
+
+  void Deinit() {
+    ResourceDefault::DestroyResourceDefault(default_);
+  }
+
+  virtual DisplayError RegisterDisplay(DisplayType type,
+                                       const HWDisplayAttributes &display_attributes,
+                                       const HWPanelInfo &hw_panel_info,
+                                       const HWMixerAttributes &mixer_attributes,
+                                       Handle *display_ctx) {
+    return default_->RegisterDisplay(type, display_attributes, hw_panel_info, mixer_attributes,
+                                     display_ctx);
+  }
+  virtual DisplayError UnregisterDisplay(Handle display_ctx) {
+    return default_->UnregisterDisplay(display_ctx);
+  }
+  virtual DisplayError ReconfigureDisplay(Handle display_ctx,
+                                          const HWDisplayAttributes &display_attributes,
+                                          const HWPanelInfo &hw_panel_info,
+                                          const HWMixerAttributes &mixer_attributes) {
+    return default_->ReconfigureDisplay(display_ctx, display_attributes, hw_panel_info,
+                                        mixer_attributes);
+  }
+  virtual DisplayError Start(Handle display_ctx) { return default_->Start(display_ctx); }
+  virtual DisplayError Stop(Handle display_ctx, HWLayers *hw_layers) {
+    return default_->Stop(display_ctx, hw_layers);
+  }
+
+  virtual DisplayError Prepare(Handle display_ctx, HWLayers *hw_layers) {
+    const std::vector<Layer> &layers = hw_layers->info.hw_layers;
+    if (layers.size() == 1 && layers.at(0).composition == kCompositionGPUTarget) {
+      return default_->Prepare(display_ctx, hw_layers);
+    }
+
+    // Stage 0 is the border color.
+    if (layers.size() >= hw_res_info_.num_blending_stages) {
+      return kErrorResources;
+    }
+
+    uint32_t free_vig = hw_res_info_.num_vig_pipe;
+    uint32_t free_other = hw_res_info_.num_rgb_pipe + hw_res_info_.num_dma_pipe;
+    for (const Layer &layer : layers) {
+      uint32_t width = UINT32(layer.src_rect.right - layer.src_rect.left);
+      uint32_t pipes = (width > hw_res_info_.max_pipe_width) ? 2 : 1;
+      bool needs_vig = IsScaled(layer) || (layer.input_buffer.format >= kFormatYCbCr420Planar);
+      if (!needs_vig && free_other >= pipes) {
+        free_other -= pipes;
+      } else if (free_vig >= pipes) {
+        free_vig -= pipes;
+      } else {
+        return kErrorResources;
+      }
+    }
+
+    return kErrorNone;
+  }
+
+  virtual DisplayError PostPrepare(Handle display_ctx, HWLayers *hw_layers) {
+    return default_->PostPrepare(display_ctx, hw_layers);
+  }
+  virtual DisplayError Commit(Handle display_ctx, HWLayers *hw_layers) {
+    return default_->Commit(display_ctx, hw_layers);
+  }
+  virtual DisplayError PostCommit(Handle display_ctx, HWLayers *hw_layers) {
+    return default_->PostCommit(display_ctx, hw_layers);
+  }
+  virtual void Purge(Handle display_ctx) { default_->Purge(display_ctx); }
+  virtual DisplayError SetMaxMixerStages(Handle display_ctx, uint32_t max_mixer_stages) {
+    return default_->SetMaxMixerStages(display_ctx, max_mixer_stages);
+  }
+  virtual DisplayError ValidateScaling(const LayerRect &crop, const LayerRect &dst, bool rotate90,
+                                       BufferLayout layout, bool use_rotator_downscale) {
+    return default_->ValidateScaling(crop, dst, rotate90, layout, use_rotator_downscale);
+  }
+  virtual DisplayError ValidateCursorConfig(Handle display_ctx, const Layer *layer, bool is_top) {
+    return default_->ValidateCursorConfig(display_ctx, layer, is_top);
+  }
+  virtual DisplayError ValidateAndSetCursorPosition(Handle display_ctx, HWLayers *hw_layers,
+                                                    int x, int y,
+                                                    DisplayConfigVariableInfo *fb_config) {
+    return default_->ValidateAndSetCursorPosition(display_ctx, hw_layers, x, y, fb_config);
+  }
+  virtual DisplayError SetMaxBandwidthMode(HWBwModes mode) {
+    return default_->SetMaxBandwidthMode(mode);
+  }
+  virtual DisplayError GetScaleLutConfig(HWScaleLutInfo *lut_info) {
+    return default_->GetScaleLutConfig(lut_info);
+  }
+  virtual DisplayError SetDetailEnhancerData(Handle display_ctx,
+                                             const DisplayDetailEnhancerData &de_data) {
+    return default_->SetDetailEnhancerData(display_ctx, de_data);
+  }
+  virtual DisplayError Perform(int cmd, ...) { return kErrorNone; }
+
+ private:
+  HWResourceInfo hw_res_info_;
+  ResourceInterface *default_ = NULL;
+};
+
+class BenchExtension : public ExtensionInterface {
+ public:
+  virtual ~BenchExtension() { }
+
+  virtual DisplayError CreatePartialUpdate(DisplayType type, const HWResourceInfo &hw_resource_info,
+                                           const HWPanelInfo &hw_panel_info,
+                                           const HWMixerAttributes &mixer_attributes,
+                                           const HWDisplayAttributes &display_attributes,
+                                           const DisplayConfigVariableInfo &fb_config,
+                                           PartialUpdateInterface **partial_update_intf) {
+    return kErrorNotSupported;
+  }
+  virtual DisplayError DestroyPartialUpdate(PartialUpdateInterface *partial_update_intf) {
+    return kErrorNone;
+  }
+
+  virtual DisplayError CreateStrategyExtn(DisplayType type, BufferAllocator *buffer_allocator,
+                                          const HWResourceInfo &hw_resource_info,
+                                          const HWPanelInfo &hw_panel_info,
+                                          const HWMixerAttributes &mixer_attributes,
+                                          const DisplayConfigVariableInfo &fb_config,
+                                          StrategyInterface **interface) {
+    *interface = new BenchStrategy();
+    return kErrorNone;
+  }
+  virtual DisplayError DestroyStrategyExtn(StrategyInterface *interface) {
+    delete interface;
+    return kErrorNone;
+  }
+
+  virtual DisplayError CreateResourceExtn(const HWResourceInfo &hw_resource_info,
+                                          BufferAllocator *buffer_allocator,
+                                          BufferSyncHandler *buffer_sync_handler,
+                                          ResourceInterface **interface) {
+    BenchResource *resource = new BenchResource(hw_resource_info);
+    DisplayError error = resource->Init();
+    if (error != kErrorNone) {
+      delete resource;
+      return error;
+    }
+    *interface = resource;
+    return kErrorNone;
+  }
+  virtual DisplayError DestroyResourceExtn(ResourceInterface *interface) {
+    BenchResource *resource = static_cast<BenchResource *>(interface);
+    resource->Deinit();
+    delete resource;
+    return kErrorNone;
+  }
+
+  virtual DisplayError CreateDppsControlExtn(DppsControlInterface **dpps_control_interface,
+                                             SocketHandler *socket_handler) {
+    return kErrorNotSupported;
+  }
+  virtual DisplayError DestroyDppsControlExtn(DppsControlInterface *interface) {
+    return kErrorNone;
+  }
+};
+
+// MDP 1.7 as found on msm8996: 4 VIG, 4 RGB, 2 DMA and 2 cursor pipes, 10 blend stages.
+HWResourceInfo Msm8996ResourceInfo() {
+  HWResourceInfo info;
+  info.hw_revision = 0x10070000;
+  info.num_vig_pipe = 4;
+  info.num_rgb_pipe = 4;
+  info.num_dma_pipe = 2;
+  info.num_cursor_pipe = 2;
+  info.num_blending_stages = 10;
+  info.num_control = 5;
+  info.num_mixer_to_disp = 2;
+  info.max_scale_up = 20;
+  info.max_scale_down = 4;
+  info.max_mixer_width = 2560;
+  info.max_pipe_width = 2560;
+  info.max_cursor_size = 128;
+  info.has_ubwc = true;
+  info.has_decimation = true;
+  info.is_src_split = true;
+
+  struct { PipeType type; uint32_t count; uint32_t first_id; } pipes[] = {
+    { kPipeTypeVIG, info.num_vig_pipe, 0x1 },
+    { kPipeTypeRGB, info.num_rgb_pipe, 0x10 },
+    { kPipeTypeDMA, info.num_dma_pipe, 0x100 },
+  };
+  for (const auto &group : pipes) {
+    for (uint32_t i = 0; i < group.count; i++) {
+      HWPipeCaps caps;
+      caps.type = group.type;
+      caps.id = group.first_id << i;
+      info.hw_pipes.push_back(caps);
+    }
+  }
+
+  return info;
+}
+
+struct Scenario {
+  const char *name;
+  uint32_t app_layers;
+  bool video;  // Bottom layer is a scaled NV12 video layer
+};
+
+// Owns a synthetic stack of app layers plus the GPU target, laid out as DisplayBase would.
+class SyntheticStack {
+ public:
+  explicit SyntheticStack(const Scenario &scenario) : layers_(scenario.app_layers + 1) {
+    float width = FLOAT(kPanelWidth);
+    float height = FLOAT(kPanelHeight);
+    for (uint32_t i = 0; i < scenario.app_layers; i++) {
+      Layer &layer = layers_.at(i);
+      // Alternate full screen layers with status/navigation bar sized strips.
+      float top = (i % 2) ? 0.0f : FLOAT(i * 48 % kPanelHeight);
+      float bottom = (i % 2) ? height : std::min(height, top + 96.0f);
+      layer.src_rect = LayerRect(0.0f, 0.0f, width, bottom - top);
+      layer.dst_rect = LayerRect(0.0f, top, width, bottom);
+      layer.input_buffer.width = kPanelWidth;
+      layer.input_buffer.height = UINT32(bottom - top);
+      layer.input_buffer.unaligned_width = layer.input_buffer.width;
+      layer.input_buffer.unaligned_height = layer.input_buffer.height;
+      layer.input_buffer.format = kFormatRGBA8888;
+      layer.composition = kCompositionGPU;
+    }
+
+    if (scenario.video && scenario.app_layers) {
+      Layer &video = layers_.at(0);
+      video.src_rect = LayerRect(0.0f, 0.0f, 1280.0f, 720.0f);
+      video.dst_rect = LayerRect(0.0f, 656.0f, width, 1264.0f);
+      video.input_buffer.width = 1280;
+      video.input_buffer.height = 720;
+      video.input_buffer.unaligned_width = 1280;
+      video.input_buffer.unaligned_height = 720;
+      video.input_buffer.format = kFormatYCbCr420SemiPlanarVenus;
+      video.blending = kBlendingOpaque;
+    }
+
+    Layer &target = layers_.back();
+    target.src_rect = LayerRect(0.0f, 0.0f, width, height);
+    target.dst_rect = target.src_rect;
+    target.input_buffer.width = kPanelWidth;
+    target.input_buffer.height = kPanelHeight;
+    target.input_buffer.unaligned_width = kPanelWidth;
+    target.input_buffer.unaligned_height = kPanelHeight;
+    target.input_buffer.format = kFormatRGBA8888;
+    target.composition = kCompositionGPUTarget;
+
+    for (Layer &layer : layers_) {
+      stack_.layers.push_back(&layer);
+    }
+    app_layer_count_ = scenario.app_layers;
+  }
+
+  // Resets the per frame state DisplayBase::BuildLayerStackStats and Prepare would set up.
+  void Reset(HWLayers *hw_layers) {
+    *hw_layers = HWLayers();
+    hw_layers->info.stack = &stack_;
+    hw_layers->info.app_layer_count = app_layer_count_;
+    hw_layers->info.gpu_target_index = app_layer_count_;
+  }
+
+ private:
+  std::vector<Layer> layers_;
+  LayerStack stack_;
+  uint32_t app_layer_count_ = 0;
+};
+
+struct Result {
+  uint32_t failures = 0;
+  uint64_t prepare_ns = 0;
+  uint64_t commit_ns = 0;
+  CompositionStats stats = {};
+};
+
+uint64_t ElapsedNs(steady_clock::time_point start) {
+  return UINT64(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+}
+
+Result Run(ExtensionInterface *extension, const Scenario &scenario, uint32_t frames) {
+  Result result;
+  HWResourceInfo hw_res_info = Msm8996ResourceInfo();
+  CompManager comp_manager;
+  if (comp_manager.Init(hw_res_info, extension, NULL, NULL, NULL) != kErrorNone) {
+    result.failures++;
+    return result;
+  }
+
+  HWDisplayAttributes display_attributes;
+  display_attributes.x_pixels = kPanelWidth;
+  display_attributes.y_pixels = kPanelHeight;
+  display_attributes.fps = 60;
+  display_attributes.vsync_period_ns = 16666667;
+  HWPanelInfo panel_info;
+  panel_info.is_primary_panel = true;
+  panel_info.split_info.left_split = kPanelWidth;
+  HWMixerAttributes mixer_attributes;
+  mixer_attributes.width = kPanelWidth;
+  mixer_attributes.height = kPanelHeight;
+  mixer_attributes.split_left = kPanelWidth;
+  DisplayConfigVariableInfo fb_config = display_attributes;
+
+  Handle display_ctx = NULL;
+  if (comp_manager.RegisterDisplay(kPrimary, display_attributes, panel_info, mixer_attributes,
+                                   fb_config, &display_ctx) != kErrorNone) {
+    result.failures++;
+    comp_manager.Deinit();
+    return result;
+  }
+
+  SyntheticStack stack(scenario);
+  HWLayers hw_layers;
+  CompositionStats warmup = {};
+  for (uint32_t frame = 0; frame < kWarmupFrames + frames; frame++) {
+    if (frame == kWarmupFrames) {
+      comp_manager.GetCompositionStats(display_ctx, &warmup);
+      result.prepare_ns = 0;
+      result.commit_ns = 0;
+    }
+
+    stack.Reset(&hw_layers);
+
+    steady_clock::time_point start = steady_clock::now();
+    comp_manager.PrePrepare(display_ctx, &hw_layers);
+    DisplayError error = comp_manager.Prepare(display_ctx, &hw_layers);
+    if (error == kErrorNone) {
+      error = comp_manager.PostPrepare(display_ctx, &hw_layers);
+    }
+    result.prepare_ns += ElapsedNs(start);
+    if (error != kErrorNone) {
+      result.failures++;
+      continue;
+    }
+
+    start = steady_clock::now();
+    error = comp_manager.Commit(display_ctx, &hw_layers);
+    if (error == kErrorNone) {
+      error = comp_manager.PostCommit(display_ctx, &hw_layers);
+    }
+    result.commit_ns += ElapsedNs(start);
+    if (error != kErrorNone) {
+      result.failures++;
+    }
+  }
+
+  // Report only the measured frames.
+  comp_manager.GetCompositionStats(display_ctx, &result.stats);
+  result.stats.frames -= warmup.frames;
+  result.stats.strategy_attempts -= warmup.strategy_attempts;
+  result.stats.gpu_fallback_frames -= warmup.gpu_fallback_frames;
+  result.stats.replayed_frames -= warmup.replayed_frames;
+
+  comp_manager.UnregisterDisplay(display_ctx);
+  comp_manager.Deinit();
+
+  return result;
+}
+
+}  // namespace
+
+}  // namespace sdm
+
+int main(int argc, char **argv) {
+  using sdm::BenchExtension;
+  using sdm::Result;
+  using sdm::Scenario;
+
+  uint32_t frames = sdm::kDefaultFrames;
+  if (argc > 1) {
+    frames = static_cast<uint32_t>(strtoul(argv[1], NULL, 10));
+  }
+  if (!frames) {
+    fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+    return 2;
+  }
+
+  const Scenario scenarios[] = {
+    { "home", 4, false },
+    { "video", 6, true },
+    { "busy", 10, false },
+    { "video_busy", 12, true },
+    { "stress", 16, false },
+  };
+
+  BenchExtension extension;
+  struct { const char *name; sdm::ExtensionInterface *extension; } modes[] = {
+    { "default", NULL },
+    { "synthetic", &extension },
+  };
+
+  uint32_t failures = 0;
+  printf("%-10s %-10s %6s %8s %12s %11s %9s %8s\n", "mode", "stack", "layers", "frames",
+         "prepare(us)", "commit(us)", "attempts", "gpu(%)");
+  for (const auto &mode : modes) {
+    for (const Scenario &scenario : scenarios) {
+      Result result = sdm::Run(mode.extension, scenario, frames);
+      const sdm::CompositionStats &stats = result.stats;
+      double measured = stats.frames ? static_cast<double>(stats.frames) : 1.0;
+      printf("%-10s %-10s %6u %8" PRIu64 " %12.2f %11.2f %9.2f %8.1f\n", mode.name, scenario.name,
+             scenario.app_layers, stats.frames,
+             static_cast<double>(result.prepare_ns) / 1000.0 / frames,
+             static_cast<double>(result.commit_ns) / 1000.0 / frames,
+             static_cast<double>(stats.strategy_attempts) / measured,
+             100.0 * static_cast<double>(stats.gpu_fallback_frames) / measured);
+      if (result.failures) {
+        printf("FAIL %s/%s: %u frames failed to prepare or commit\n", mode.name, scenario.name,
+               result.failures);
+      }
+      failures += result.failures;
+    }
+  }
+
+  return failures ? 1 : 0;
+}
@@ -37,7 +37,7 @@ LOCAL_SHARED_LIBRARIES        := libsdmcore libqservice libbinder libhardware li
                                  libutils libcutils libsync libqdutils libqdMetaData libdl libdrmutils \
                                  libsdmutils libc++ liblog libgrallocutils libdl \
                                  vendor.display.config@2.0 libhidlbase \
-                                 libdisplayconfig.qti libui libgpu_tonemapper
+                                 libdisplayconfig.qti libui libgpu_tonemapper liblz4
 
 ifneq ($(TARGET_USES_GRALLOC1), true)
     LOCAL_SHARED_LIBRARIES += libmemalloc
@@ -59,6 +59,10 @@ LOCAL_SRC_FILES               := hwc_session.cpp \
                                  ../hwc/hwc_socket_handler.cpp \
                                  display_null.cpp \
                                  hwc_tonemapper.cpp \
+                                 hwc_layer_cache.cpp \
+                                 hwc_frame_dumper.cpp \
+                                 hwc_frame_stats.cpp \
+                                 hwc_present_worker.cpp \
                                  hwc_display_external_test.cpp
 
 ifneq ($(TARGET_USES_GRALLOC1), true)
@@ -72,4 +76,12 @@ ifeq ($(TARGET_HAS_WIDE_COLOR_DISPLAY), true)
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE                  := hwc_frame_dump_decoder
+LOCAL_MODULE_TAGS             := optional
+LOCAL_CFLAGS                  := -Wall -Werror
+LOCAL_SRC_FILES               := hwc_frame_dump_decoder.cpp
+LOCAL_STATIC_LIBRARIES        := liblz4
+include $(BUILD_HOST_EXECUTABLE)
 endif
@@ -97,6 +97,7 @@ class DisplayNull : public DisplayInterface {
   MAKE_NO_OP(SetCompositionState(LayerComposition, bool))
   MAKE_NO_OP(GetClientTargetSupport(uint32_t, uint32_t, LayerBufferFormat,
                                     const ColorMetaData &))
+  MAKE_NO_OP(GetOutputBufferSupport(LayerBufferFormat))
   std::string Dump() { return ""; }
   MAKE_NO_OP(SetDynamicDSIClock(uint64_t bitclk))
   MAKE_NO_OP(GetDynamicDSIClock(uint64_t *bitclk))
@@ -68,6 +68,9 @@ DisplayError HWCBufferAllocator::Init() {
   Unlock_ = reinterpret_cast<GRALLOC1_PFN_UNLOCK>(
       gralloc_device_->getFunction(gralloc_device_, GRALLOC1_FUNCTION_UNLOCK));
 
+  // Buffers allocated here are never handed to other processes, so freed ones may be recycled
+  Perform_(gralloc_device_, GRALLOC1_MODULE_PERFORM_ENABLE_BUFFER_POOL);
+
   return kErrorNone;
 }
 
@@ -134,9 +137,18 @@ DisplayError HWCBufferAllocator::AllocateBuffer(BufferInfo *buffer_info) {
 }
 
 DisplayError HWCBufferAllocator::FreeBuffer(BufferInfo *buffer_info) {
+  return FreeBuffer(buffer_info, -1);
+}
+
+DisplayError HWCBufferAllocator::FreeBuffer(BufferInfo *buffer_info, int release_fence) {
   DisplayError err = kErrorNone;
   buffer_handle_t hnd = static_cast<private_handle_t *>(buffer_info->private_data);
-  ReleaseBuffer_(gralloc_device_, hnd);
+  if (release_fence >= 0) {
+    // The fence stays ours; gralloc keeps its own reference until the buffer is recycled.
+    Perform_(gralloc_device_, GRALLOC1_MODULE_PERFORM_RELEASE_BUFFER_FENCED, hnd, release_fence);
+  } else {
+    ReleaseBuffer_(gralloc_device_, hnd);
+  }
   AllocatedBufferInfo *alloc_buffer_info = &buffer_info->alloc_buffer_info;
 
   alloc_buffer_info->fd = -1;
@@ -49,6 +49,9 @@ class HWCBufferAllocator : public BufferAllocator {
   DisplayError Deinit();
   DisplayError AllocateBuffer(BufferInfo *buffer_info);
   DisplayError FreeBuffer(BufferInfo *buffer_info);
+  // Frees a buffer whose last hardware access ends when release_fence signals. The fence is
+  // not consumed.
+  DisplayError FreeBuffer(BufferInfo *buffer_info, int release_fence);
   uint32_t GetBufferSize(BufferInfo *buffer_info);
 
   void GetCustomWidthAndHeight(const private_handle_t *handle, int *width, int *height);
@@ -39,6 +39,8 @@
 
 #include "hwc_display.h"
 #include "hwc_debugger.h"
+#include "hwc_frame_dumper.h"
+#include "hwc_layer_cache.h"
 #include "blit_engine_c2d.h"
 #include "hwc_tonemapper.h"
 
@@ -54,7 +56,7 @@
 
 namespace sdm {
 
-std::bitset<kDisplayMax> HWCDisplay::validated_ = 0;
+DisplayMask HWCDisplay::validated_;
 
 // This weight function is needed because the color primaries are not sorted by gamut size
 static ColorPrimaries WidestPrimaries(ColorPrimaries p1, ColorPrimaries p2) {
@@ -368,6 +370,10 @@ int HWCDisplay::Init() {
     DLOGI("HDR Handling disabled");
   }
 
+  int frame_stats_enabled = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_FRAME_STATS_PROP, &frame_stats_enabled);
+  frame_stats_.SetEnabled(frame_stats_enabled != 0);
+
   int property_swap_interval = 1;
   HWCDebugHandler::Get()->GetProperty(ZERO_SWAP_INTERVAL, &property_swap_interval);
   if (property_swap_interval == 0) {
@@ -392,8 +398,15 @@ int HWCDisplay::Init() {
 
   tone_mapper_ = new HWCToneMapper(buffer_allocator_);
 
+  int layer_cache_enabled = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_LAYER_CACHE_PROP, &layer_cache_enabled);
+  if (layer_cache_enabled == 1) {
+    layer_cache_ = new HWCLayerCache(buffer_allocator_);
+  }
+
   display_intf_->GetRefreshRateRange(&min_refresh_rate_, &max_refresh_rate_);
   current_refresh_rate_ = max_refresh_rate_;
+  ResetVsyncModel();
 
   GetUnderScanConfig();
   DLOGI("Display created with id: %d", id_);
@@ -421,14 +434,26 @@ int HWCDisplay::Deinit() {
   delete tone_mapper_;
   tone_mapper_ = nullptr;
 
+  delete layer_cache_;
+  layer_cache_ = nullptr;
+
+  for (auto &dump : dump_done_fences_) {
+    close(dump.second);
+  }
+  dump_done_fences_.clear();
+
   return 0;
 }
 
 // LayerStack operations
 HWC2::Error HWCDisplay::CreateLayer(hwc2_layer_t *out_layer_id) {
-  HWCLayer *layer = *layer_set_.emplace(new HWCLayer(id_, buffer_allocator_));
-  layer_map_.emplace(std::make_pair(layer->GetId(), layer));
-  *out_layer_id = layer->GetId();
+  HWCLayer *layer = new HWCLayer(id_, buffer_allocator_);
+  hwc2_layer_t layer_id = layer->GetId();
+  // Layer ids are handed out in increasing order, so this is an append in practice.
+  layer_map_.insert(FindLayer(layer_id), std::make_pair(layer_id, layer));
+  layer_set_.insert(std::upper_bound(layer_set_.begin(), layer_set_.end(), layer, SortLayersByZ()),
+                    layer);
+  *out_layer_id = layer_id;
   geometry_changes_ |= GeometryChanges::kAdded;
   validated_.reset();
   layer_stack_invalid_ = true;
@@ -436,9 +461,16 @@ HWC2::Error HWCDisplay::CreateLayer(hwc2_layer_t *out_layer_id) {
   return HWC2::Error::None;
 }
 
+std::vector<HWCDisplay::LayerMapEntry>::iterator HWCDisplay::FindLayer(hwc2_layer_t layer_id) {
+  return std::lower_bound(layer_map_.begin(), layer_map_.end(), layer_id,
+                          [](const LayerMapEntry &entry, hwc2_layer_t id) {
+                            return entry.first < id;
+                          });
+}
+
 HWCLayer *HWCDisplay::GetHWCLayer(hwc2_layer_t layer_id) {
-  const auto map_layer = layer_map_.find(layer_id);
-  if (map_layer == layer_map_.end()) {
+  const auto map_layer = FindLayer(layer_id);
+  if (map_layer == layer_map_.end() || map_layer->first != layer_id) {
     DLOGE("[%" PRIu64 "] GetLayer(%" PRIu64 ") failed: no such layer", id_, layer_id);
     return nullptr;
   } else {
@@ -447,21 +479,15 @@ HWCLayer *HWCDisplay::GetHWCLayer(hwc2_layer_t layer_id) {
 }
 
 HWC2::Error HWCDisplay::DestroyLayer(hwc2_layer_t layer_id) {
-  const auto map_layer = layer_map_.find(layer_id);
-  if (map_layer == layer_map_.end()) {
+  const auto map_layer = FindLayer(layer_id);
+  if (map_layer == layer_map_.end() || map_layer->first != layer_id) {
     DLOGE("[%" PRIu64 "] destroyLayer(%" PRIu64 ") failed: no such layer", id_, layer_id);
     return HWC2::Error::BadLayer;
   }
   const auto layer = map_layer->second;
   layer_map_.erase(map_layer);
-  const auto z_range = layer_set_.equal_range(layer);
-  for (auto current = z_range.first; current != z_range.second; ++current) {
-    if (*current == layer) {
-      current = layer_set_.erase(current);
-      delete layer;
-      break;
-    }
-  }
+  layer_set_.erase(std::find(layer_set_.begin(), layer_set_.end(), layer));
+  delete layer;
 
   geometry_changes_ |= GeometryChanges::kRemoved;
   validated_.reset();
@@ -471,8 +497,17 @@ HWC2::Error HWCDisplay::DestroyLayer(hwc2_layer_t layer_id) {
 }
 
 
+void HWCDisplay::ResetLayerStack() {
+  // Clear in place instead of assigning a new LayerStack, so that the layers vector keeps its
+  // capacity across frames and steady state frames do not touch the heap.
+  layer_stack_.layers.clear();
+  layer_stack_.retire_fence_fd = -1;
+  layer_stack_.output_buffer = NULL;
+  layer_stack_.flags = {};
+}
+
 void HWCDisplay::BuildLayerStack() {
-  layer_stack_ = LayerStack();
+  ResetLayerStack();
   display_rect_ = LayerRect();
   metadata_refresh_rate_ = 0;
   auto working_primaries = ColorPrimaries_BT709_5;
@@ -630,11 +665,15 @@ void HWCDisplay::BuildLayerStack() {
   // set secure display
   SetSecureDisplay(secure_display_active);
 
+  if (layer_cache_) {
+    layer_cache_->HandleLayerStack(&layer_stack_);
+  }
+
   layer_stack_invalid_ = false;
 }
 
 void HWCDisplay::BuildSolidFillStack() {
-  layer_stack_ = LayerStack();
+  ResetLayerStack();
   display_rect_ = LayerRect();
 
   layer_stack_.layers.push_back(solid_fill_layer_);
@@ -644,34 +683,29 @@ void HWCDisplay::BuildSolidFillStack() {
 }
 
 HWC2::Error HWCDisplay::SetLayerZOrder(hwc2_layer_t layer_id, uint32_t z) {
-  const auto map_layer = layer_map_.find(layer_id);
-  if (map_layer == layer_map_.end()) {
+  const auto map_layer = FindLayer(layer_id);
+  if (map_layer == layer_map_.end() || map_layer->first != layer_id) {
     DLOGE("[%" PRIu64 "] updateLayerZ failed to find layer", id_);
     return HWC2::Error::BadLayer;
   }
 
   const auto layer = map_layer->second;
-  const auto z_range = layer_set_.equal_range(layer);
-  bool layer_on_display = false;
-  for (auto current = z_range.first; current != z_range.second; ++current) {
-    if (*current == layer) {
-      if ((*current)->GetZ() == z) {
-        // Don't change anything if the Z hasn't changed
-        return HWC2::Error::None;
-      }
-      current = layer_set_.erase(current);
-      layer_on_display = true;
-      break;
-    }
+  if (layer->GetZ() == z) {
+    // Don't change anything if the Z hasn't changed
+    return HWC2::Error::None;
   }
 
-  if (!layer_on_display) {
+  const auto current = std::find(layer_set_.begin(), layer_set_.end(), layer);
+  if (current == layer_set_.end()) {
     DLOGE("[%" PRIu64 "] updateLayerZ failed to find layer on display", id_);
     return HWC2::Error::BadLayer;
   }
 
+  // Move the layer to its new slot; layers with equal Z keep their insertion order.
+  layer_set_.erase(current);
   layer->SetLayerZOrder(z);
-  layer_set_.emplace(layer);
+  layer_set_.insert(std::upper_bound(layer_set_.begin(), layer_set_.end(), layer, SortLayersByZ()),
+                    layer);
   return HWC2::Error::None;
 }
 
@@ -723,6 +757,9 @@ HWC2::Error HWCDisplay::SetPowerMode(HWC2::PowerMode mode) {
       if (tone_mapper_) {
         tone_mapper_->Terminate();
       }
+      if (layer_cache_) {
+        layer_cache_->Invalidate();
+      }
       break;
     case HWC2::PowerMode::On:
       state = kStateOn;
@@ -901,6 +938,7 @@ HWC2::Error HWCDisplay::SetClientTarget(buffer_handle_t target, int32_t acquire_
   // The error is problematic for layer caching as it would overwrite our cached client target.
   // Reported bug 28569722 to resolve this.
   // For now, continue to use the last valid buffer reported to us for layer caching.
+  present_inputs_ |= kPresentInputClientTarget;
   if (target == nullptr) {
     return HWC2::Error::None;
   }
@@ -926,6 +964,7 @@ HWC2::Error HWCDisplay::SetActiveConfig(hwc2_config_t config) {
     return HWC2::Error::BadConfig;
   }
 
+  ResetVsyncModel();
   validated_.reset();
   return HWC2::Error::None;
 }
@@ -952,6 +991,7 @@ HWC2::PowerMode HWCDisplay::GetLastPowerMode() {
 }
 
 DisplayError HWCDisplay::VSync(const DisplayEventVSync &vsync) {
+  vsync_model_.AddSample(vsync.timestamp);
   if (is_primary_) {
     callbacks_->Vsync(HWC_DISPLAY_PRIMARY, vsync.timestamp);
     return kErrorNone;
@@ -1010,6 +1050,11 @@ HWC2::Error HWCDisplay::PrepareLayerStack(uint32_t *out_num_types, uint32_t *out
       return HWC2::Error::BadDisplay;
     } else {
       validated_.set(type_);
+      present_inputs_ = kPresentInputValidated;
+    }
+
+    if (layer_cache_) {
+      layer_cache_->UpdateCompositions();
     }
   } else {
     // Skip is not set
@@ -1026,7 +1071,7 @@ HWC2::Error HWCDisplay::PrepareLayerStack(uint32_t *out_num_types, uint32_t *out
 
     if ((composition == kCompositionSDE) || (composition == kCompositionHybrid) ||
         (composition == kCompositionBlit)) {
-      layer_requests_[hwc_layer->GetId()] = HWC2::LayerRequest::ClearClientTarget;
+      layer_requests_.emplace_back(hwc_layer->GetId(), HWC2::LayerRequest::ClearClientTarget);
     }
 
     HWC2::Composition requested_composition = hwc_layer->GetClientRequestedCompositionType();
@@ -1036,7 +1081,7 @@ HWC2::Error HWCDisplay::PrepareLayerStack(uint32_t *out_num_types, uint32_t *out
     // Update the changes list only if the requested composition is different from SDM comp type
     // TODO(user): Take Care of other comptypes(BLIT)
     if (requested_composition != device_composition) {
-      layer_changes_[hwc_layer->GetId()] = device_composition;
+      layer_changes_.emplace_back(hwc_layer->GetId(), device_composition);
     }
     hwc_layer->ResetValidation();
   }
@@ -1061,10 +1106,10 @@ HWC2::Error HWCDisplay::AcceptDisplayChanges() {
   }
 
   for (const auto& change : layer_changes_) {
-    auto hwc_layer = layer_map_[change.first];
+    auto map_layer = FindLayer(change.first);
     auto composition = change.second;
-    if (hwc_layer != nullptr) {
-      hwc_layer->UpdateClientCompositionType(composition);
+    if (map_layer != layer_map_.end() && map_layer->first == change.first) {
+      map_layer->second->UpdateClientCompositionType(composition);
     } else {
       DLOGW("Invalid layer: %" PRIu64, change.first);
     }
@@ -1086,7 +1131,7 @@ HWC2::Error HWCDisplay::GetChangedCompositionTypes(uint32_t *out_num_elements,
   *out_num_elements = UINT32(layer_changes_.size());
   if (out_layers != nullptr && out_types != nullptr) {
     int i = 0;
-    for (auto change : layer_changes_) {
+    for (const auto &change : layer_changes_) {
       out_layers[i] = change.first;
       out_types[i] = INT32(change.second);
       i++;
@@ -1246,6 +1291,10 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(int32_t *out_retire_fence) {
      tone_mapper_->PostCommit(&layer_stack_);
   }
 
+  if (layer_cache_) {
+    layer_cache_->PostCommit(flush_);
+  }
+
   // TODO(user): No way to set the client target release fence on SF
   int32_t &client_target_release_fence =
       client_target_->GetSDMLayer()->input_buffer.release_fence_fd;
@@ -1257,24 +1306,38 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(int32_t *out_retire_fence) {
 
   for (auto hwc_layer : layer_set_) {
     hwc_layer->ResetGeometryChanges();
+    hwc_layer->DropStaleBuffers();
     Layer *layer = hwc_layer->GetSDMLayer();
     LayerBuffer *layer_buffer = &layer->input_buffer;
 
+    // Buffer being copied by the frame dumper, not to be released before it is done.
+    int dump_done_fence = -1;
+    auto dump = dump_done_fences_.find(layer);
+    if (dump != dump_done_fences_.end()) {
+      dump_done_fence = dump->second;
+      dump_done_fences_.erase(dump);
+    }
+
     if (!flush_) {
       // If swapinterval property is set to 0 or for single buffer layers, do not update f/w
       // release fences and discard fences from driver
       if (swap_interval_zero_ || layer->flags.single_buffer) {
         close(layer_buffer->release_fence_fd);
+        // Rendered into while displayed, the dump cannot be consistent anyway.
+        if (dump_done_fence >= 0) {
+          close(dump_done_fence);
+        }
       } else if (layer->composition != kCompositionGPU) {
+        HWCFrameDumper::MergeDoneFence(dump_done_fence, &layer_buffer->release_fence_fd);
         hwc_layer->PushReleaseFence(layer_buffer->release_fence_fd);
       } else {
-        hwc_layer->PushReleaseFence(-1);
+        hwc_layer->PushReleaseFence(dump_done_fence);
       }
     } else {
       // In case of flush, we don't return an error to f/w, so it will get a release fence out of
-      // the hwc_layer's release fence queue. We should push a -1 to preserve release fence
-      // circulation semantics.
-      hwc_layer->PushReleaseFence(-1);
+      // the hwc_layer's release fence queue. We should push a -1, or the frame dumper's fence,
+      // to preserve release fence circulation semantics.
+      hwc_layer->PushReleaseFence(dump_done_fence);
     }
 
     layer_buffer->release_fence_fd = -1;
@@ -1303,6 +1366,12 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(int32_t *out_retire_fence) {
     }
   }
 
+  // Left over is the client target, SF releases it with the retire fence.
+  for (auto &dump : dump_done_fences_) {
+    HWCFrameDumper::MergeDoneFence(dump.second, out_retire_fence);
+  }
+  dump_done_fences_.clear();
+
   geometry_changes_ = GeometryChanges::kNone;
   flush_ = false;
 
@@ -1472,112 +1541,72 @@ void HWCDisplay::DumpInputBuffers() {
   snprintf(dir_path, sizeof(dir_path), "%s/frame_dump_%s", HWCDebugHandler::DumpDir(),
            GetDisplayString());
 
-  if (mkdir(dir_path, 0777) != 0 && errno != EEXIST) {
-    DLOGW("Failed to create %s directory errno = %d, desc = %s", dir_path, errno, strerror(errno));
-    return;
-  }
-
-  // if directory exists already, need to explicitly change the permission.
-  if (errno == EEXIST && chmod(dir_path, 0777) != 0) {
-    DLOGW("Failed to change permissions on %s directory", dir_path);
-    return;
-  }
-
+  // The frame dumper waits for the fences and copies the buffers on its own thread. The buffers
+  // are handed back only once it is done, PostCommitLayerStack() merges its done fences into the
+  // release fences.
   for (uint32_t i = 0; i < layer_stack_.layers.size(); i++) {
     auto layer = layer_stack_.layers.at(i);
     const private_handle_t *pvt_handle =
         reinterpret_cast<const private_handle_t *>(layer->input_buffer.buffer_id);
-    auto &acquire_fence_fd = layer->input_buffer.acquire_fence_fd;
-
-    if (acquire_fence_fd >= 0) {
-      DisplayError error = buffer_allocator_->MapBuffer(pvt_handle, acquire_fence_fd);
-      if (error != kErrorNone) {
-        continue;
-      }
-      acquire_fence_fd = -1;
-    }
-
-    DLOGI("Dump layer[%d] of %d pvt_handle %x pvt_handle->base %x", i, layer_stack_.layers.size(),
-          pvt_handle, pvt_handle? pvt_handle->base : 0);
 
     if (!pvt_handle) {
       DLOGE("Buffer handle is null");
       return;
     }
 
-    if (!pvt_handle->base) {
-      DisplayError error = buffer_allocator_->MapBuffer(pvt_handle, -1);
-      if (error != kErrorNone) {
-        DLOGE("Failed to map buffer, error = %d", error);
-        return;
-      }
-    }
-
     char dump_file_name[PATH_MAX];
-    size_t result = 0;
-
-    snprintf(dump_file_name, sizeof(dump_file_name), "%s/input_layer%d_%dx%d_%s_frame%d.raw",
-             dir_path, i, pvt_handle->width, pvt_handle->height,
+    snprintf(dump_file_name, sizeof(dump_file_name), "input_layer%d_%dx%d_%s_frame%d.raw.lz4",
+             i, pvt_handle->width, pvt_handle->height,
              qdutils::GetHALPixelFormatString(pvt_handle->format), dump_frame_index_);
 
-    FILE *fp = fopen(dump_file_name, "w+");
-    if (fp) {
-      result = fwrite(reinterpret_cast<void *>(pvt_handle->base), pvt_handle->size, 1, fp);
-      fclose(fp);
+    FrameDumpHeader header;
+    header.width = UINT32(pvt_handle->width);
+    header.height = UINT32(pvt_handle->height);
+    header.stride = layer->input_buffer.planes[0].stride;
+    header.format = UINT32(pvt_handle->format);
+    header.frame_index = dump_frame_index_;
+    header.layer_index = i;
+    header.raw_size = pvt_handle->size;
+    snprintf(header.format_name, sizeof(header.format_name), "%s",
+             qdutils::GetHALPixelFormatString(pvt_handle->format));
+
+    int done_fence = HWCFrameDumper::GetInstance()->Queue(dir_path, dump_file_name,
+                                                          pvt_handle->fd, pvt_handle->offset,
+                                                          layer->input_buffer.acquire_fence_fd,
+                                                          header);
+    if (done_fence >= 0) {
+      dump_done_fences_[layer] = done_fence;
     }
-
-    int release_fence = -1;
-    DisplayError error = buffer_allocator_->UnmapBuffer(pvt_handle, &release_fence);
-    if (error != kErrorNone) {
-      DLOGE("Failed to unmap buffer, error = %d", error);
-      return;
-    }
-
-    DLOGI("Frame Dump %s: is %s", dump_file_name, result ? "Successful" : "Failed");
   }
 }
 
-void HWCDisplay::DumpOutputBuffer(const BufferInfo &buffer_info, void *base, int fence) {
+int HWCDisplay::DumpOutputBuffer(const BufferInfo &buffer_info, int fence) {
   char dir_path[PATH_MAX];
+  char dump_file_name[PATH_MAX];
+  const BufferConfig &buffer_config = buffer_info.buffer_config;
 
-  snprintf(dir_path, sizeof(dir_path), "%s/frame_dump_%s", HWCDebugHandler::DumpDir(),
-           GetDisplayString());
-
-  if (mkdir(dir_path, 777) != 0 && errno != EEXIST) {
-    DLOGW("Failed to create %s directory errno = %d, desc = %s", dir_path, errno, strerror(errno));
-    return;
-  }
-
-  // if directory exists already, need to explicitly change the permission.
-  if (errno == EEXIST && chmod(dir_path, 0777) != 0) {
-    DLOGW("Failed to change permissions on %s directory", dir_path);
-    return;
+  if (buffer_info.alloc_buffer_info.fd < 0) {
+    return -1;
   }
 
-  if (base) {
-    char dump_file_name[PATH_MAX];
-    size_t result = 0;
-
-    if (fence >= 0) {
-      int error = sync_wait(fence, 1000);
-      if (error < 0) {
-        DLOGW("sync_wait error errno = %d, desc = %s", errno, strerror(errno));
-        return;
-      }
-    }
-
-    snprintf(dump_file_name, sizeof(dump_file_name), "%s/output_layer_%dx%d_%s_frame%d.raw",
-             dir_path, buffer_info.buffer_config.width, buffer_info.buffer_config.height,
-             GetFormatString(buffer_info.buffer_config.format), dump_frame_index_);
+  snprintf(dir_path, sizeof(dir_path), "%s/frame_dump_%s", HWCDebugHandler::DumpDir(),
+           GetDisplayString());
+  snprintf(dump_file_name, sizeof(dump_file_name), "output_layer_%dx%d_%s_frame%d.raw.lz4",
+           buffer_config.width, buffer_config.height, GetFormatString(buffer_config.format),
+           dump_frame_index_);
 
-    FILE *fp = fopen(dump_file_name, "w+");
-    if (fp) {
-      result = fwrite(base, buffer_info.alloc_buffer_info.size, 1, fp);
-      fclose(fp);
-    }
+  FrameDumpHeader header;
+  header.width = buffer_config.width;
+  header.height = buffer_config.height;
+  header.stride = buffer_info.alloc_buffer_info.stride;
+  header.format = UINT32(buffer_config.format);
+  header.frame_index = dump_frame_index_;
+  header.raw_size = buffer_info.alloc_buffer_info.size;
+  snprintf(header.format_name, sizeof(header.format_name), "%s",
+           GetFormatString(buffer_config.format));
 
-    DLOGI("Frame Dump of %s is %s", dump_file_name, result ? "Successful" : "Failed");
-  }
+  return HWCFrameDumper::GetInstance()->Queue(dir_path, dump_file_name,
+                                              buffer_info.alloc_buffer_info.fd, 0, fence, header);
 }
 
 const char *HWCDisplay::GetDisplayString() {
@@ -1781,6 +1810,9 @@ int HWCDisplay::OnMinHdcpEncryptionLevelChange(uint32_t min_enc_level) {
 }
 
 void HWCDisplay::MarkLayersForGPUBypass() {
+  if (layer_cache_) {
+    layer_cache_->RestoreLayerStack(&layer_stack_);
+  }
   for (auto hwc_layer : layer_set_) {
     auto layer = hwc_layer->GetSDMLayer();
     layer->composition = kCompositionSDE;
@@ -1793,6 +1825,10 @@ void HWCDisplay::MarkLayersForClientComposition() {
   // SDM does not handle this layer and hwc_layer composition will be
   // set correctly at the end of Prepare.
   DLOGV_IF(kTagClient, "HWC Layers marked for GPU comp");
+  if (layer_cache_) {
+    // The cached layer would not be skipped along with the layers it stands for.
+    layer_cache_->RestoreLayerStack(&layer_stack_);
+  }
   for (auto hwc_layer : layer_set_) {
     Layer *layer = hwc_layer->GetSDMLayer();
     layer->flags.skip = true;
@@ -1868,7 +1904,7 @@ void HWCDisplay::SolidFillPrepare() {
     solid_fill_layer_->blending = kBlendingPremultiplied;
     solid_fill_layer_->solid_fill_color = solid_fill_color_;
     solid_fill_layer_->frame_rate = 60;
-    solid_fill_layer_->visible_regions.push_back(solid_fill_layer_->dst_rect);
+    solid_fill_layer_->visible_regions.assign(1, solid_fill_layer_->dst_rect);
     solid_fill_layer_->flags.updating = 1;
     solid_fill_layer_->flags.solid_fill = true;
   } else {
@@ -1939,6 +1975,17 @@ int HWCDisplay::GetDisplayConfigCount(uint32_t *count) {
   return display_intf_->GetNumVariableInfoConfigs(count) == kErrorNone ? 0 : -1;
 }
 
+void HWCDisplay::ResetVsyncModel() {
+  uint32_t active_index = 0;
+  DisplayConfigVariableInfo display_attributes;
+  if (display_intf_->GetActiveConfig(&active_index) != kErrorNone ||
+      display_intf_->GetConfig(active_index, &display_attributes) != kErrorNone) {
+    return;
+  }
+
+  vsync_model_.Reset(display_attributes.vsync_period_ns);
+}
+
 int HWCDisplay::GetDisplayAttributesForConfig(int config,
                                             DisplayConfigVariableInfo *display_attributes) {
   return display_intf_->GetConfig(UINT32(config), display_attributes) == kErrorNone ? 0 : -1;
@@ -2040,6 +2087,13 @@ std::string HWCDisplay::Dump() {
     return os.str();
   }
 
+  os << "vsync period: " << vsync_model_.GetPeriod() << " ns";
+  os << " outliers: " << vsync_model_.GetOutlierCount() << std::endl;
+  frame_stats_.Dump(&os);
+  if (layer_cache_) {
+    layer_cache_->Dump(&os);
+  }
+
   if (color_mode_) {
     os << "\n----------Color Modes---------\n";
     color_mode_->Dump(&os);
@@ -2055,6 +2109,11 @@ std::string HWCDisplay::Dump() {
   return os.str();
 }
 
+bool HWCDisplay::IsReadyForAsyncPresent() {
+  return validated_.test(type_) && (present_inputs_ & kPresentInputValidated) &&
+         (present_inputs_ & kPresentInputClientTarget) && !shutdown_pending_ && !flush_;
+}
+
 bool HWCDisplay::CanSkipValidate() {
   // Layer Stack checks
   if (layer_stack_.flags.hdr_present && (tone_mapper_ && tone_mapper_->IsActive())) {
@@ -26,6 +26,8 @@
 #include <hardware/hwcomposer.h>
 #include <private/color_params.h>
 #include <qdMetaData.h>
+#include <utils/vsync_model.h>
+#include <atomic>
 #include <map>
 #include <queue>
 #include <set>
@@ -35,12 +37,27 @@
 
 #include "hwc_buffer_allocator.h"
 #include "hwc_callbacks.h"
+#include "hwc_frame_stats.h"
 #include "hwc_layers.h"
 
 namespace sdm {
 
 class BlitEngine;
 class HWCToneMapper;
+class HWCLayerCache;
+
+// Validation state of all displays. Displays may be presented from different threads, see
+// HWCSession::StartAsyncPresents, so bits are flipped atomically.
+class DisplayMask {
+ public:
+  bool test(uint32_t display) const { return (mask_.load() & (1U << display)) != 0; }
+  void set(uint32_t display) { mask_.fetch_or(1U << display); }
+  void reset(uint32_t display) { mask_.fetch_and(~(1U << display)); }
+  void reset() { mask_.store(0); }
+
+ private:
+  std::atomic<uint32_t> mask_ {0};
+};
 
 // Subclasses set this to their type. This has to be different from DisplayType.
 // This is to avoid RTTI and dynamic_cast
@@ -166,9 +183,19 @@ class HWCDisplay : public DisplayEventHandler {
   int GetVisibleDisplayRect(hwc_rect_t *rect);
   void BuildLayerStack(void);
   void BuildSolidFillStack(void);
+  void ResetLayerStack(void);
   HWCLayer *GetHWCLayer(hwc2_layer_t layer);
   void ResetValidation() { validated_.reset(); }
   uint32_t GetGeometryChanges() { return geometry_changes_; }
+  int64_t PredictVsync(int64_t time_ns, uint32_t index) {
+    return vsync_model_.PredictVsync(time_ns, index);
+  }
+  int64_t GetVsyncPeriodNs() { return vsync_model_.GetPeriod(); }
+  HWCFrameStats *GetFrameStats() { return &frame_stats_; }
+  // True once the client validated the display and handed in everything it needs for the
+  // next present, so that the present can start before the client asks for it.
+  virtual bool IsReadyForAsyncPresent();
+  void ResetPresentInputs() { present_inputs_ = 0; }
 
   // HWC2 APIs
   virtual HWC2::Error AcceptDisplayChanges(void);
@@ -218,7 +245,7 @@ class HWCDisplay : public DisplayEventHandler {
                                          float* out_min_luminance);
   virtual HWC2::Error SetDisplayAnimating(bool animating) {
     animating_ = animating;
-    validated_ = false;
+    validated_.reset();
     return HWC2::Error::None;
   }
   virtual DisplayError SetDynamicDSIClock(uint64_t bitclk) {
@@ -244,9 +271,11 @@ class HWCDisplay : public DisplayEventHandler {
   virtual DisplayError Refresh();
   virtual DisplayError CECMessage(char *message);
   virtual DisplayError HandleEvent(DisplayEvent event);
-  virtual void DumpOutputBuffer(const BufferInfo &buffer_info, void *base, int fence);
+  // Returns the frame dumper's copy done fence, see HWCFrameDumper::Queue().
+  virtual int DumpOutputBuffer(const BufferInfo &buffer_info, int fence);
   virtual HWC2::Error PrepareLayerStack(uint32_t *out_num_types, uint32_t *out_num_requests);
   virtual HWC2::Error CommitLayerStack(void);
+  void ResetVsyncModel();
   virtual HWC2::Error PostCommitLayerStack(int32_t *out_retire_fence);
   virtual DisplayError DisablePartialUpdateOneFrame() {
     return kErrorNotSupported;
@@ -268,7 +297,17 @@ class HWCDisplay : public DisplayEventHandler {
     OUTPUT_LAYER_DUMP,
   };
 
-  static std::bitset<kDisplayMax> validated_;
+  typedef std::pair<hwc2_layer_t, HWCLayer *> LayerMapEntry;
+
+  std::vector<LayerMapEntry>::iterator FindLayer(hwc2_layer_t layer_id);
+
+  enum PresentInputs {
+    kPresentInputValidated = 0x1,
+    kPresentInputClientTarget = 0x2,
+    kPresentInputOutputBuffer = 0x4,
+  };
+
+  static DisplayMask validated_;
   bool layer_stack_invalid_ = true;
   CoreInterface *core_intf_ = nullptr;
   HWCCallbacks *callbacks_  = nullptr;
@@ -279,14 +318,17 @@ class HWCDisplay : public DisplayEventHandler {
   DisplayInterface *display_intf_ = NULL;
   LayerStack layer_stack_;
   HWCLayer *client_target_ = nullptr;                   // Also known as framebuffer target
-  std::map<hwc2_layer_t, HWCLayer *> layer_map_;        // Look up by Id - TODO
-  std::multiset<HWCLayer *, SortLayersByZ> layer_set_;  // Maintain a set sorted by Z
-  std::map<hwc2_layer_t, HWC2::Composition> layer_changes_;
-  std::map<hwc2_layer_t, HWC2::LayerRequest> layer_requests_;
+  // Layers are kept in flat vectors so that per frame passes walk contiguous memory.
+  std::vector<LayerMapEntry> layer_map_ = {};        // Look up by Id, sorted by Id
+  std::vector<HWCLayer *> layer_set_ = {};           // Sorted by Z, re-sorted only on Z change
+  std::vector<std::pair<hwc2_layer_t, HWC2::Composition>> layer_changes_ = {};
+  std::vector<std::pair<hwc2_layer_t, HWC2::LayerRequest>> layer_requests_ = {};
+  uint32_t present_inputs_ = 0;
   bool flush_on_error_ = false;
   bool flush_ = false;
   uint32_t dump_frame_count_ = 0;
   uint32_t dump_frame_index_ = 0;
+  std::map<const Layer *, int> dump_done_fences_;  // Input buffers the frame dumper still copies
   bool dump_input_layers_ = false;
   HWC2::PowerMode last_power_mode_;
   bool swap_interval_zero_ = false;
@@ -311,8 +353,11 @@ class HWCDisplay : public DisplayEventHandler {
   bool color_tranform_failed_ = false;
   HWCColorMode *color_mode_ = NULL;
   HWCToneMapper *tone_mapper_ = nullptr;
+  HWCLayerCache *layer_cache_ = nullptr;
   uint32_t num_configs_ = 0;
   int disable_hdr_handling_ = 0;  // disables HDR handling.
+  VsyncModel vsync_model_;
+  HWCFrameStats frame_stats_;
 
  private:
   void DumpInputBuffers(void);
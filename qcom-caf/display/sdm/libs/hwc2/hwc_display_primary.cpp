@@ -32,7 +32,6 @@
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <stdarg.h>
-#include <sys/mman.h>
 
 #include <map>
 #include <string>
@@ -205,6 +204,9 @@ HWC2::Error HWCDisplayPrimary::Validate(uint32_t *out_num_types, uint32_t *out_n
   }
 
   if (error == kErrorNone) {
+    if (current_refresh_rate_ != refresh_rate && refresh_rate) {
+      vsync_model_.Reset(1000000000LL / refresh_rate);
+    }
     // On success, set current refresh rate to new refresh rate
     current_refresh_rate_ = refresh_rate;
   }
@@ -218,7 +220,7 @@ HWC2::Error HWCDisplayPrimary::Validate(uint32_t *out_num_types, uint32_t *out_n
     DisplayConfigFixedInfo display_config;
     display_intf_->GetConfig(&display_config);
     flush_ = !(display_config.is_cmdmode && secure_display_active_);
-    validated_ = true;
+    validated_.set(type_);
     return status;
   }
 
@@ -473,23 +475,27 @@ void HWCDisplayPrimary::HandleFrameCapture() {
 }
 
 void HWCDisplayPrimary::HandleFrameDump() {
+  // Consumed by the writeback that just completed.
+  if (output_buffer_.acquire_fence_fd >= 0) {
+    ::close(output_buffer_.acquire_fence_fd);
+    output_buffer_.acquire_fence_fd = -1;
+  }
+
   if (dump_frame_count_ && output_buffer_.release_fence_fd >= 0) {
-    int ret = sync_wait(output_buffer_.release_fence_fd, 1000);
+    // The frame dumper waits on its own copy of the fence. The next writeback into the buffer
+    // waits for the copy to be done.
+    output_buffer_.acquire_fence_fd = DumpOutputBuffer(output_buffer_info_,
+                                                       output_buffer_.release_fence_fd);
     ::close(output_buffer_.release_fence_fd);
     output_buffer_.release_fence_fd = -1;
-    if (ret < 0) {
-      DLOGE("sync_wait error errno = %d, desc = %s", errno, strerror(errno));
-    } else {
-      DumpOutputBuffer(output_buffer_info_, output_buffer_base_, layer_stack_.retire_fence_fd);
-    }
   }
 
   if (0 == dump_frame_count_) {
     dump_output_to_file_ = false;
-    // Unmap and Free buffer
-    if (munmap(output_buffer_base_, output_buffer_info_.alloc_buffer_info.size) != 0) {
-      DLOGE("unmap failed with err %d", errno);
+    if (output_buffer_.acquire_fence_fd >= 0) {
+      ::close(output_buffer_.acquire_fence_fd);
     }
+    // Free buffer, pending dumps hold their own reference to it.
     if (buffer_allocator_->FreeBuffer(&output_buffer_info_) != 0) {
       DLOGE("FreeBuffer failed");
     }
@@ -497,7 +503,6 @@ void HWCDisplayPrimary::HandleFrameDump() {
     post_processed_output_ = false;
     output_buffer_ = {};
     output_buffer_info_ = {};
-    output_buffer_base_ = nullptr;
   }
 }
 
@@ -523,17 +528,6 @@ void HWCDisplayPrimary::SetFrameDumpConfig(uint32_t count, uint32_t bit_mask_lay
     return;
   }
 
-  void *buffer = mmap(NULL, output_buffer_info_.alloc_buffer_info.size, PROT_READ | PROT_WRITE,
-                      MAP_SHARED, output_buffer_info_.alloc_buffer_info.fd, 0);
-
-  if (buffer == MAP_FAILED) {
-    DLOGE("mmap failed with err %d", errno);
-    buffer_allocator_->FreeBuffer(&output_buffer_info_);
-    output_buffer_info_ = {};
-    return;
-  }
-
-  output_buffer_base_ = buffer;
   post_processed_output_ = true;
   DisablePartialUpdateOneFrame();
   validated_.reset();
@@ -105,7 +105,6 @@ class HWCDisplayPrimary : public HWCDisplay {
   // Members for N frame output dump to file
   bool dump_output_to_file_ = false;
   BufferInfo output_buffer_info_ = {};
-  void *output_buffer_base_ = nullptr;
   int default_mode_status_ = 0;
 
   //Null display
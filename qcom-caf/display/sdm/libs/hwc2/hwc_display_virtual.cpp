@@ -29,14 +29,18 @@
 
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/formats.h>
+#include <utils/rect.h>
 #include <sync/sync.h>
 #include <stdarg.h>
+#include <time.h>
 #ifndef USE_GRALLOC1
 #include <gr.h>
 #endif
 
 #include "hwc_display_virtual.h"
 #include "hwc_debugger.h"
+#include "hwc_frame_dumper.h"
 
 #define __CLASS__ "HWCDisplayVirtual"
 
@@ -81,6 +85,8 @@ int HWCDisplayVirtual::Create(CoreInterface *core_intf, HWCBufferAllocator *buff
     return status;
   }
 
+  hwc_display_virtual->NegotiateOutputFormat(format);
+
   *hwc_display = static_cast<HWCDisplay *>(hwc_display_virtual);
 
   return 0;
@@ -97,6 +103,24 @@ HWCDisplayVirtual::HWCDisplayVirtual(CoreInterface *core_intf, HWCBufferAllocato
                  DISPLAY_CLASS_VIRTUAL, buffer_allocator) {
 }
 
+void HWCDisplayVirtual::NegotiateOutputFormat(int32_t *format) {
+  // Gralloc resolves these from the consumer's usage, e.g. NV12 (UBWC when the encoder can read
+  // it) for a video encoder, so the writeback output is directly consumable without conversion.
+  if (*format == HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED ||
+      *format == HAL_PIXEL_FORMAT_YCbCr_420_888) {
+    return;
+  }
+
+  LayerBufferFormat sdm_format = GetSDMFormat(*format, 0);
+  if (sdm_format != kFormatInvalid &&
+      display_intf_->GetOutputBufferSupport(sdm_format) == kErrorNone) {
+    return;
+  }
+
+  DLOGI("Writeback cannot produce format 0x%x, requesting RGBA_8888", *format);
+  *format = HAL_PIXEL_FORMAT_RGBA_8888;
+}
+
 int HWCDisplayVirtual::Init() {
   output_buffer_ = new LayerBuffer();
   return HWCDisplay::Init();
@@ -104,6 +128,7 @@ int HWCDisplayVirtual::Init() {
 
 int HWCDisplayVirtual::Deinit() {
   int status = 0;
+  output_ring_.clear();
   if (output_buffer_) {
     if (output_buffer_->acquire_fence_fd >= 0) {
       close(output_buffer_->acquire_fence_fd);
@@ -143,36 +168,29 @@ HWC2::Error HWCDisplayVirtual::Present(int32_t *out_retire_fence) {
     if (error != kErrorNone) {
       DLOGE("Flush failed. Error = %d", error);
     }
+    output_full_damage_ = true;
   } else {
     status = HWCDisplay::CommitLayerStack();
     if (status == HWC2::Error::None) {
+      if (output_handle_) {
+        UpdateOutputFrameInfo();
+      }
+
       if (dump_frame_count_ && !flush_ && dump_output_layer_) {
         if (output_handle_) {
           BufferInfo buffer_info;
           const private_handle_t *output_handle =
               reinterpret_cast<const private_handle_t *>(output_buffer_->buffer_id);
-          DisplayError error = kErrorNone;
-          if (!output_handle->base) {
-            error = buffer_allocator_->MapBuffer(output_handle, -1);
-            if (error != kErrorNone) {
-              DLOGE("Failed to map output buffer, error = %d", error);
-              return HWC2::Error::BadParameter;
-            }
-          }
           buffer_info.buffer_config.width = static_cast<uint32_t>(output_handle->width);
           buffer_info.buffer_config.height = static_cast<uint32_t>(output_handle->height);
           buffer_info.buffer_config.format =
               GetSDMFormat(output_handle->format, output_handle->flags);
+          buffer_info.alloc_buffer_info.fd = output_handle->fd;
+          buffer_info.alloc_buffer_info.stride = output_buffer_->planes[0].stride;
           buffer_info.alloc_buffer_info.size = static_cast<uint32_t>(output_handle->size);
-          DumpOutputBuffer(buffer_info, reinterpret_cast<void *>(output_handle->base),
-                           layer_stack_.retire_fence_fd);
-
-          int release_fence = -1;
-          error = buffer_allocator_->UnmapBuffer(output_handle, &release_fence);
-          if (error != kErrorNone) {
-            DLOGE("Failed to unmap buffer, error = %d", error);
-            return HWC2::Error::BadParameter;
-          }
+          // SF reuses the output buffer once the retire fence signals.
+          int done_fence = DumpOutputBuffer(buffer_info, layer_stack_.retire_fence_fd);
+          HWCFrameDumper::MergeDoneFence(done_fence, &layer_stack_.retire_fence_fd);
         }
       }
 
@@ -206,70 +224,154 @@ HWC2::Error HWCDisplayVirtual::SetOutputBuffer(buffer_handle_t buf, int32_t rele
   }
   const private_handle_t *output_handle = static_cast<const private_handle_t *>(buf);
 
+  auto slot = output_ring_.begin();
+  for (; slot != output_ring_.end(); slot++) {
+    if (slot->handle == output_handle && slot->id == output_handle->id &&
+        slot->fd == output_handle->fd) {
+      break;
+    }
+  }
+
+  if (slot == output_ring_.end()) {
+    OutputBufferSlot new_slot;
+    auto status = SetupOutputBuffer(output_handle, &new_slot.buffer);
+    if (status != HWC2::Error::None) {
+      return status;
+    }
+
+    new_slot.handle = output_handle;
+    new_slot.id = output_handle->id;
+    new_slot.fd = output_handle->fd;
+    if (output_ring_.size() >= kOutputRingSize) {
+      output_ring_.erase(output_ring_.begin());
+    }
+    slot = output_ring_.insert(output_ring_.end(), new_slot);
+  }
+
   // Fill output buffer parameters (width, height, format, plane information, fence)
+  if (output_buffer_->acquire_fence_fd >= 0) {
+    close(output_buffer_->acquire_fence_fd);
+  }
+  *output_buffer_ = slot->buffer;
   output_buffer_->acquire_fence_fd = dup(release_fence);
+  output_handle_ = output_handle;
 
-  if (output_handle) {
-    int output_handle_format = output_handle->format;
-    int active_aligned_w, active_aligned_h;
-    int new_width, new_height;
-    int new_aligned_w, new_aligned_h;
-    uint32_t active_width, active_height;
-    ColorMetaData color_metadata = {};
+  present_inputs_ |= kPresentInputOutputBuffer;
+  return HWC2::Error::None;
+}
 
-    if (output_handle_format == HAL_PIXEL_FORMAT_RGBA_8888) {
-      output_handle_format = HAL_PIXEL_FORMAT_RGBX_8888;
-    }
+HWC2::Error HWCDisplayVirtual::SetupOutputBuffer(const private_handle_t *output_handle,
+                                                 LayerBuffer *buffer) {
+  int output_handle_format = output_handle->format;
+  int active_aligned_w, active_aligned_h;
+  int new_width, new_height;
+  int new_aligned_w, new_aligned_h;
+  uint32_t active_width, active_height;
+  ColorMetaData color_metadata = {};
+
+  if (output_handle_format == HAL_PIXEL_FORMAT_RGBA_8888) {
+    output_handle_format = HAL_PIXEL_FORMAT_RGBX_8888;
+  }
 
-    LayerBufferFormat new_sdm_format = GetSDMFormat(output_handle_format, output_handle->flags);
-    if (new_sdm_format == kFormatInvalid) {
-      return HWC2::Error::BadParameter;
-    }
+  LayerBufferFormat new_sdm_format = GetSDMFormat(output_handle_format, output_handle->flags);
+  if (new_sdm_format == kFormatInvalid) {
+    return HWC2::Error::BadParameter;
+  }
+
+  // The consumer picked format and UBWC layout through its usage bits, make sure writeback can
+  // produce it before handing the buffer to the driver.
+  if (display_intf_->GetOutputBufferSupport(new_sdm_format) != kErrorNone) {
+    DLOGW("Writeback cannot produce format %d (ubwc %d)", new_sdm_format,
+          IsUBWCFormat(new_sdm_format));
+    return HWC2::Error::BadParameter;
+  }
+
+  if (sdm::SetCSC(output_handle, &color_metadata) != kErrorNone) {
+    return HWC2::Error::BadParameter;
+  }
 
-    if (sdm::SetCSC(output_handle, &color_metadata) != kErrorNone) {
+  GetMixerResolution(&active_width, &active_height);
+  buffer_allocator_->GetCustomWidthAndHeight(output_handle, &new_width, &new_height);
+  buffer_allocator_->GetAlignedWidthAndHeight(INT(new_width), INT(new_height),
+                                              output_handle_format, 0, &new_aligned_w,
+                                              &new_aligned_h);
+  buffer_allocator_->GetAlignedWidthAndHeight(INT(active_width), INT(active_height),
+                                              output_handle_format, 0, &active_aligned_w,
+                                              &active_aligned_h);
+  if (new_aligned_w != active_aligned_w  || new_aligned_h != active_aligned_h) {
+    int status = SetConfig(UINT32(new_width), UINT32(new_height));
+    if (status) {
+      DLOGE("SetConfig failed custom WxH %dx%d", new_width, new_height);
       return HWC2::Error::BadParameter;
     }
+    validated_.reset();
+    // Buffers set up for the previous resolution are stale now.
+    output_ring_.clear();
+    output_full_damage_ = true;
+  }
+
+  buffer->width = UINT32(new_aligned_w);
+  buffer->height = UINT32(new_aligned_h);
+  buffer->unaligned_width = UINT32(new_width);
+  buffer->unaligned_height = UINT32(new_height);
+  buffer->flags.secure = 0;
+  buffer->flags.video = 0;
+  buffer->buffer_id = reinterpret_cast<uint64_t>(output_handle);
+  buffer->format = new_sdm_format;
+  buffer->color_metadata = color_metadata;
+
+  // TZ Protected Buffer - L1
+  if (output_handle->flags & private_handle_t::PRIV_FLAGS_SECURE_BUFFER) {
+    buffer->flags.secure = 1;
+  }
+
+  // ToDo: Need to extend for non-RGB formats
+  buffer->planes[0].fd = output_handle->fd;
+  buffer->planes[0].offset = output_handle->offset;
+  buffer->planes[0].stride = UINT32(output_handle->width);
+
+  return HWC2::Error::None;
+}
 
-    GetMixerResolution(&active_width, &active_height);
-    buffer_allocator_->GetCustomWidthAndHeight(output_handle, &new_width, &new_height);
-    buffer_allocator_->GetAlignedWidthAndHeight(INT(new_width), INT(new_height),
-                                                output_handle_format, 0, &new_aligned_w,
-                                                &new_aligned_h);
-    buffer_allocator_->GetAlignedWidthAndHeight(INT(active_width), INT(active_height),
-                                                output_handle_format, 0, &active_aligned_w,
-                                                &active_aligned_h);
-    if (new_aligned_w != active_aligned_w  || new_aligned_h != active_aligned_h) {
-      int status = SetConfig(UINT32(new_width), UINT32(new_height));
-      if (status) {
-        DLOGE("SetConfig failed custom WxH %dx%d", new_width, new_height);
-        return HWC2::Error::BadParameter;
+void HWCDisplayVirtual::UpdateOutputFrameInfo() {
+  WritebackFrameInfo frame_info = {};
+  struct timespec now = {};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  frame_info.frame_number = output_frame_count_++;
+  frame_info.timestamp_ns = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+
+  LayerRect damage;
+  LayerRect full_frame(0.0f, 0.0f, FLOAT(output_buffer_->unaligned_width),
+                       FLOAT(output_buffer_->unaligned_height));
+  if (output_full_damage_ || layer_stack_.flags.geometry_changed) {
+    damage = full_frame;
+  } else {
+    // The client target is last in the stack, its content follows the layers composed into it.
+    for (size_t i = 0; i + 1 < layer_stack_.layers.size(); i++) {
+      Layer *layer = layer_stack_.layers.at(i);
+      if (layer->flags.updating) {
+        damage = Union(damage, layer->dst_rect);
       }
-      validated_ = false;
     }
+    damage = Intersection(damage, full_frame);
+  }
 
-    output_buffer_->width = UINT32(new_aligned_w);
-    output_buffer_->height = UINT32(new_aligned_h);
-    output_buffer_->unaligned_width = UINT32(new_width);
-    output_buffer_->unaligned_height = UINT32(new_height);
-    output_buffer_->flags.secure = 0;
-    output_buffer_->flags.video = 0;
-    output_buffer_->buffer_id = reinterpret_cast<uint64_t>(output_handle);
-    output_buffer_->format = new_sdm_format;
-    output_buffer_->color_metadata = color_metadata;
-    output_handle_ = output_handle;
-
-    // TZ Protected Buffer - L1
-    if (output_handle->flags & private_handle_t::PRIV_FLAGS_SECURE_BUFFER) {
-      output_buffer_->flags.secure = 1;
-    }
+  if (IsValid(damage)) {
+    frame_info.damage = {INT(damage.left), INT(damage.top), INT(damage.right),
+                         INT(damage.bottom)};
+  } else {
+    // Nothing was redrawn, the consumer may drop this frame.
+    frame_info.flags |= WB_FRAME_FLAG_UNCHANGED;
+  }
 
-    // ToDo: Need to extend for non-RGB formats
-    output_buffer_->planes[0].fd = output_handle->fd;
-    output_buffer_->planes[0].offset = output_handle->offset;
-    output_buffer_->planes[0].stride = UINT32(output_handle->width);
+  if (setMetaData(const_cast<private_handle_t *>(output_handle_), SET_WRITEBACK_FRAME_INFO,
+                  &frame_info) == 0) {
+    output_full_damage_ = false;
   }
+}
 
-  return HWC2::Error::None;
+bool HWCDisplayVirtual::IsReadyForAsyncPresent() {
+  return HWCDisplay::IsReadyForAsyncPresent() && (present_inputs_ & kPresentInputOutputBuffer);
 }
 
 void HWCDisplayVirtual::SetFrameDumpConfig(uint32_t count, uint32_t bit_mask_layer_type) {
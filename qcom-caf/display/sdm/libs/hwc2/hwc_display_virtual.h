@@ -32,6 +32,7 @@
 
 #include <qdMetaData.h>
 #include <gralloc_priv.h>
+#include <vector>
 #include "hwc_display.h"
 
 namespace sdm {
@@ -48,15 +49,35 @@ class HWCDisplayVirtual : public HWCDisplay {
   virtual HWC2::Error Present(int32_t *out_retire_fence);
   virtual void SetFrameDumpConfig(uint32_t count, uint32_t bit_mask_layer_type);
   HWC2::Error SetOutputBuffer(buffer_handle_t buf, int32_t release_fence);
+  virtual bool IsReadyForAsyncPresent();
 
  private:
+  // Output buffers are owned by the consumer's BufferQueue and cycle through a handful of
+  // slots. The parameters derived from each handle are kept so a returning buffer only needs
+  // its fence swapped.
+  static const uint32_t kOutputRingSize = 4;
+
+  struct OutputBufferSlot {
+    const private_handle_t *handle = nullptr;
+    uint64_t id = 0;
+    int fd = -1;
+    LayerBuffer buffer;
+  };
+
   HWCDisplayVirtual(CoreInterface *core_intf, HWCBufferAllocator *buffer_allocator,
                     HWCCallbacks *callbacks);
   int SetConfig(uint32_t width, uint32_t height);
+  void NegotiateOutputFormat(int32_t *format);
+  HWC2::Error SetupOutputBuffer(const private_handle_t *output_handle, LayerBuffer *buffer);
+  void UpdateOutputFrameInfo();
 
   bool dump_output_layer_ = false;
   LayerBuffer *output_buffer_ = NULL;
   const private_handle_t *output_handle_ = nullptr;
+  std::vector<OutputBufferSlot> output_ring_ = {};
+  uint32_t output_frame_count_ = 0;
+  // Set when the next output frame cannot be described relative to the previous one
+  bool output_full_damage_ = true;
 };
 
 }  // namespace sdm
@@ -0,0 +1,111 @@
+/*
+* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Host tool to turn frame dumps written by HWCFrameDumper back into raw buffers.
+// Usage: hwc_frame_dump_decoder <dump.raw.lz4>...
+// Each input is decoded next to itself with the .lz4 suffix removed.
+
+#include <lz4.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "hwc_frame_dumper.h"
+
+using sdm::FrameDumpHeader;
+
+static bool Decode(const char *in_path) {
+  FILE *in = fopen(in_path, "rb");
+  if (!in) {
+    fprintf(stderr, "%s: cannot open\n", in_path);
+    return false;
+  }
+
+  FrameDumpHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != sdm::kFrameDumpMagic ||
+      header.version != sdm::kFrameDumpVersion) {
+    fprintf(stderr, "%s: not a frame dump\n", in_path);
+    fclose(in);
+    return false;
+  }
+
+  std::vector<char> compressed(header.compressed_size);
+  std::vector<char> raw(header.raw_size);
+  size_t read = fread(compressed.data(), 1, compressed.size(), in);
+  fclose(in);
+
+  int size = LZ4_decompress_safe(compressed.data(), raw.data(), static_cast<int>(read),
+                                 static_cast<int>(raw.size()));
+  if (size < 0 || static_cast<uint32_t>(size) != header.raw_size) {
+    fprintf(stderr, "%s: corrupt data\n", in_path);
+    return false;
+  }
+
+  std::string out_path = in_path;
+  size_t suffix = out_path.rfind(".lz4");
+  if (suffix != std::string::npos && suffix + 4 == out_path.size()) {
+    out_path.erase(suffix);
+  } else {
+    out_path += ".raw";
+  }
+
+  FILE *out = fopen(out_path.c_str(), "wb");
+  if (!out || fwrite(raw.data(), raw.size(), 1, out) != 1) {
+    fprintf(stderr, "%s: cannot write\n", out_path.c_str());
+    if (out) {
+      fclose(out);
+    }
+    return false;
+  }
+  fclose(out);
+
+  char format_name[sizeof(header.format_name) + 1] = {};
+  memcpy(format_name, header.format_name, sizeof(header.format_name));
+  printf("%s: frame %u %s %ux%u stride %u format %s (%u)\n", out_path.c_str(), header.frame_index,
+         header.layer_index == sdm::kFrameDumpOutputLayer ? "output" : "input", header.width,
+         header.height, header.stride, format_name, header.format);
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <dump.raw.lz4>...\n", argv[0]);
+    return 1;
+  }
+
+  int failures = 0;
+  for (int i = 1; i < argc; i++) {
+    failures += Decode(argv[i]) ? 0 : 1;
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+/*
+* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <lz4.h>
+#include <stdio.h>
+#include <string.h>
+#include <sync/sync.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+
+#include "hwc_frame_dumper.h"
+
+#define __CLASS__ "HWCFrameDumper"
+
+namespace sdm {
+
+// sw_sync ABI, the kernel does not export a header for it.
+struct SwSyncCreateFenceData {
+  uint32_t value;
+  char name[32];
+  int32_t fence;
+};
+
+#define SW_SYNC_IOC_MAGIC 'W'
+#define SW_SYNC_IOC_CREATE_FENCE _IOWR(SW_SYNC_IOC_MAGIC, 0, struct SwSyncCreateFenceData)
+#define SW_SYNC_IOC_INC _IOW(SW_SYNC_IOC_MAGIC, 1, uint32_t)
+
+HWCFrameDumper *HWCFrameDumper::GetInstance() {
+  static HWCFrameDumper frame_dumper;
+
+  return &frame_dumper;
+}
+
+HWCFrameDumper::HWCFrameDumper() {
+  timeline_fd_ = open("/sys/kernel/debug/sync/sw_sync", O_RDWR | O_CLOEXEC);
+  if (timeline_fd_ < 0) {
+    timeline_fd_ = open("/dev/sw_sync", O_RDWR | O_CLOEXEC);
+  }
+  if (timeline_fd_ < 0) {
+    DLOGW("No sw_sync timeline, errno = %d, desc = %s. Buffers are copied on the caller thread",
+          errno, strerror(errno));
+  }
+
+  worker_ = std::thread(&HWCFrameDumper::WorkerThread, this);
+}
+
+HWCFrameDumper::~HWCFrameDumper() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  cv_.notify_one();
+  worker_.join();
+
+  if (timeline_fd_ >= 0) {
+    close(timeline_fd_);
+  }
+}
+
+int HWCFrameDumper::Queue(const std::string &dir_path, const std::string &file_name,
+                          int buffer_fd, uint32_t offset, int fence,
+                          const FrameDumpHeader &header) {
+  DumpRequest request;
+  request.dir_path = dir_path;
+  request.file_name = file_name;
+  request.offset = offset;
+  request.header = header;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (pending_.size() >= kMaxPendingDumps) {
+    dropped_++;
+    DLOGW("Frame dump queue full, dropping %s (%u dropped)", file_name.c_str(), dropped_);
+    return -1;
+  }
+
+  if (timeline_fd_ < 0) {
+    // Nothing to hold the buffer with, it can only be copied while the caller still owns it.
+    lock.unlock();
+    if (!Snapshot(buffer_fd, offset, fence, &request)) {
+      return -1;
+    }
+    lock.lock();
+    pending_.push_back(std::move(request));
+    cv_.notify_one();
+    return -1;
+  }
+
+  request.buffer_fd = dup(buffer_fd);
+  request.fence = (fence >= 0) ? dup(fence) : -1;
+  if (request.buffer_fd < 0 || (fence >= 0 && request.fence < 0)) {
+    DLOGW("dup failed errno = %d, desc = %s", errno, strerror(errno));
+    if (request.buffer_fd >= 0) {
+      close(request.buffer_fd);
+    }
+    if (request.fence >= 0) {
+      close(request.fence);
+    }
+    return -1;
+  }
+
+  // The worker signals points in queue order, one per request.
+  SwSyncCreateFenceData data = {};
+  data.value = timeline_value_ + 1;
+  snprintf(data.name, sizeof(data.name), "frame_dump");
+  if (ioctl(timeline_fd_, SW_SYNC_IOC_CREATE_FENCE, &data) < 0) {
+    DLOGW("sw_sync fence creation failed errno = %d, desc = %s", errno, strerror(errno));
+    close(request.buffer_fd);
+    if (request.fence >= 0) {
+      close(request.fence);
+    }
+    return -1;
+  }
+  timeline_value_ = data.value;
+
+  pending_.push_back(std::move(request));
+  cv_.notify_one();
+
+  return data.fence;
+}
+
+void HWCFrameDumper::MergeDoneFence(int done_fence, int *fence) {
+  if (done_fence < 0) {
+    return;
+  }
+
+  if (*fence < 0) {
+    *fence = done_fence;
+    return;
+  }
+
+  int merged = sync_merge("frame_dump", *fence, done_fence);
+  if (merged < 0) {
+    // The owner would otherwise reuse the buffer while it is being copied.
+    DLOGW("sync_merge failed errno = %d, desc = %s", errno, strerror(errno));
+    sync_wait(done_fence, 1000);
+    close(done_fence);
+    return;
+  }
+
+  close(*fence);
+  close(done_fence);
+  *fence = merged;
+}
+
+bool HWCFrameDumper::Snapshot(int buffer_fd, uint32_t offset, int fence, DumpRequest *request) {
+  if (fence >= 0 && sync_wait(fence, 1000) < 0) {
+    DLOGW("sync_wait error errno = %d, desc = %s", errno, strerror(errno));
+    return false;
+  }
+
+  uint32_t raw_size = request->header.raw_size;
+  size_t map_size = raw_size + offset;
+  void *base = mmap(NULL, map_size, PROT_READ, MAP_SHARED, buffer_fd, 0);
+  if (base == MAP_FAILED) {
+    DLOGW("mmap failed errno = %d, desc = %s", errno, strerror(errno));
+    return false;
+  }
+
+  request->data.resize(raw_size);
+  memcpy(request->data.data(), reinterpret_cast<char *>(base) + offset, raw_size);
+  munmap(base, map_size);
+
+  return true;
+}
+
+uint32_t HWCFrameDumper::GetDroppedCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return dropped_;
+}
+
+void HWCFrameDumper::WorkerThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    cv_.wait(lock, [this] { return exit_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      break;
+    }
+
+    DumpRequest request = std::move(pending_.front());
+    pending_.pop_front();
+
+    lock.unlock();
+    if (request.buffer_fd >= 0) {
+      Copy(&request);
+    }
+    if (!request.data.empty()) {
+      Write(&request);
+    }
+    lock.lock();
+  }
+}
+
+void HWCFrameDumper::Copy(DumpRequest *request) {
+  if (!Snapshot(request->buffer_fd, request->offset, request->fence, request)) {
+    request->data.clear();
+  }
+
+  close(request->buffer_fd);
+  request->buffer_fd = -1;
+  if (request->fence >= 0) {
+    close(request->fence);
+    request->fence = -1;
+  }
+
+  // Hands the buffer back to its owner whether or not the copy succeeded.
+  uint32_t increment = 1;
+  if (ioctl(timeline_fd_, SW_SYNC_IOC_INC, &increment) < 0) {
+    DLOGE("sw_sync timeline increment failed errno = %d, desc = %s", errno, strerror(errno));
+  }
+}
+
+void HWCFrameDumper::Write(DumpRequest *request) {
+  FrameDumpHeader &header = request->header;
+  const char *dir_path = request->dir_path.c_str();
+
+  if (mkdir(dir_path, 0777) != 0 && errno != EEXIST) {
+    DLOGW("Failed to create %s directory errno = %d, desc = %s", dir_path, errno, strerror(errno));
+    return;
+  }
+
+  // if directory exists already, need to explicitly change the permission.
+  if (errno == EEXIST && chmod(dir_path, 0777) != 0) {
+    DLOGW("Failed to change permissions on %s directory", dir_path);
+    return;
+  }
+
+  compressed_.resize(size_t(LZ4_compressBound(INT(header.raw_size))));
+  int compressed_size = LZ4_compress_default(request->data.data(), compressed_.data(),
+                                             INT(header.raw_size), INT(compressed_.size()));
+
+  if (compressed_size <= 0) {
+    DLOGW("Failed to compress %s", request->file_name.c_str());
+    return;
+  }
+  header.compressed_size = UINT32(compressed_size);
+
+  std::string dump_file_name = request->dir_path + "/" + request->file_name;
+  size_t result = 0;
+  FILE *fp = fopen(dump_file_name.c_str(), "w+");
+  if (fp) {
+    result = fwrite(&header, sizeof(header), 1, fp);
+    if (result) {
+      result = fwrite(compressed_.data(), header.compressed_size, 1, fp);
+    }
+    fclose(fp);
+  }
+
+  DLOGI("Frame Dump %s: is %s (%u -> %u bytes)", dump_file_name.c_str(),
+        result ? "Successful" : "Failed", header.raw_size, header.compressed_size);
+}
+
+}  // namespace sdm
@@ -0,0 +1,114 @@
+/*
+* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_FRAME_DUMPER_H__
+#define __HWC_FRAME_DUMPER_H__
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sdm {
+
+// On-disk layout of a dumped frame: this header followed by compressed_size bytes of LZ4 block
+// data which decompress to raw_size bytes of the buffer as it was laid out in memory.
+const uint32_t kFrameDumpMagic = 0x5a444648;  // "HFDZ"
+const uint32_t kFrameDumpVersion = 1;
+const uint32_t kFrameDumpOutputLayer = UINT32_MAX;
+
+struct FrameDumpHeader {
+  uint32_t magic = kFrameDumpMagic;
+  uint32_t version = kFrameDumpVersion;
+  uint32_t width = 0;                        // Aligned width in pixels
+  uint32_t height = 0;                       // Aligned height in pixels
+  uint32_t stride = 0;                       // Stride in bytes, 0 if unknown
+  uint32_t format = 0;                       // HAL format for inputs, SDM format for outputs
+  uint32_t frame_index = 0;
+  uint32_t layer_index = kFrameDumpOutputLayer;
+  uint32_t raw_size = 0;
+  uint32_t compressed_size = 0;
+  char format_name[32] = {};
+};
+
+// Writes frame dumps off the composition thread. Queue() only duplicates the buffer fd and its
+// fence, the worker waits for the fence, copies the buffer, compresses the copy and writes it out.
+// Client buffers and the output buffers are reused once their release fence signals, so Queue()
+// returns a fence which signals once the copy is done; callers fold it into the fence that hands
+// the buffer back with MergeDoneFence(). Requests are dropped rather than blocking when the
+// queue is full.
+class HWCFrameDumper {
+ public:
+  static HWCFrameDumper *GetInstance();
+  // Returns the copy done fence, owned by the caller, or -1 if the request was dropped or the
+  // buffer was already copied.
+  int Queue(const std::string &dir_path, const std::string &file_name, int buffer_fd,
+            uint32_t offset, int fence, const FrameDumpHeader &header);
+  // Merges done_fence into *fence and takes ownership of done_fence.
+  static void MergeDoneFence(int done_fence, int *fence);
+  uint32_t GetDroppedCount();
+
+ private:
+  static const uint32_t kMaxPendingDumps = 8;
+
+  struct DumpRequest {
+    std::string dir_path;
+    std::string file_name;
+    int buffer_fd = -1;      // Owned duplicate, -1 once data holds the copy
+    uint32_t offset = 0;
+    int fence = -1;          // Owned duplicate of the buffer's fence
+    std::vector<char> data;  // Snapshot of header.raw_size bytes of the buffer
+    FrameDumpHeader header = {};
+  };
+
+  HWCFrameDumper();
+  ~HWCFrameDumper();
+  static bool Snapshot(int buffer_fd, uint32_t offset, int fence, DumpRequest *request);
+  void WorkerThread();
+  void Copy(DumpRequest *request);
+  void Write(DumpRequest *request);
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<DumpRequest> pending_;
+  std::vector<char> compressed_;   // Reused by the worker across frames
+  std::thread worker_;
+  int timeline_fd_ = -1;           // sw_sync timeline, advanced once per copied request
+  uint32_t timeline_value_ = 0;    // Last point handed out by Queue()
+  uint32_t dropped_ = 0;
+  bool exit_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_FRAME_DUMPER_H__
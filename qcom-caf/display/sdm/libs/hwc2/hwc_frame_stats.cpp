@@ -0,0 +1,232 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sync/sync.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+
+#include <utils/constants.h>
+
+#include "hwc_frame_stats.h"
+
+namespace sdm {
+
+uint32_t FrameTimeHistogram::GetBucket(uint64_t value_us) {
+  if (value_us < kSubBuckets) {
+    return UINT32(value_us);
+  }
+
+  uint32_t exponent = UINT32(63 - __builtin_clzll(value_us));
+  if (exponent > kMaxExponent) {
+    return kNumBuckets - 1;
+  }
+
+  uint32_t sub_bucket = UINT32(value_us >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+  return (exponent - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+}
+
+uint64_t FrameTimeHistogram::GetBucketStart(uint32_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+
+  uint32_t exponent = bucket / kSubBuckets + kSubBucketBits - 1;
+  uint64_t sub_bucket = bucket % kSubBuckets;
+  return (UINT64(1) << exponent) + (sub_bucket << (exponent - kSubBucketBits));
+}
+
+void FrameTimeHistogram::Record(uint64_t value_us) {
+  buckets_[GetBucket(value_us)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(value_us, std::memory_order_relaxed);
+  // Records can race, only ever replace the max with a larger value
+  uint64_t max_us = max_us_.load(std::memory_order_relaxed);
+  while (value_us > max_us &&
+         !max_us_.compare_exchange_weak(max_us, value_us, std::memory_order_relaxed)) {
+  }
+}
+
+void FrameTimeHistogram::Reset() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_us_.store(0, std::memory_order_relaxed);
+  max_us_.store(0, std::memory_order_relaxed);
+}
+
+// Reports the upper bound of the bucket holding the percentile, clamped to the largest sample.
+uint64_t FrameTimeHistogram::GetPercentile(uint64_t count, uint32_t percent) {
+  uint64_t target = (count * percent + 99) / 100;
+  uint64_t max_us = max_us_.load(std::memory_order_relaxed);
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < kNumBuckets - 1; i++) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      return std::min(GetBucketStart(i + 1) - 1, max_us);
+    }
+  }
+
+  return max_us;
+}
+
+void FrameTimeHistogram::Dump(const char *name, std::ostringstream *os) {
+  uint64_t count = count_.load(std::memory_order_relaxed);
+  *os << std::setw(18) << name << ": samples " << count;
+  if (!count) {
+    *os << std::endl;
+    return;
+  }
+
+  *os << " avg " << sum_us_.load(std::memory_order_relaxed) / count << " us";
+  *os << " p50 " << GetPercentile(count, 50);
+  *os << " p90 " << GetPercentile(count, 90);
+  *os << " p99 " << GetPercentile(count, 99);
+  *os << " max " << max_us_.load(std::memory_order_relaxed) << std::endl;
+}
+
+HWCFrameStats::~HWCFrameStats() {
+  while (pending_count_) {
+    DropPendingFrame();
+  }
+}
+
+void HWCFrameStats::RecordValidate(int64_t start_ns, int64_t end_ns) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  validate_time_.Record(UINT64(end_ns - start_ns) / 1000);
+}
+
+void HWCFrameStats::RecordPresent(int64_t start_ns, int64_t end_ns, int retire_fence,
+                                  int64_t retire_deadline_ns) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  frames_.fetch_add(1, std::memory_order_relaxed);
+  present_time_.Record(UINT64(end_ns - start_ns) / 1000);
+  int64_t last_present_ns = last_present_ns_.exchange(start_ns, std::memory_order_relaxed);
+  if (last_present_ns) {
+    present_interval_.Record(UINT64(start_ns - last_present_ns) / 1000);
+  }
+
+  // Pending fences are only looked at on sampled frames, by then they have long signalled.
+  if (frames_to_sample_) {
+    frames_to_sample_--;
+    return;
+  }
+  frames_to_sample_ = kSampleInterval - 1;
+
+  CheckPendingFrames();
+  if (retire_fence < 0) {
+    return;
+  }
+
+  if (pending_count_ == kMaxPendingFrames) {
+    DropPendingFrame();
+  }
+  PendingFrame &frame = pending_frames_[(pending_head_ + pending_count_) % kMaxPendingFrames];
+  frame.fence = dup(retire_fence);
+  frame.present_end_ns = end_ns;
+  frame.retire_deadline_ns = retire_deadline_ns;
+  if (frame.fence >= 0) {
+    pending_count_++;
+  }
+}
+
+void HWCFrameStats::CheckPendingFrames() {
+  // Retire fences signal in present order, stop at the first one still pending.
+  while (pending_count_) {
+    PendingFrame &frame = pending_frames_[pending_head_];
+    struct sync_file_info *info = sync_file_info(frame.fence);
+    if (info && info->status == 0) {
+      sync_file_info_free(info);
+      return;
+    }
+
+    if (info && info->status == 1) {
+      sampled_frames_.fetch_add(1, std::memory_order_relaxed);
+      uint64_t signal_ns = 0;
+      struct sync_fence_info *fences = sync_get_fence_info(info);
+      for (uint32_t i = 0; i < info->num_fences; i++) {
+        signal_ns = std::max(signal_ns, UINT64(fences[i].timestamp_ns));
+      }
+      if (signal_ns > UINT64(frame.present_end_ns)) {
+        fence_latency_.Record((signal_ns - UINT64(frame.present_end_ns)) / 1000);
+      }
+      if (frame.retire_deadline_ns && signal_ns > UINT64(frame.retire_deadline_ns)) {
+        janks_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    if (info) {
+      sync_file_info_free(info);
+    }
+    DropPendingFrame();
+  }
+}
+
+void HWCFrameStats::DropPendingFrame() {
+  PendingFrame &frame = pending_frames_[pending_head_];
+  close(frame.fence);
+  frame.fence = -1;
+  pending_head_ = (pending_head_ + 1) % kMaxPendingFrames;
+  pending_count_--;
+}
+
+void HWCFrameStats::Reset() {
+  validate_time_.Reset();
+  present_time_.Reset();
+  present_interval_.Reset();
+  fence_latency_.Reset();
+  frames_.store(0, std::memory_order_relaxed);
+  sampled_frames_.store(0, std::memory_order_relaxed);
+  janks_.store(0, std::memory_order_relaxed);
+  last_present_ns_.store(0, std::memory_order_relaxed);
+}
+
+void HWCFrameStats::Dump(std::ostringstream *os) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  *os << "frames: " << frames_.load(std::memory_order_relaxed);
+  *os << " janks (missed vsync): " << janks_.load(std::memory_order_relaxed) << " of ";
+  *os << sampled_frames_.load(std::memory_order_relaxed) << " sampled frames" << std::endl;
+  validate_time_.Dump("validate", os);
+  present_time_.Dump("present", os);
+  present_interval_.Dump("present interval", os);
+  fence_latency_.Dump("retire latency", os);
+}
+
+}  // namespace sdm
@@ -0,0 +1,116 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_FRAME_STATS_H__
+#define __HWC_FRAME_STATS_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <sstream>
+
+namespace sdm {
+
+// Log-linear histogram of durations in microseconds: values below 8 us have a bucket each, above
+// that every power of two is split into 8 linear buckets, so any value is binned within 12.5%.
+// Recording is a few relaxed atomic increments and never blocks a concurrent dump.
+class FrameTimeHistogram {
+ public:
+  void Record(uint64_t value_us);
+  void Reset();
+  void Dump(const char *name, std::ostringstream *os);
+
+ private:
+  static const uint32_t kSubBucketBits = 3;
+  static const uint32_t kSubBuckets = 1 << kSubBucketBits;
+  // The first row holds values below kSubBuckets, then one row per exponent up to kMaxExponent.
+  // Values from 2^(kMaxExponent + 1) us (~33 s) are clamped into the last bucket.
+  static const uint32_t kMaxExponent = 24;
+  static const uint32_t kNumBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+  static uint32_t GetBucket(uint64_t value_us);
+  static uint64_t GetBucketStart(uint32_t bucket);
+  uint64_t GetPercentile(uint64_t count, uint32_t percent);
+
+  std::atomic<uint32_t> buckets_[kNumBuckets] = {};
+  std::atomic<uint64_t> count_ {0};
+  std::atomic<uint64_t> sum_us_ {0};
+  std::atomic<uint64_t> max_us_ {0};
+};
+
+// Per display frame timing recorder. Records the time spent in validate and present, the
+// interval between presents, and the latency from the end of present to the retire fence
+// signalling. Frames whose retire fence signals after the deadline given at present are counted
+// as janks. Reading a fence signal time costs a dup and two ioctls, so the retire latency and
+// janks are sampled on one frame in kSampleInterval. All timestamps are on the monotonic clock, in
+// nanoseconds. Recording runs on the composer thread, dumps and resets come from binder threads.
+class HWCFrameStats {
+ public:
+  ~HWCFrameStats();
+  void SetEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+  bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+  void RecordValidate(int64_t start_ns, int64_t end_ns);
+  // Does not take ownership of retire_fence. retire_deadline_ns is 0 when no deadline is known.
+  void RecordPresent(int64_t start_ns, int64_t end_ns, int retire_fence,
+                     int64_t retire_deadline_ns);
+  void Reset();
+  void Dump(std::ostringstream *os);
+
+ private:
+  // A presented frame whose retire fence is read on a later frame, once it had time to signal
+  struct PendingFrame {
+    int fence = -1;  // Dup of the retire fence
+    int64_t present_end_ns = 0;
+    int64_t retire_deadline_ns = 0;
+  };
+  // Retire fences normally signal within two frames, older ones are dropped unread.
+  static const uint32_t kMaxPendingFrames = 4;
+  static const uint32_t kSampleInterval = 16;
+
+  void CheckPendingFrames();
+  void DropPendingFrame();
+
+  std::atomic<bool> enabled_ {false};
+  FrameTimeHistogram validate_time_;
+  FrameTimeHistogram present_time_;
+  FrameTimeHistogram present_interval_;
+  FrameTimeHistogram fence_latency_;
+  std::atomic<uint64_t> frames_ {0};
+  std::atomic<uint64_t> sampled_frames_ {0};  // Frames whose retire fence time was read
+  std::atomic<uint64_t> janks_ {0};
+  std::atomic<int64_t> last_present_ns_ {0};
+  uint32_t frames_to_sample_ = 0;  // Presents left before the next sampled one
+  PendingFrame pending_frames_[kMaxPendingFrames];
+  uint32_t pending_head_ = 0;
+  uint32_t pending_count_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_FRAME_STATS_H__
@@ -0,0 +1,452 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gralloc_priv.h>
+#include <unistd.h>
+
+#include <TonemapFactory.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/formats.h>
+#include <utils/rect.h>
+#include <utils/utils.h>
+#include <algorithm>
+
+#include "hwc_debugger.h"
+#include "hwc_layer_cache.h"
+
+#define __CLASS__ "HWCLayerCache"
+
+namespace sdm {
+
+bool HWCLayerCache::CachedLayer::operator==(const CachedLayer &other) const {
+  return (layer == other.layer) && (buffer_id == other.buffer_id) &&
+         (src_rect == other.src_rect) && (dst_rect == other.dst_rect) &&
+         (blending == other.blending) && (plane_alpha == other.plane_alpha);
+}
+
+HWCLayerCache::HWCLayerCache(HWCBufferAllocator *buffer_allocator)
+  : layer_cache_task_(*this, WorkerPool::kLaneGL), buffer_allocator_(buffer_allocator) {
+}
+
+HWCLayerCache::~HWCLayerCache() {
+  WaitForCompose();
+  layer_cache_task_.PerformTask(LayerCacheTaskCode::kCodeDestroy, nullptr);
+  CloseFd(&cache_layer_.input_buffer.acquire_fence_fd);
+  CloseFd(&cache_layer_.input_buffer.release_fence_fd);
+  FreeCacheBuffers();
+}
+
+void HWCLayerCache::OnTask(const LayerCacheTaskCode &task_code,
+                           SyncTask<LayerCacheTaskCode>::TaskContext *task_context) {
+  switch (task_code) {
+    case LayerCacheTaskCode::kCodeGetInstance: {
+        compositor_ = TonemapperFactory_GetCompositor(false /* isSecure */);
+      }
+      break;
+
+    case LayerCacheTaskCode::kCodeCompose: {
+        LayerCacheComposeContext *ctx = static_cast<LayerCacheComposeContext *>(task_context);
+        compositor_->begin(ctx->dst_hnd, ctx->dst_fence_fd);
+        for (auto &draw : ctx->draws) {
+          compositor_->draw(draw.src_hnd, draw.src_fence_fd, draw.src_crop, draw.dst_rect,
+                            draw.alpha, draw.blending);
+        }
+        ctx->fence_fd = compositor_->end();
+      }
+      break;
+
+    case LayerCacheTaskCode::kCodeDestroy: {
+        delete compositor_;
+        compositor_ = nullptr;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+bool HWCLayerCache::IsCacheable(const Layer *layer) {
+  const LayerBuffer &input_buffer = layer->input_buffer;
+  const LayerTransform &transform = layer->transform;
+
+  // The compositor samples RGB sources as sRGB and draws them upright, anything else is left to
+  // the strategy.
+  return !layer->flags.updating && !layer->flags.skip && !layer->flags.solid_fill &&
+         !layer->flags.cursor && !layer->flags.single_buffer && input_buffer.buffer_id &&
+         !input_buffer.flags.secure && !input_buffer.flags.secure_display &&
+         !input_buffer.flags.hdr && (input_buffer.format < kFormatYCbCr420Planar) &&
+         !Is10BitFormat(input_buffer.format) &&
+         (input_buffer.color_metadata.colorPrimaries == ColorPrimaries_BT709_5) &&
+         (transform.rotation == 0.0f) && !transform.flip_horizontal &&
+         !transform.flip_vertical;
+}
+
+void HWCLayerCache::HandleLayerStack(LayerStack *layer_stack) {
+  bool was_active = active_;
+  active_ = ReplaceRun(layer_stack);
+
+  // The strategy of the previous frame does not hold once the cached layer comes or goes, or
+  // stands for a different run.
+  if ((active_ != was_active) || compose_pending_) {
+    layer_stack->flags.geometry_changed = 1U;
+  }
+}
+
+void HWCLayerCache::RestoreLayerStack(LayerStack *layer_stack) {
+  std::vector<Layer *> &layers = layer_stack->layers;
+  auto it = std::find(layers.begin(), layers.end(), &cache_layer_);
+  if (it != layers.end()) {
+    it = layers.erase(it);
+    for (auto &cached : run_) {
+      it = layers.insert(it, cached.layer) + 1;
+    }
+  }
+  if (active_) {
+    layer_stack->flags.geometry_changed = 1U;
+  }
+
+  active_ = false;
+  Invalidate();
+  CloseFd(&cache_layer_.input_buffer.acquire_fence_fd);
+}
+
+bool HWCLayerCache::ReplaceRun(LayerStack *layer_stack) {
+  std::vector<Layer *> &layers = layer_stack->layers;
+  CollectCompose();
+
+  // The last layer is the client target, which is never cached.
+  candidate_.clear();
+  for (size_t i = 0; (i + 1) < layers.size() && IsCacheable(layers.at(i)); i++) {
+    Layer *layer = layers.at(i);
+    CachedLayer cached;
+    cached.layer = layer;
+    cached.buffer_id = layer->input_buffer.buffer_id;
+    cached.src_rect = layer->src_rect;
+    cached.dst_rect = layer->dst_rect;
+    cached.blending = layer->blending;
+    cached.plane_alpha = layer->plane_alpha;
+    candidate_.push_back(cached);
+  }
+
+  if (candidate_.size() < kMinCachedLayers) {
+    Invalidate();
+    return false;
+  }
+
+  if (candidate_ != run_) {
+    Invalidate();
+    run_.swap(candidate_);
+  }
+
+  // Wait for the run to settle before paying for a composition, and keep off it once the
+  // strategy has shown it would not place the cached layer on a pipe.
+  if (stable_frames_ < kMinStableFrames) {
+    stable_frames_++;
+    return false;
+  }
+  if (rejected_) {
+    return false;
+  }
+
+  if (!valid_ && !Compose()) {
+    rejected_ = true;
+    return false;
+  }
+
+  SetupCacheLayer();
+  layers.erase(layers.begin(), layers.begin() + INT(run_.size()));
+  layers.insert(layers.begin(), &cache_layer_);
+  return true;
+}
+
+bool HWCLayerCache::Compose() {
+  LayerRect cache_rect = {};
+  for (auto &cached : run_) {
+    cache_rect = Union(cache_rect, cached.dst_rect);
+  }
+
+  uint32_t width = UINT32(cache_rect.right - cache_rect.left);
+  uint32_t height = UINT32(cache_rect.bottom - cache_rect.top);
+  if (!width || !height) {
+    return false;
+  }
+
+  if ((buffer_info_[0].buffer_config.width != width) ||
+      (buffer_info_[0].buffer_config.height != height)) {
+    FreeCacheBuffers();
+    if (AllocateCacheBuffers(width, height) != kErrorNone) {
+      DLOGE("Failed to allocate %dx%d layer cache buffers", width, height);
+      return false;
+    }
+  }
+
+  if (!compositor_) {
+    layer_cache_task_.PerformTask(LayerCacheTaskCode::kCodeGetInstance, nullptr);
+    if (!compositor_) {
+      DLOGE("Failed to create the layer cache compositor");
+      return false;
+    }
+  }
+
+  // Compose into the buffer which is not on screen, once the display has let go of it.
+  current_buffer_index_ = (current_buffer_index_ + 1) % kNumCacheBuffers;
+  cache_rect_ = cache_rect;
+
+  LayerCacheComposeContext &ctx = compose_ctx_;
+  ctx.dst_hnd = reinterpret_cast<const void *>(buffer_info_[current_buffer_index_].private_data);
+  ctx.dst_fence_fd = release_fence_fd_[current_buffer_index_];
+  release_fence_fd_[current_buffer_index_] = -1;
+  ctx.draws.resize(run_.size());
+  for (size_t i = 0; i < run_.size(); i++) {
+    const CachedLayer &cached = run_.at(i);
+    const LayerBuffer &input_buffer = cached.layer->input_buffer;
+    LayerCacheComposeContext::Draw &draw = ctx.draws.at(i);
+    draw.src_hnd = reinterpret_cast<const void *>(input_buffer.buffer_id);
+    draw.src_fence_fd = (input_buffer.acquire_fence_fd >= 0) ?
+                        dup(input_buffer.acquire_fence_fd) : -1;
+    draw.src_crop[0] = cached.src_rect.left;
+    draw.src_crop[1] = cached.src_rect.top;
+    draw.src_crop[2] = cached.src_rect.right;
+    draw.src_crop[3] = cached.src_rect.bottom;
+    draw.dst_rect[0] = INT(cached.dst_rect.left - cache_rect_.left);
+    draw.dst_rect[1] = INT(cached.dst_rect.top - cache_rect_.top);
+    draw.dst_rect[2] = INT(cached.dst_rect.right - cache_rect_.left);
+    draw.dst_rect[3] = INT(cached.dst_rect.bottom - cache_rect_.top);
+    draw.alpha = FLOAT(cached.plane_alpha) / 255.0f;
+    draw.blending = COMPOSITOR_BLEND_PREMULTIPLIED;
+    if (cached.blending == kBlendingOpaque) {
+      draw.blending = COMPOSITOR_BLEND_NONE;
+    } else if (cached.blending == kBlendingCoverage) {
+      draw.blending = COMPOSITOR_BLEND_COVERAGE;
+    }
+  }
+
+  // The GL worker composes while the strategy runs, the fence is collected once it is needed.
+  CloseFd(&compose_fence_fd_);
+  ctx.fence_fd = -1;
+  layer_cache_task_.PerformTaskAsync(LayerCacheTaskCode::kCodeCompose, &ctx);
+  compose_pending_ = true;
+  valid_ = true;
+  composed_frames_++;
+  DLOGI_IF(kTagClient, "Composed %zu static layers into a %dx%d cache", run_.size(), width,
+           height);
+
+  return true;
+}
+
+void HWCLayerCache::SetupCacheLayer() {
+  const BufferInfo &buffer_info = buffer_info_[current_buffer_index_];
+  LayerBuffer &buffer = cache_layer_.input_buffer;
+  uint32_t width = buffer_info.buffer_config.width;
+  uint32_t height = buffer_info.buffer_config.height;
+  // The cached layer only changes on the frame it is composed on. Its acquire fence is set when
+  // the compose is collected.
+  bool updating = compose_pending_ || (compose_fence_fd_ >= 0);
+
+  CloseFd(&buffer.acquire_fence_fd);
+  buffer.acquire_fence_fd = (compose_fence_fd_ >= 0) ? dup(compose_fence_fd_) : -1;
+  buffer.release_fence_fd = -1;
+  buffer.width = buffer_info.alloc_buffer_info.aligned_width;
+  buffer.height = buffer_info.alloc_buffer_info.aligned_height;
+  buffer.unaligned_width = width;
+  buffer.unaligned_height = height;
+  buffer.size = buffer_info.alloc_buffer_info.size;
+  buffer.format = buffer_info.buffer_config.format;
+  buffer.planes[0].fd = buffer_info.alloc_buffer_info.fd;
+  buffer.planes[0].offset = 0;
+  buffer.planes[0].stride = buffer_info.alloc_buffer_info.stride;
+  buffer.buffer_id = reinterpret_cast<uint64_t>(buffer_info.private_data);
+
+  cache_layer_.composition = kCompositionGPU;
+  cache_layer_.src_rect = LayerRect(0.0f, 0.0f, FLOAT(width), FLOAT(height));
+  cache_layer_.dst_rect = cache_rect_;
+  cache_layer_.visible_regions.assign(1, cache_rect_);
+  cache_layer_.dirty_regions.clear();
+  if (!updating) {
+    // A single empty rect tells SDM that the layer did not change.
+    cache_layer_.dirty_regions.push_back(LayerRect());
+  }
+  cache_layer_.blending = kBlendingPremultiplied;
+  cache_layer_.plane_alpha = 0xff;
+  cache_layer_.frame_rate = run_.front().layer->frame_rate;
+  cache_layer_.flags = {};
+  cache_layer_.flags.updating = updating;
+  cache_layer_.request = {};
+}
+
+void HWCLayerCache::UpdateCompositions() {
+  CollectCompose();
+
+  if (!active_) {
+    // The run is still settling and placed by the strategy on its own
+    run_on_gpu_ = std::any_of(run_.begin(), run_.end(), [](const CachedLayer &cached) {
+      return cached.layer->composition == kCompositionGPU;
+    });
+    return;
+  }
+
+  LayerComposition composition = cache_layer_.composition;
+  if (composition == kCompositionGPU) {
+    // SurfaceFlinger composes the original layers this frame, stop caching the run.
+    DLOGI_IF(kTagClient, "Cached layer marked for GPU composition");
+    rejected_ = true;
+  }
+
+  for (auto &cached : run_) {
+    cached.layer->composition = composition;
+  }
+}
+
+void HWCLayerCache::PostCommit(bool flush) {
+  LayerBuffer &buffer = cache_layer_.input_buffer;
+  CollectCompose();
+
+  if (!active_) {
+    WaitForCompose();
+    return;
+  }
+
+  CloseFd(&buffer.acquire_fence_fd);
+  if (buffer.release_fence_fd >= 0) {
+    CloseFd(&release_fence_fd_[current_buffer_index_]);
+    release_fence_fd_[current_buffer_index_] = buffer.release_fence_fd;
+    buffer.release_fence_fd = -1;
+  }
+
+  if (compose_fence_fd_ < 0) {
+    if (!flush && run_on_gpu_ && (cache_layer_.composition != kCompositionGPU)) {
+      reused_frames_++;
+    }
+    return;
+  }
+
+  // The static layers were read by the compositor, so hand its fence back as their release
+  // fence. Layers that are released with -1 need the composition to have completed instead.
+  if (flush || (cache_layer_.composition == kCompositionGPU)) {
+    WaitForCompose();
+    return;
+  }
+
+  for (auto &cached : run_) {
+    cached.layer->input_buffer.release_fence_fd = dup(compose_fence_fd_);
+  }
+  CloseFd(&compose_fence_fd_);
+}
+
+void HWCLayerCache::CollectCompose() {
+  if (!compose_pending_) {
+    return;
+  }
+
+  DTRACE_BEGIN("GPU_LAYER_CACHE");
+  layer_cache_task_.WaitForTask();
+  DTRACE_END();
+  compose_pending_ = false;
+
+  CloseFd(&compose_fence_fd_);
+  compose_fence_fd_ = compose_ctx_.fence_fd;
+  compose_ctx_.fence_fd = -1;
+  if (active_ && (compose_fence_fd_ >= 0)) {
+    LayerBuffer &buffer = cache_layer_.input_buffer;
+    CloseFd(&buffer.acquire_fence_fd);
+    buffer.acquire_fence_fd = dup(compose_fence_fd_);
+  }
+}
+
+void HWCLayerCache::WaitForCompose() {
+  CollectCompose();
+  if (compose_fence_fd_ >= 0) {
+    buffer_sync_handler_.SyncWait(compose_fence_fd_);
+    CloseFd(&compose_fence_fd_);
+  }
+}
+
+void HWCLayerCache::Invalidate() {
+  CollectCompose();
+  run_.clear();
+  stable_frames_ = 0;
+  valid_ = false;
+  rejected_ = false;
+  run_on_gpu_ = false;
+}
+
+DisplayError HWCLayerCache::AllocateCacheBuffers(uint32_t width, uint32_t height) {
+  for (uint8_t i = 0; i < kNumCacheBuffers; i++) {
+    BufferInfo &buffer_info = buffer_info_[i];
+    buffer_info.buffer_config.width = width;
+    buffer_info.buffer_config.height = height;
+    buffer_info.buffer_config.format = kFormatRGBA8888;
+    buffer_info.buffer_config.buffer_count = 1;
+    buffer_info.buffer_config.gfx_client = true;
+    DisplayError error = buffer_allocator_->AllocateBuffer(&buffer_info);
+    if (error != kErrorNone) {
+      FreeCacheBuffers();
+      return error;
+    }
+  }
+
+  return kErrorNone;
+}
+
+void HWCLayerCache::FreeCacheBuffers() {
+  // The display may still scan out either buffer and the GPU may still write the current one,
+  // gralloc recycles them once those fences have signalled.
+  CollectCompose();
+  if (compose_fence_fd_ >= 0) {
+    int &release_fence_fd = release_fence_fd_[current_buffer_index_];
+    int merged_fence_fd = -1;
+    if (buffer_sync_handler_.SyncMerge(release_fence_fd, compose_fence_fd_,
+                                       &merged_fence_fd) == kErrorNone) {
+      CloseFd(&release_fence_fd);
+      release_fence_fd = merged_fence_fd;
+    } else {
+      buffer_sync_handler_.SyncWait(compose_fence_fd_);
+    }
+  }
+
+  for (uint8_t i = 0; i < kNumCacheBuffers; i++) {
+    BufferInfo &buffer_info = buffer_info_[i];
+    if (buffer_info.private_data) {
+      buffer_allocator_->FreeBuffer(&buffer_info, release_fence_fd_[i]);
+    }
+    CloseFd(&release_fence_fd_[i]);
+    buffer_info = {};
+  }
+  valid_ = false;
+}
+
+void HWCLayerCache::Dump(std::ostringstream *os) {
+  *os << "layer cache: " << (active_ ? run_.size() : 0) << " layers cached,";
+  *os << " composed " << composed_frames_ << " times,";
+  *os << " saved a GPU composition in " << reused_frames_ << " frames" << std::endl;
+}
+
+}  // namespace sdm
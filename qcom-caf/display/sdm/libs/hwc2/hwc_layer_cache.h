@@ -0,0 +1,144 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_LAYER_CACHE_H__
+#define __HWC_LAYER_CACHE_H__
+
+#include <core/layer_stack.h>
+#include <utils/sync_task.h>
+#include <sstream>
+#include <vector>
+
+#include "hwc_buffer_allocator.h"
+#include "hwc_buffer_sync_handler.h"
+
+class Compositor;
+
+namespace sdm {
+
+enum class LayerCacheTaskCode : int32_t {
+  kCodeGetInstance,
+  kCodeCompose,
+  kCodeDestroy,
+};
+
+// Everything the compose task reads is copied here when it is started, as it runs on the GL
+// worker while the caller moves on to Prepare.
+struct LayerCacheComposeContext : public SyncTask<LayerCacheTaskCode>::TaskContext {
+  struct Draw {
+    const void *src_hnd = nullptr;
+    int src_fence_fd = -1;  // Owned by the compositor once drawn
+    float src_crop[4] = {};
+    int dst_rect[4] = {};
+    float alpha = 1.0f;
+    int blending = 0;
+  };
+
+  const void *dst_hnd = nullptr;
+  int dst_fence_fd = -1;
+  std::vector<Draw> draws;
+  int fence_fd = -1;
+};
+
+// Composes a run of static layers at the bottom of the stack once on the GPU, and presents the
+// result as a single layer for as long as none of those layers changes. Only the layers above
+// the run are then left for the strategy to place on pipes.
+class HWCLayerCache : public SyncTask<LayerCacheTaskCode>::TaskHandler {
+ public:
+  explicit HWCLayerCache(HWCBufferAllocator *buffer_allocator);
+  ~HWCLayerCache();
+
+  // Replaces the cacheable run of layer_stack with the cached layer. Called once the stack is
+  // built, before Prepare.
+  void HandleLayerStack(LayerStack *layer_stack);
+  // Puts the cached layers back in place of the cached layer and drops the cache. Called when the
+  // composition of the frame is forced instead of left to the strategy.
+  void RestoreLayerStack(LayerStack *layer_stack);
+  // Hands the composition picked for the cached layer on to the layers it stands for.
+  void UpdateCompositions();
+  void PostCommit(bool flush);
+  void Invalidate();
+  void Dump(std::ostringstream *os);
+
+  // TaskHandler methods implementation.
+  virtual void OnTask(const LayerCacheTaskCode &task_code,
+                      SyncTask<LayerCacheTaskCode>::TaskContext *task_context);
+
+ private:
+  struct CachedLayer {
+    Layer *layer = nullptr;
+    uint64_t buffer_id = 0;
+    LayerRect src_rect = {};
+    LayerRect dst_rect = {};
+    LayerBlending blending = kBlendingPremultiplied;
+    uint8_t plane_alpha = 0xff;
+
+    bool operator==(const CachedLayer &other) const;
+  };
+
+  static const uint32_t kMinCachedLayers = 2;
+  static const uint32_t kMinStableFrames = 3;
+  static const uint8_t kNumCacheBuffers = 2;
+
+  static bool IsCacheable(const Layer *layer);
+  bool ReplaceRun(LayerStack *layer_stack);
+  bool Compose();
+  DisplayError AllocateCacheBuffers(uint32_t width, uint32_t height);
+  void FreeCacheBuffers();
+  void SetupCacheLayer();
+  void CollectCompose();
+  void WaitForCompose();
+
+  SyncTask<LayerCacheTaskCode> layer_cache_task_;
+  LayerCacheComposeContext compose_ctx_;
+  bool compose_pending_ = false;  // A compose was started and its fence not collected yet
+  HWCBufferAllocator *buffer_allocator_ = nullptr;
+  HWCBufferSyncHandler buffer_sync_handler_ = {};
+  Compositor *compositor_ = nullptr;
+  BufferInfo buffer_info_[kNumCacheBuffers] = {};
+  int release_fence_fd_[kNumCacheBuffers] = {-1, -1};
+  uint8_t current_buffer_index_ = 0;
+  Layer cache_layer_ = {};
+  LayerRect cache_rect_ = {};
+  std::vector<CachedLayer> run_ = {};
+  std::vector<CachedLayer> candidate_ = {};
+  uint32_t stable_frames_ = 0;
+  bool valid_ = false;       // The cache buffer holds the composition of run_
+  bool active_ = false;      // The cached layer is part of the current layer stack
+  bool rejected_ = false;    // The strategy did not place the cached layer on a pipe
+  bool run_on_gpu_ = false;  // Before it was cached, the strategy left part of the run to GPU
+  int compose_fence_fd_ = -1;
+  uint64_t composed_frames_ = 0;
+  // Frames the cached layer was committed on a pipe without recomposing, in place of a run the
+  // strategy had left partly to GPU
+  uint64_t reused_frames_ = 0;
+};
+
+}  // namespace sdm
+#endif  // __HWC_LAYER_CACHE_H__
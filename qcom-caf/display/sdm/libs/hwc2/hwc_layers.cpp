@@ -25,6 +25,7 @@
 #include <gr.h>
 #endif
 #include <utils/debug.h>
+#include <utils/rect.h>
 #include <utils/utils.h>
 #include <cmath>
 
@@ -183,12 +184,64 @@ HWCLayer::~HWCLayer() {
     close(release_fences_.front());
     release_fences_.pop();
   }
-  close(ion_fd_);
+  ClearBufferCache();
   if (layer_) {
     delete layer_;
   }
 }
 
+HWCLayer::BufferCacheEntry *HWCLayer::GetBufferCacheEntry(const private_handle_t *handle) {
+  BufferCacheEntry *victim = &buffer_cache_[0];
+  for (auto &entry : buffer_cache_) {
+    if (entry.handle == handle && entry.id == handle->id && entry.fd == handle->fd) {
+      entry.last_use = ++buffer_cache_uses_;
+      entry.last_frame = frame_count_;
+      return &entry;
+    }
+    if (entry.last_use < victim->last_use) {
+      victim = &entry;
+    }
+  }
+
+  // Validate and dup ion fd from surfaceflinger
+  // This works around bug 30281222
+  int ion_fd = dup(handle->fd);
+  if (ion_fd < 0) {
+    return nullptr;
+  }
+
+  close(victim->ion_fd);
+  *victim = BufferCacheEntry();
+  victim->handle = handle;
+  victim->id = handle->id;
+  victim->fd = handle->fd;
+  victim->ion_fd = ion_fd;
+  victim->last_use = ++buffer_cache_uses_;
+  victim->last_frame = frame_count_;
+
+  return victim;
+}
+
+void HWCLayer::ClearBufferCache() {
+  for (auto &entry : buffer_cache_) {
+    close(entry.ion_fd);
+    entry = BufferCacheEntry();
+  }
+}
+
+void HWCLayer::DropStaleBuffers() {
+  // Each cached buffer holds a dup of its ion fd, which keeps the buffer memory alive after
+  // SurfaceFlinger frees it. The buffer on screen stays, however long ago it was set.
+  frame_count_++;
+  for (auto &entry : buffer_cache_) {
+    if ((entry.ion_fd >= 0) && (entry.ion_fd != layer_->input_buffer.planes[0].fd) &&
+        ((frame_count_ - entry.last_frame) > kMaxBufferCacheAge)) {
+      close(entry.ion_fd);
+      entry = BufferCacheEntry();
+    }
+  }
+}
+
 HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, int32_t acquire_fence) {
   if (!buffer) {
     DLOGE("Invalid buffer handle: %p on layer: %d", buffer, id_);
@@ -201,40 +254,59 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, int32_t acquire_fen
   }
 
   const private_handle_t *handle = static_cast<const private_handle_t *>(buffer);
-
-  // Validate and dup ion fd from surfaceflinger
-  // This works around bug 30281222
   if (handle->fd < 0) {
     return HWC2::Error::BadParameter;
-  } else {
-    close(ion_fd_);
-    ion_fd_ = dup(handle->fd);
   }
 
-  LayerBuffer *layer_buffer = &layer_->input_buffer;
-  int aligned_width, aligned_height;
+  BufferCacheEntry *entry = GetBufferCacheEntry(handle);
+  if (!entry) {
+    return HWC2::Error::NoResources;
+  }
+
+  uint32_t generation = 0;
+  bool has_generation =
+      (getMetaDataGeneration(const_cast<private_handle_t *>(handle), &generation) == 0);
+  if (!entry->has_generation || !has_generation || entry->generation != generation) {
+    // New buffer or its metadata changed, derive the geometry and metadata again.
+    int aligned_width, aligned_height;
 #ifdef USE_GRALLOC1
-  buffer_allocator_->GetCustomWidthAndHeight(handle, &aligned_width, &aligned_height);
+    buffer_allocator_->GetCustomWidthAndHeight(handle, &aligned_width, &aligned_height);
 #else
-  AdrenoMemInfo::getInstance().getAlignedWidthAndHeight(handle, aligned_width, aligned_height);
+    AdrenoMemInfo::getInstance().getAlignedWidthAndHeight(handle, aligned_width, aligned_height);
 #endif
+    entry->format = GetSDMFormat(handle->format, handle->flags);
+    entry->aligned_width = UINT32(aligned_width);
+    entry->aligned_height = UINT32(aligned_height);
+    ParseMetaData(handle, &entry->metadata);
+    if (entry->metadata.has_linear_format) {
+      entry->format = entry->metadata.linear_format;
+    }
+    entry->has_generation = has_generation;
+    entry->generation = generation;
+  }
 
-  LayerBufferFormat format = GetSDMFormat(handle->format, handle->flags);
-  if ((format != layer_buffer->format) || (UINT32(aligned_width) != layer_buffer->width) ||
-      (UINT32(aligned_height) != layer_buffer->height)) {
+  LayerBuffer *layer_buffer = &layer_->input_buffer;
+  if ((entry->format != layer_buffer->format) ||
+      (entry->aligned_width != layer_buffer->width) ||
+      (entry->aligned_height != layer_buffer->height)) {
     // Layer buffer geometry has changed.
     geometry_changes_ |= kBufferGeometry;
+    // The buffers of the old geometry are not coming back, stop holding on to them.
+    for (auto &stale : buffer_cache_) {
+      if (&stale != entry) {
+        close(stale.ion_fd);
+        stale = BufferCacheEntry();
+      }
+    }
   }
 
-  layer_buffer->format = format;
-  layer_buffer->width = UINT32(aligned_width);
-  layer_buffer->height = UINT32(aligned_height);
+  layer_buffer->format = entry->format;
+  layer_buffer->width = entry->aligned_width;
+  layer_buffer->height = entry->aligned_height;
   layer_buffer->unaligned_width = UINT32(handle->unaligned_width);
   layer_buffer->unaligned_height = UINT32(handle->unaligned_height);
 
-  if (SetMetaData(const_cast<private_handle_t *>(handle), layer_) != kErrorNone) {
-    return HWC2::Error::BadLayer;
-  }
+  ApplyMetaData(entry->metadata, layer_);
 
   layer_buffer->flags.video = (handle->buffer_type == BUFFER_TYPE_VIDEO) ? true : false;
 
@@ -252,7 +324,7 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, int32_t acquire_fen
   layer_buffer->flags.secure_camera = secure_camera;
   layer_buffer->flags.secure_display = secure_display;
 
-  layer_buffer->planes[0].fd = ion_fd_;
+  layer_buffer->planes[0].fd = entry->ion_fd;
   layer_buffer->planes[0].offset = handle->offset;
   layer_buffer->planes[0].stride = UINT32(handle->width);
   CloseFd(&layer_buffer->acquire_fence_fd);
@@ -264,25 +336,18 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, int32_t acquire_fen
 }
 
 HWC2::Error HWCLayer::SetLayerSurfaceDamage(hwc_region_t damage) {
-  // Check if there is an update in SurfaceDamage rects
-  if (layer_->dirty_regions.size() != damage.numRects) {
-    needs_validate_ = true;
-  } else {
-    for (uint32_t j = 0; j < damage.numRects; j++) {
-      LayerRect damage_rect;
-      SetRect(damage.rects[j], &damage_rect);
-      if (damage_rect != layer_->dirty_regions.at(j)) {
-        needs_validate_ = true;
-        break;
-      }
-    }
+  // Merge overlapping and adjacent damage before handing it to SDM, so that partial update scans
+  // fewer rects. Both vectors keep their capacity across frames.
+  damage_regions_.resize(damage.numRects);
+  for (uint32_t i = 0; i < damage.numRects; i++) {
+    SetRect(damage.rects[i], &damage_regions_.at(i));
   }
+  Coalesce(&damage_regions_);
 
-  layer_->dirty_regions.clear();
-  for (uint32_t i = 0; i < damage.numRects; i++) {
-    LayerRect rect;
-    SetRect(damage.rects[i], &rect);
-    layer_->dirty_regions.push_back(rect);
+  // Check if there is an update in SurfaceDamage rects
+  if (damage_regions_ != layer_->dirty_regions) {
+    needs_validate_ = true;
+    layer_->dirty_regions.swap(damage_regions_);
   }
   return HWC2::Error::None;
 }
@@ -471,11 +536,9 @@ HWC2::Error HWCLayer::SetLayerTransform(HWC2::Transform transform) {
 }
 
 HWC2::Error HWCLayer::SetLayerVisibleRegion(hwc_region_t visible) {
-  layer_->visible_regions.clear();
+  layer_->visible_regions.resize(visible.numRects);
   for (uint32_t i = 0; i < visible.numRects; i++) {
-    LayerRect rect;
-    SetRect(visible.rects[i], &rect);
-    layer_->visible_regions.push_back(rect);
+    SetRect(visible.rects[i], &layer_->visible_regions.at(i));
   }
 
   return HWC2::Error::None;
@@ -672,41 +735,48 @@ LayerBufferS3DFormat HWCLayer::GetS3DFormat(uint32_t s3d_format) {
   return sdm_s3d_format;
 }
 
-DisplayError HWCLayer::SetMetaData(const private_handle_t *pvt_handle, Layer *layer) {
-  LayerBuffer *layer_buffer = &layer->input_buffer;
+void HWCLayer::ParseMetaData(const private_handle_t *pvt_handle, BufferMetaData *metadata) {
   private_handle_t *handle = const_cast<private_handle_t *>(pvt_handle);
+  *metadata = BufferMetaData();
 
   float fps = 0;
-  uint32_t frame_rate = layer->frame_rate;
   if (getMetaData(handle, GET_REFRESH_RATE, &fps) == 0) {
-    frame_rate = RoundToStandardFPS(fps);
+    metadata->has_frame_rate = true;
+    metadata->frame_rate = RoundToStandardFPS(fps);
   }
 
   int32_t interlaced = 0;
   getMetaData(handle, GET_PP_PARAM_INTERLACED, &interlaced);
-  bool interlace = interlaced ? true : false;
+  metadata->interlace = interlaced ? true : false;
 
   uint32_t linear_format = 0;
   if (getMetaData(handle, GET_LINEAR_FORMAT, &linear_format) == 0) {
-    layer_buffer->format = GetSDMFormat(INT32(linear_format), 0);
+    metadata->has_linear_format = true;
+    metadata->linear_format = GetSDMFormat(INT32(linear_format), 0);
   }
 
   uint32_t s3d = 0;
-  LayerBufferS3DFormat s3d_format = layer_buffer->s3d_format;
   if (getMetaData(handle, GET_S3D_FORMAT, &s3d) == 0) {
-    s3d_format = GetS3DFormat(s3d);
+    metadata->has_s3d_format = true;
+    metadata->s3d_format = GetS3DFormat(s3d);
   }
+}
 
-  if ((interlace != layer_buffer->flags.interlace) ||
+void HWCLayer::ApplyMetaData(const BufferMetaData &metadata, Layer *layer) {
+  LayerBuffer *layer_buffer = &layer->input_buffer;
+
+  uint32_t frame_rate = metadata.has_frame_rate ? metadata.frame_rate : layer->frame_rate;
+  LayerBufferS3DFormat s3d_format =
+      metadata.has_s3d_format ? metadata.s3d_format : layer_buffer->s3d_format;
+
+  if ((metadata.interlace != layer_buffer->flags.interlace) ||
       (frame_rate != layer->frame_rate) || (s3d_format != layer_buffer->s3d_format)) {
     // Layer buffer metadata has changed.
     needs_validate_ = true;
     layer->frame_rate = frame_rate;
     layer_buffer->s3d_format = s3d_format;
-    layer_buffer->flags.interlace = interlace;
+    layer_buffer->flags.interlace = metadata.interlace;
   }
-
-  return kErrorNone;
 }
 
 
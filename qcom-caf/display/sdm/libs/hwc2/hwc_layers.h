@@ -34,6 +34,7 @@
 #include <map>
 #include <queue>
 #include <set>
+#include <vector>
 #include "core/buffer_allocator.h"
 #include "hwc_buffer_allocator.h"
 
@@ -94,19 +95,55 @@ class HWCLayer {
   void ResetValidation() { needs_validate_ = false; }
   bool NeedsValidation() { return (needs_validate_ || geometry_changes_); }
   bool IsNonIntegralSourceCrop() { return non_integral_source_crop_; }
+  // Called once per committed frame, drops cached buffers the layer stopped setting.
+  void DropStaleBuffers();
 
  private:
+  // Values taken from the buffer metadata, the linear format is folded into the cached format
+  struct BufferMetaData {
+    bool has_frame_rate = false;
+    uint32_t frame_rate = 0;
+    bool interlace = false;
+    bool has_linear_format = false;
+    LayerBufferFormat linear_format = kFormatInvalid;
+    bool has_s3d_format = false;
+    LayerBufferS3DFormat s3d_format = kS3dFormatNone;
+  };
+
+  // SurfaceFlinger cycles each layer through a few buffers. What is derived from a buffer
+  // handle is kept per buffer until its metadata generation changes, so setting a known
+  // buffer again only swaps the acquire fence.
+  struct BufferCacheEntry {
+    const private_handle_t *handle = nullptr;
+    uint64_t id = 0;
+    int fd = -1;
+    int ion_fd = -1;  // dup of fd owned by the cache
+    bool has_generation = false;
+    uint32_t generation = 0;
+    LayerBufferFormat format = kFormatInvalid;
+    uint32_t aligned_width = 0;
+    uint32_t aligned_height = 0;
+    BufferMetaData metadata;
+    uint64_t last_use = 0;
+    uint64_t last_frame = 0;  // Frame the buffer was last set on
+  };
+  static const uint32_t kBufferCacheSize = 4;
+  static const uint64_t kMaxBufferCacheAge = 60;  // Frames, about a second at 60 fps
+
   Layer *layer_ = nullptr;
   uint32_t z_ = 0;
   const hwc2_layer_t id_;
   const hwc2_display_t display_id_;
   static std::atomic<hwc2_layer_t> next_id_;
   std::queue<int32_t> release_fences_;
-  int ion_fd_ = -1;
+  BufferCacheEntry buffer_cache_[kBufferCacheSize];
+  uint64_t buffer_cache_uses_ = 0;
+  uint64_t frame_count_ = 0;
   HWCBufferAllocator *buffer_allocator_ = NULL;
   int32_t dataspace_ =  HAL_DATASPACE_UNKNOWN;
   bool needs_validate_ = true;
   bool non_integral_source_crop_ = false;
+  std::vector<LayerRect> damage_regions_ = {};  // Scratch for coalescing surface damage
 
   // Composition requested by client(SF)
   HWC2::Composition client_requested_ = HWC2::Composition::Device;
@@ -119,7 +156,10 @@ class HWCLayer {
   uint32_t GetUint32Color(const hwc_color_t &source);
   LayerBufferFormat GetSDMFormat(const int32_t &source, const int flags);
   LayerBufferS3DFormat GetS3DFormat(uint32_t s3d_format);
-  DisplayError SetMetaData(const private_handle_t *pvt_handle, Layer *layer);
+  BufferCacheEntry *GetBufferCacheEntry(const private_handle_t *handle);
+  void ClearBufferCache();
+  void ParseMetaData(const private_handle_t *pvt_handle, BufferMetaData *metadata);
+  void ApplyMetaData(const BufferMetaData &metadata, Layer *layer);
   uint32_t RoundToStandardFPS(float fps);
 };
 
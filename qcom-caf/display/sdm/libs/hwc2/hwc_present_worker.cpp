@@ -0,0 +1,139 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <unistd.h>
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+
+#include "hwc_present_worker.h"
+
+#define __CLASS__ "HWCPresentWorker"
+
+namespace sdm {
+
+HWCPresentWorker::HWCPresentWorker(hwc2_display_t display) : display_(display) {
+}
+
+HWCPresentWorker::~HWCPresentWorker() {
+  Wait();
+
+  if (retire_fence_ >= 0) {
+    close(retire_fence_);
+  }
+}
+
+bool HWCPresentWorker::Start(const PresentFunction &present) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (started_ || !IsDone()) {
+    return false;
+  }
+
+  // Left behind by a present that was discarded after it had completed.
+  if (retire_fence_ >= 0) {
+    close(retire_fence_);
+    retire_fence_ = -1;
+  }
+
+  present_ = present;
+  discard_ = false;
+  started_ = true;
+  WorkerPool::Get()->Submit(WorkerPool::kLaneGeneral, this);
+
+  return true;
+}
+
+bool HWCPresentWorker::Collect(HWC2::Error *status, int32_t *out_retire_fence) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_) {
+      return false;
+    }
+  }
+
+  Wait();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!started_) {
+    // Discarded while waiting.
+    return false;
+  }
+
+  *status = status_;
+  *out_retire_fence = retire_fence_;
+  retire_fence_ = -1;
+  started_ = false;
+
+  return true;
+}
+
+void HWCPresentWorker::Discard() {
+  HWC2::Error status = HWC2::Error::None;
+  int32_t retire_fence = -1;
+  if (Collect(&status, &retire_fence) && (retire_fence >= 0)) {
+    close(retire_fence);
+  }
+}
+
+void HWCPresentWorker::Abandon() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (!started_) {
+    return;
+  }
+
+  started_ = false;
+  if (!IsDone()) {
+    // The worker may be waiting for the display lock held by the caller, let it clean up.
+    discard_ = true;
+  } else if (retire_fence_ >= 0) {
+    close(retire_fence_);
+    retire_fence_ = -1;
+  }
+}
+
+void HWCPresentWorker::Run() {
+  int32_t retire_fence = -1;
+  HWC2::Error status = present_(&retire_fence);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (discard_) {
+    DLOGW("Dropping the present of display %d which was never collected", INT(display_));
+    if (retire_fence >= 0) {
+      close(retire_fence);
+    }
+    return;
+  }
+
+  status_ = status;
+  retire_fence_ = retire_fence;
+}
+
+}  // namespace sdm
@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_PRESENT_WORKER_H__
+#define __HWC_PRESENT_WORKER_H__
+
+#include <hardware/hwcomposer2.h>
+
+#include <utils/worker_pool.h>
+
+#include <functional>
+#include <mutex>
+
+#include "hwc_display.h"
+
+namespace sdm {
+
+// Presents one display on a general WorkerPool thread. HWCSession starts it when the client
+// presents another display first, so that both commits are in flight at once, and collects the
+// result when the client gets to presenting this display.
+class HWCPresentWorker : public WorkerTask {
+ public:
+  typedef std::function<HWC2::Error(int32_t *out_retire_fence)> PresentFunction;
+
+  explicit HWCPresentWorker(hwc2_display_t display);
+  ~HWCPresentWorker();
+
+  // Returns false if a present was started earlier and has not been collected yet.
+  bool Start(const PresentFunction &present);
+  // Waits for the started present and hands out its result. Returns false if none was started.
+  bool Collect(HWC2::Error *status, int32_t *out_retire_fence);
+  // Waits for a started present and drops its result. The present takes the display lock, so
+  // the caller must not hold it.
+  void Discard();
+  // Drops the result of a started present without waiting for it. Only for a display being torn
+  // down with its lock held, a present still running then finds the display gone.
+  void Abandon();
+
+ protected:
+  void Run();
+
+ private:
+  hwc2_display_t display_;
+  std::mutex mutex_;
+  PresentFunction present_;
+  bool started_ = false;
+  HWC2::Error status_ = HWC2::Error::None;
+  int32_t retire_fence_ = -1;
+  bool discard_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_PRESENT_WORKER_H__
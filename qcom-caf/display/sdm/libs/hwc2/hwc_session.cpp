@@ -22,15 +22,16 @@
 #include <utils/constants.h>
 #include <utils/String16.h>
 #include <cutils/properties.h>
-#include <hardware_legacy/uevent.h>
+#include <cutils/uevent.h>
+#include <sys/epoll.h>
 #include <sys/resource.h>
 #include <sys/prctl.h>
 #include <binder/Parcel.h>
 #include <QService.h>
 #include <display_config.h>
 #include <utils/debug.h>
+#include <utils/event_loop.h>
 #include <sync/sync.h>
-#include <profiler.h>
 #include <algorithm>
 #include <string>
 #include <bitset>
@@ -77,6 +78,13 @@ hwc_module_t HAL_MODULE_INFO_SYM = {
 namespace sdm {
 
 static HWCUEvent g_hwc_uevent_;
+
+// Vsync timestamps from the driver are taken on the monotonic clock.
+static int64_t GetMonotonicTimeNs() {
+  struct timespec now = {};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
 Locker HWCSession::locker_[HWC_NUM_DISPLAY_TYPES];
 bool HWCSession::disable_skip_validate_ = false;
 
@@ -86,32 +94,22 @@ void HWCUEvent::UEventThread(HWCUEvent *hwc_uevent) {
   prctl(PR_SET_NAME, uevent_thread_name, 0, 0, 0);
   setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
 
-  int status = uevent_init();
-  if (!status) {
-    std::unique_lock<std::mutex> caller_lock(hwc_uevent->mutex_);
-    hwc_uevent->caller_cv_.notify_one();
-    DLOGE("Failed to init uevent with err %d", status);
-    return;
-  }
-
-  {
-    // Signal caller thread that worker thread is ready to listen to events.
-    std::unique_lock<std::mutex> caller_lock(hwc_uevent->mutex_);
-    hwc_uevent->init_done_ = true;
-    hwc_uevent->caller_cv_.notify_one();
-  }
-
   while (1) {
-    char uevent_data[PAGE_SIZE] = {};
-
-    // keep last 2 zeroes to ensure double 0 termination
-    int length = uevent_next_event(uevent_data, INT32(sizeof(uevent_data)) - 2);
+    std::string uevent;
+    {
+      std::unique_lock<std::mutex> queue_lock(hwc_uevent->queue_mutex_);
+      hwc_uevent->queue_cv_.wait(queue_lock, [hwc_uevent] {
+        return !hwc_uevent->pending_uevents_.empty();
+      });
+      uevent = std::move(hwc_uevent->pending_uevents_.front());
+      hwc_uevent->pending_uevents_.pop_front();
+    }
 
     // scope of lock to this block only, so that caller is free to set event handler to nullptr;
     {
       std::lock_guard<std::mutex> guard(hwc_uevent->mutex_);
       if (hwc_uevent->uevent_listener_) {
-        hwc_uevent->uevent_listener_->UEventHandler(uevent_data, length);
+        hwc_uevent->uevent_listener_->UEventHandler(uevent.data(), INT(uevent.size()));
       } else {
         DLOGW("UEvent dropped. No uevent listener.");
       }
@@ -119,11 +117,64 @@ void HWCUEvent::UEventThread(HWCUEvent *hwc_uevent) {
   }
 }
 
+void HWCUEvent::HandleUEvent(uint32_t events) {
+  if (!(events & EPOLLIN)) {
+    return;
+  }
+
+  char uevent_data[PAGE_SIZE] = {};
+
+  // keep last 2 zeroes to ensure double 0 termination. Messages that are not from the kernel
+  // are dropped here rather than waited past, so that the shared loop never blocks.
+  int length = uevent_kernel_multicast_recv(uevent_fd_, uevent_data,
+                                            sizeof(uevent_data) - 2);
+  if (length <= 0) {
+    return;
+  }
+
+  bool hdmi_event = !strcasecmp(uevent_data, HWC_UEVENT_SWITCH_HDMI);
+  if (!hdmi_event && strcasecmp(uevent_data, HWC_UEVENT_GRAPHICS_FB0)) {
+    return;
+  }
+
+  // Hand the event over, the listener must not run on the shared loop
+  {
+    std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+    if (hdmi_event) {
+      // Only the latest connection state matters, it replaces one still waiting to be handled
+      for (std::string &pending : pending_uevents_) {
+        if (!strcasecmp(pending.c_str(), HWC_UEVENT_SWITCH_HDMI)) {
+          pending.assign(uevent_data, UINT32(length));
+          return;
+        }
+      }
+    }
+    pending_uevents_.emplace_back(uevent_data, UINT32(length));
+  }
+  queue_cv_.notify_one();
+}
+
 HWCUEvent::HWCUEvent() {
-  std::unique_lock<std::mutex> caller_lock(mutex_);
+  // The cutils socket has SO_PASSCRED set, which uevent_kernel_multicast_recv needs to tell
+  // kernel messages apart.
+  uevent_fd_ = uevent_open_socket(64 * 1024, true);
+  if (uevent_fd_ < 0) {
+    DLOGE("Failed to open uevent socket, error = %s", strerror(errno));
+    return;
+  }
+
   std::thread thread(HWCUEvent::UEventThread, this);
   thread.detach();
-  caller_cv_.wait(caller_lock);
+
+  DisplayError error = EventLoop::Get()->Register(uevent_fd_, EPOLLIN, [this](uint32_t events) {
+    HandleUEvent(events);
+  });
+  if (error != kErrorNone) {
+    DLOGE("Failed to register uevent fd %d with the event loop, error = %d", uevent_fd_, error);
+    return;
+  }
+
+  init_done_ = true;
 }
 
 void HWCUEvent::Register(HWCUEventListener *uevent_listener) {
@@ -223,11 +274,24 @@ int HWCSession::Init() {
     return status;
   }
 
+  int async_present = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_ASYNC_PRESENT_PROP, &async_present);
+  if (async_present == 1) {
+    present_worker_[HWC_DISPLAY_EXTERNAL] = new HWCPresentWorker(HWC_DISPLAY_EXTERNAL);
+    present_worker_[HWC_DISPLAY_VIRTUAL] = new HWCPresentWorker(HWC_DISPLAY_VIRTUAL);
+  }
+
   is_composer_up_ = true;
   return 0;
 }
 
 int HWCSession::Deinit() {
+  // Workers present under the display locks, stop them before those are taken below.
+  for (auto &present_worker : present_worker_) {
+    delete present_worker;
+    present_worker = nullptr;
+  }
+
   Locker::SequenceCancelScopeLock lock_v(locker_[HWC_DISPLAY_VIRTUAL]);
   Locker::SequenceCancelScopeLock lock_e(locker_[HWC_DISPLAY_EXTERNAL]);
   Locker::SequenceCancelScopeLock lock_p(locker_[HWC_DISPLAY_PRIMARY]);
@@ -383,6 +447,10 @@ int32_t HWCSession::DestroyVirtualDisplay(hwc2_device_t *device, hwc2_display_t
   DLOGI("Destroying virtual display id:%" PRIu64, display);
   auto *hwc_session = static_cast<HWCSession *>(device);
 
+  if (hwc_session->present_worker_[display]) {
+    hwc_session->present_worker_[display]->Abandon();
+  }
+
   if (hwc_session->hwc_display_[display]) {
     HWCDisplayVirtual::Destroy(hwc_session->hwc_display_[display]);
     hwc_session->hwc_display_[display] = nullptr;
@@ -521,23 +589,17 @@ int32_t HWCSession::PresentDisplay(hwc2_device_t *device, hwc2_display_t display
     return HWC2_ERROR_BAD_DISPLAY;
   }
 
-  {
-    SEQUENCE_EXIT_SCOPE_LOCK(locker_[display]);
-    if (!device) {
-      return HWC2_ERROR_BAD_DISPLAY;
-    }
+  if (!device) {
+    return HWC2_ERROR_BAD_DISPLAY;
+  }
 
-    // TODO(user): Handle virtual display/HDMI concurrency
-    if (hwc_session->hwc_display_[display]) {
-      status = hwc_session->hwc_display_[display]->Present(out_retire_fence);
-      // This is only indicative of how many times SurfaceFlinger posts
-      // frames to the display.
-      CALC_FPS();
-    }
+  if (display == HWC_DISPLAY_PRIMARY) {
+    hwc_session->StartAsyncPresents();
   }
 
-  if (status != HWC2::Error::None && status != HWC2::Error::NotValidated) {
-    SEQUENCE_CANCEL_SCOPE_LOCK(locker_[display]);
+  HWCPresentWorker *present_worker = hwc_session->present_worker_[display];
+  if (!present_worker || !present_worker->Collect(&status, out_retire_fence)) {
+    status = hwc_session->PresentDisplayInternal(display, out_retire_fence);
   }
 
   // Handle Pending external display connection
@@ -569,6 +631,61 @@ int32_t HWCSession::PresentDisplay(hwc2_device_t *device, hwc2_display_t display
   return INT32(status);
 }
 
+HWC2::Error HWCSession::PresentDisplayInternal(hwc2_display_t display,
+                                               int32_t *out_retire_fence) {
+  auto status = HWC2::Error::BadDisplay;
+
+  {
+    SEQUENCE_EXIT_SCOPE_LOCK(locker_[display]);
+    if (hwc_display_[display]) {
+      HWCDisplay *hwc_display = hwc_display_[display];
+      HWCFrameStats *frame_stats = hwc_display->GetFrameStats();
+      int64_t start_ns = frame_stats->IsEnabled() ? GetMonotonicTimeNs() : 0;
+      status = hwc_display->Present(out_retire_fence);
+      hwc_display->ResetPresentInputs();
+      if (start_ns && status == HWC2::Error::None) {
+        // The frame targets the first vsync after present starts. It misses it if its retire
+        // fence signals on a later vsync, half a period leaves room for timestamp jitter.
+        int64_t vsync_ns = hwc_display->PredictVsync(start_ns, 0);
+        int64_t deadline_ns = vsync_ns ? vsync_ns + hwc_display->GetVsyncPeriodNs() / 2 : 0;
+        frame_stats->RecordPresent(start_ns, GetMonotonicTimeNs(), *out_retire_fence,
+                                   deadline_ns);
+      }
+    }
+  }
+
+  if (status != HWC2::Error::None && status != HWC2::Error::NotValidated) {
+    SEQUENCE_CANCEL_SCOPE_LOCK(locker_[display]);
+  }
+
+  return status;
+}
+
+void HWCSession::StartAsyncPresents() {
+  // SurfaceFlinger presents the primary display first and the others right after it, once it
+  // has handed in the client targets of all of them. Displays that have everything they need
+  // are committed on their own worker meanwhile, SDM only serializes the short CompManager and
+  // resource sections of the commits, not the driver commits themselves.
+  for (hwc2_display_t display = HWC_DISPLAY_PRIMARY + 1; display < HWC_NUM_DISPLAY_TYPES;
+       display++) {
+    HWCPresentWorker *present_worker = present_worker_[display];
+    if (!present_worker) {
+      continue;
+    }
+
+    {
+      SCOPE_LOCK(locker_[display]);
+      if (!hwc_display_[display] || !hwc_display_[display]->IsReadyForAsyncPresent()) {
+        continue;
+      }
+    }
+
+    present_worker->Start([this, display](int32_t *out_retire_fence) {
+      return PresentDisplayInternal(display, out_retire_fence);
+    });
+  }
+}
+
 int32_t HWCSession::RegisterCallback(hwc2_device_t *device, int32_t descriptor,
                                      hwc2_callback_data_t callback_data,
                                      hwc2_function_pointer_t pointer) {
@@ -748,10 +865,16 @@ int32_t HWCSession::ValidateDisplay(hwc2_device_t *device, hwc2_display_t displa
                                     uint32_t *out_num_types, uint32_t *out_num_requests) {
   DTRACE_SCOPED();
   HWCSession *hwc_session = static_cast<HWCSession *>(device);
-  if (!device) {
+  if (!device || display >= HWC_NUM_DISPLAY_TYPES) {
     return HWC2_ERROR_BAD_DISPLAY;
   }
 
+  // A present started ahead of the client must complete before the next frame is validated,
+  // or it would commit that frame instead of the one it was started for.
+  if (hwc_session->present_worker_[display]) {
+    hwc_session->present_worker_[display]->Discard();
+  }
+
   // TODO(user): Handle secure session, handle QDCM solid fill
   // Handle external_pending_connect_ in CreateVirtualDisplay
   auto status = HWC2::Error::BadDisplay;
@@ -775,7 +898,12 @@ int32_t HWCSession::ValidateDisplay(hwc2_device_t *device, hwc2_display_t displa
         }
       }
 
+      HWCFrameStats *frame_stats = hwc_session->hwc_display_[display]->GetFrameStats();
+      int64_t start_ns = frame_stats->IsEnabled() ? GetMonotonicTimeNs() : 0;
       status = hwc_session->hwc_display_[display]->Validate(out_num_types, out_num_requests);
+      if (start_ns) {
+        frame_stats->RecordValidate(start_ns, GetMonotonicTimeNs());
+      }
     }
   }
 
@@ -928,6 +1056,10 @@ int32_t HWCSession::ConnectDisplay(int disp) {
 int HWCSession::DisconnectDisplay(int disp) {
   DLOGI("Display = %d", disp);
 
+  if (present_worker_[disp]) {
+    present_worker_[disp]->Abandon();
+  }
+
   if (disp == HWC_DISPLAY_EXTERNAL) {
     HWCDisplayExternal::Destroy(hwc_display_[disp]);
   } else if (disp == HWC_DISPLAY_VIRTUAL) {
@@ -1117,6 +1249,14 @@ android::status_t HWCSession::notifyCallback(uint32_t command, const android::Pa
       status = GetPanelResolution(input_parcel, output_parcel);
       break;
 
+    case qService::IQService::GET_FRAME_STATS:
+      if (!input_parcel || !output_parcel) {
+        DLOGE("QService command = %d: input_parcel needed.", command);
+        break;
+      }
+      status = GetFrameStats(input_parcel, output_parcel);
+      break;
+
     default:
       DLOGW("QService command = %d is not supported", command);
       return -EINVAL;
@@ -1673,6 +1813,11 @@ int HWCSession::GetVsyncPeriod(int disp) {
   auto attribute = HWC2::Attribute::VsyncPeriod;
 
   if (hwc_display_[disp]) {
+    // Prefer the period measured from hardware vsync over the nominal one of the config.
+    int64_t measured_period = hwc_display_[disp]->GetVsyncPeriodNs();
+    if (measured_period > 0) {
+      return INT32(measured_period);
+    }
     hwc_display_[disp]->GetDisplayAttribute(0, attribute, &vsync_period);
   }
 
@@ -1738,6 +1883,36 @@ android::status_t HWCSession::GetPanelResolution(const android::Parcel *input_pa
   return android::NO_ERROR;
 }
 
+android::status_t HWCSession::GetFrameStats(const android::Parcel *input_parcel,
+                                            android::Parcel *output_parcel) {
+  int disp_id = input_parcel->readInt32();
+  bool reset = (input_parcel->dataAvail() >= sizeof(int32_t)) && input_parcel->readInt32();
+  if (disp_id < HWC_DISPLAY_PRIMARY || disp_id >= HWC_NUM_DISPLAY_TYPES) {
+    DLOGE("Invalid display = %d", disp_id);
+    return -EINVAL;
+  }
+
+  SCOPE_LOCK(locker_[disp_id]);
+  if (!hwc_display_[disp_id]) {
+    return -EINVAL;
+  }
+
+  HWCFrameStats *frame_stats = hwc_display_[disp_id]->GetFrameStats();
+  if (!frame_stats->IsEnabled()) {
+    DLOGW("Frame stats are disabled, set %s to enable them", ENABLE_FRAME_STATS_PROP);
+    return -ENODEV;
+  }
+
+  std::ostringstream os;
+  frame_stats->Dump(&os);
+  output_parcel->writeString16(android::String16(os.str().c_str()));
+  if (reset) {
+    frame_stats->Reset();
+  }
+
+  return android::NO_ERROR;
+}
+
 void HWCSession::Refresh(hwc2_display_t display) {
   SCOPE_LOCK(callbacks_lock_);
    callbacks_.Refresh(display);
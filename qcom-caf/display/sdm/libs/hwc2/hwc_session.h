@@ -25,6 +25,9 @@
 #include <utils/locker.h>
 #include <cutils/native_handle.h>
 #include <config/device_interface.h>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>
 #include <string>
 
 #include "hwc_callbacks.h"
@@ -36,6 +39,7 @@
 #include "hwc_display_dummy.h"
 #include "hwc_color_manager.h"
 #include "hwc_socket_handler.h"
+#include "hwc_present_worker.h"
 
 namespace sdm {
 
@@ -44,11 +48,11 @@ using ::android::hardware::hidl_string;
 
 typedef DisplayConfig::DisplayType DispType;
 
-// Create a singleton uevent listener thread valid for life of hardware composer process.
-// This thread blocks on uevents poll inside uevent library implementation. This poll exits
-// only when there is a valid uevent, it can not be interrupted otherwise. Tieing life cycle
-// of this thread with HWC session cause HWC deinitialization to wait infinitely for the
-// thread to exit.
+// Create a singleton uevent listener valid for life of hardware composer process.
+// The uevent socket is read on the SDM event loop thread shared with the display event sources,
+// and the listener runs on a thread of its own, since hotplug handling sleeps and waits on the
+// display locks. Tieing life cycle of the listener with HWC session would require HWC
+// deinitialization to unregister the socket, so it is kept for the life of the process instead.
 class HWCUEventListener {
  public:
   virtual ~HWCUEventListener() {}
@@ -58,14 +62,20 @@ class HWCUEventListener {
 class HWCUEvent {
  public:
   HWCUEvent();
-  static void UEventThread(HWCUEvent *hwc_event);
+  static void UEventThread(HWCUEvent *hwc_uevent);
+  void HandleUEvent(uint32_t events);
   void Register(HWCUEventListener *uevent_listener);
   inline bool InitDone() { return init_done_; }
 
  private:
   std::mutex mutex_;
-  std::condition_variable caller_cv_;
   HWCUEventListener *uevent_listener_ = nullptr;
+  // Received on the event loop, drained by the uevent thread. Holds only the events the listener
+  // acts on, with at most one HDMI switch event, so it stays short without dropping any.
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<std::string> pending_uevents_;
+  int uevent_fd_ = -1;
   bool init_done_ = false;
 };
 
@@ -209,6 +219,8 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   void ResetPanel();
   int32_t ConnectDisplay(int disp);
   int DisconnectDisplay(int disp);
+  HWC2::Error PresentDisplayInternal(hwc2_display_t display, int32_t *out_retire_fence);
+  void StartAsyncPresents();
   int GetVsyncPeriod(int disp);
   int GetConfigCount(int disp_id, uint32_t *count);
   int GetActiveConfigIndex(int disp_id, uint32_t *config);
@@ -256,6 +268,8 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   android::status_t SetStandByMode(const android::Parcel *input_parcel);
   android::status_t GetPanelResolution(const android::Parcel *input_parcel,
                                        android::Parcel *output_parcel);
+  android::status_t GetFrameStats(const android::Parcel *input_parcel,
+                                  android::Parcel *output_parcel);
 
 
   void Refresh(hwc2_display_t display);
@@ -264,6 +278,7 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   static Locker locker_[HWC_NUM_DISPLAY_TYPES];
   CoreInterface *core_intf_ = nullptr;
   HWCDisplay *hwc_display_[HWC_NUM_DISPLAY_TYPES] = {nullptr};
+  HWCPresentWorker *present_worker_[HWC_NUM_DISPLAY_TYPES] = {nullptr};
   HWCCallbacks callbacks_;
   HWCBufferAllocator buffer_allocator_;
   HWCBufferSyncHandler buffer_sync_handler_;
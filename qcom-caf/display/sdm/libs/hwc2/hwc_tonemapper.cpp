@@ -49,12 +49,25 @@
 
 namespace sdm {
 
+// The CPU engine only handles linear RGBA buffers it is allowed to read and write
+static bool IsCpuToneMapSupported(const Layer *layer) {
+  auto is_linear_rgba = [](LayerBufferFormat format) {
+    return (format == kFormatRGBA8888) || (format == kFormatRGBX8888) ||
+           (format == kFormatRGBA1010102) || (format == kFormatRGBX1010102);
+  };
+
+  return !layer->request.flags.secure && is_linear_rgba(layer->input_buffer.format) &&
+         is_linear_rgba(layer->request.format);
+}
+
 ToneMapSession::ToneMapSession(HWCBufferAllocator *buffer_allocator)
-  : tone_map_task_(*this), buffer_allocator_(buffer_allocator) {
+  : tone_map_task_(*this, WorkerPool::kLaneGL), cpu_blit_task_(*this, WorkerPool::kLaneCpu),
+    buffer_allocator_(buffer_allocator) {
   buffer_info_.resize(kNumIntermediateBuffers);
 }
 
 ToneMapSession::~ToneMapSession() {
+  cpu_blit_task_.WaitForTask();
   tone_map_task_.PerformTask(ToneMapTaskCode::kCodeDestroy, nullptr);
   FreeIntermediateBuffers();
   buffer_info_.clear();
@@ -72,10 +85,21 @@ void ToneMapSession::OnTask(const ToneMapTaskCode &task_code,
           grid_entries = lut_3d.gridEntries;
           grid_size = INT(lut_3d.gridSize);
         }
-        gpu_tone_mapper_ = TonemapperFactory_GetInstance(tone_map_config_.type,
-                                                         lut_3d.lutEntries, lut_3d.dim,
-                                                         grid_entries, grid_size,
-                                                         tone_map_config_.secure);
+        if (!tone_map_config_.cpu) {
+          gpu_tone_mapper_ = TonemapperFactory_GetInstance(tone_map_config_.type,
+                                                           lut_3d.lutEntries, lut_3d.dim,
+                                                           grid_entries, grid_size,
+                                                           tone_map_config_.secure);
+        }
+        if (gpu_tone_mapper_) {
+          delete cpu_tone_mapper_;
+          cpu_tone_mapper_ = nullptr;
+        } else if (!cpu_tone_mapper_ && ctx->cpu_capable) {
+          cpu_tone_mapper_ = TonemapperFactory_GetCpuInstance(tone_map_config_.type,
+                                                              lut_3d.lutEntries, lut_3d.dim,
+                                                              grid_entries, grid_size);
+          tone_map_config_.cpu = true;
+        }
       }
       break;
 
@@ -86,12 +110,22 @@ void ToneMapSession::OnTask(const ToneMapTaskCode &task_code,
                                 (buffer_info_[buffer_index].private_data);
         const void *src_hnd = reinterpret_cast<const void *>
                                 (ctx->layer->input_buffer.buffer_id);
-        ctx->fence_fd = gpu_tone_mapper_->blit(dst_hnd, src_hnd, ctx->merged_fd);
+        if (cpu_tone_mapper_) {
+          // The output is complete once the CPU engine returns, there is no fence to pass on
+          ctx->fence_fd = -1;
+          ctx->status = cpu_tone_mapper_->blit(dst_hnd, src_hnd, ctx->merged_fd);
+          if (ctx->status == 0) {
+            CloseFd(&ctx->merged_fd);
+          }
+        } else {
+          ctx->fence_fd = gpu_tone_mapper_->blit(dst_hnd, src_hnd, ctx->merged_fd);
+        }
       }
       break;
 
     case ToneMapTaskCode::kCodeDestroy: {
         delete gpu_tone_mapper_;
+        delete cpu_tone_mapper_;
       }
       break;
 
@@ -121,14 +155,15 @@ DisplayError ToneMapSession::AllocateIntermediateBuffers(const Layer *layer) {
 
 void ToneMapSession::FreeIntermediateBuffers() {
   for (uint8_t i = 0; i < kNumIntermediateBuffers; i++) {
+    // The display may still scan out the buffer, gralloc recycles it once the fence signals.
+    BufferInfo &buffer_info = buffer_info_[i];
+    if (buffer_info.private_data) {
+      buffer_allocator_->FreeBuffer(&buffer_info, release_fence_fd_[i]);
+    }
     // Free the valid fence
     if (release_fence_fd_[i] >= 0) {
       CloseFd(&release_fence_fd_[i]);
     }
-    BufferInfo &buffer_info = buffer_info_[i];
-    if (buffer_info.private_data) {
-      buffer_allocator_->FreeBuffer(&buffer_info);
-    }
   }
 }
 
@@ -164,11 +199,31 @@ bool ToneMapSession::IsSameToneMapConfig(Layer *layer) {
           (buffer.color_metadata.colorPrimaries == tone_map_config_.colorPrimaries) &&
           (buffer.color_metadata.transfer == tone_map_config_.transfer) &&
           (layer->request.flags.secure == tone_map_config_.secure) &&
+          (!tone_map_config_.cpu || IsCpuToneMapSupported(layer)) &&
           (layer->request.format == tone_map_config_.format) &&
           (layer->request.width == UINT32(handle->unaligned_width)) &&
           (layer->request.height == UINT32(handle->unaligned_height)));
 }
 
+bool ToneMapSession::FallBackToGpu(Layer *layer) {
+  ToneMapGetInstanceContext ctx;
+  ctx.layer = layer;
+  tone_map_config_.cpu = false;
+  tone_map_task_.PerformTask(ToneMapTaskCode::kCodeGetInstance, &ctx);
+  if (!gpu_tone_mapper_) {
+    tone_map_config_.cpu = true;
+    return false;
+  }
+
+  return true;
+}
+
+HWCToneMapper::HWCToneMapper(HWCBufferAllocator *allocator) : buffer_allocator_(allocator) {
+  int value = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_CPU_TONEMAPPER_PROP, &value);
+  cpu_tone_mapper_enabled_ = (value == 1);
+}
+
 int HWCToneMapper::HandleToneMap(LayerStack *layer_stack) {
   uint32_t gpu_count = 0;
   DisplayError error = kErrorNone;
@@ -194,6 +249,7 @@ int HWCToneMapper::HandleToneMap(LayerStack *layer_stack) {
             fb_tone_map_session->UpdateBuffer(-1 /* acquire_fence */, &layer->input_buffer);
             fb_tone_map_session->layer_index_ = INT(i);
             fb_tone_map_session->acquired_ = true;
+            FinishToneMaps();
             return 0;
           }
         }
@@ -206,22 +262,26 @@ int HWCToneMapper::HandleToneMap(LayerStack *layer_stack) {
       }
 
       if (error != kErrorNone) {
+        FinishToneMaps();
         Terminate();
         return -1;
       }
 
       ToneMapSession *session = tone_map_sessions_.at(session_index);
-      ToneMap(layer, session);
+      StartToneMap(layer, session);
       DLOGI_IF(kTagClient, "Layer %d associated with session index %d", i, session_index);
       session->layer_index_ = INT(i);
     }
   }
 
+  FinishToneMaps();
+
   return 0;
 }
 
-void HWCToneMapper::ToneMap(Layer* layer, ToneMapSession *session) {
-  ToneMapBlitContext ctx = {};
+void HWCToneMapper::StartToneMap(Layer* layer, ToneMapSession *session) {
+  ToneMapBlitContext &ctx = session->blit_ctx_;
+  ctx = {};
   ctx.layer = layer;
 
   uint8_t buffer_index = session->current_buffer_index_;
@@ -239,12 +299,39 @@ void HWCToneMapper::ToneMap(Layer* layer, ToneMapSession *session) {
     CloseFd(&release_fence_fd);
   }
 
-  DTRACE_BEGIN("GPU_TM_BLIT");
-  session->tone_map_task_.PerformTask(ToneMapTaskCode::kCodeBlit, &ctx);
-  DTRACE_END();
+  // The fences of the next layer are merged while a worker runs this blit.
+  session->GetBlitTask().PerformTaskAsync(ToneMapTaskCode::kCodeBlit, &ctx);
+  session->blit_pending_ = true;
+}
+
+void HWCToneMapper::FinishToneMaps() {
+  for (ToneMapSession *session : tone_map_sessions_) {
+    if (!session->blit_pending_) {
+      continue;
+    }
 
-  DumpToneMapOutput(session, &ctx.fence_fd);
-  session->UpdateBuffer(ctx.fence_fd, &layer->input_buffer);
+    DTRACE_BEGIN("GPU_TM_BLIT");
+    session->GetBlitTask().WaitForTask();
+    DTRACE_END();
+    session->blit_pending_ = false;
+
+    ToneMapBlitContext &ctx = session->blit_ctx_;
+    if (ctx.status != 0) {
+      // The CPU engine could not process the buffers, redo the blit and the following ones on
+      // the GPU engine.
+      DLOGW("CPU tone map failed with %d, falling back to the GPU engine", ctx.status);
+      ctx.status = 0;
+      if (session->FallBackToGpu(ctx.layer)) {
+        session->tone_map_task_.PerformTask(ToneMapTaskCode::kCodeBlit, &ctx);
+      } else {
+        DLOGE("GPU tone mapper unavailable, layer is not tone mapped");
+        CloseFd(&ctx.merged_fd);
+      }
+    }
+
+    DumpToneMapOutput(session, &ctx.fence_fd);
+    session->UpdateBuffer(ctx.fence_fd, &ctx.layer->input_buffer);
+  }
 }
 
 void HWCToneMapper::PostCommit(LayerStack *layer_stack) {
@@ -360,11 +447,14 @@ DisplayError HWCToneMapper::AcquireToneMapSession(Layer *layer, uint32_t *sessio
 
   session->SetToneMapConfig(layer);
 
+  // The CPU engine is used when selected, or as a fallback when the GPU one cannot be created
   ToneMapGetInstanceContext ctx;
   ctx.layer = layer;
+  ctx.cpu_capable = IsCpuToneMapSupported(layer);
+  session->tone_map_config_.cpu = cpu_tone_mapper_enabled_ && ctx.cpu_capable;
   session->tone_map_task_.PerformTask(ToneMapTaskCode::kCodeGetInstance, &ctx);
 
-  if (session->gpu_tone_mapper_ == NULL) {
+  if (session->gpu_tone_mapper_ == NULL && session->cpu_tone_mapper_ == NULL) {
     DLOGE("Get Tonemapper failed!");
     delete session;
     return kErrorNotSupported;
@@ -43,6 +43,7 @@
 #include "hwc_buffer_allocator.h"
 
 class Tonemapper;
+class CpuTonemapper;
 
 namespace sdm {
 
@@ -54,12 +55,14 @@ enum class ToneMapTaskCode : int32_t {
 
 struct ToneMapGetInstanceContext : public SyncTask<ToneMapTaskCode>::TaskContext {
   Layer *layer = nullptr;
+  bool cpu_capable = false;  // Layer can fall back to the CPU engine
 };
 
 struct ToneMapBlitContext : public SyncTask<ToneMapTaskCode>::TaskContext {
   Layer *layer = nullptr;
   int merged_fd = -1;
   int fence_fd = -1;
+  int status = 0;  // Failure of the CPU engine, merged_fd is left open when set
 };
 
 struct ToneMapConfig {
@@ -68,6 +71,7 @@ struct ToneMapConfig {
   GammaTransfer transfer = Transfer_Max;
   LayerBufferFormat format = kFormatRGBA8888;
   bool secure = false;
+  bool cpu = false;
 };
 
 class ToneMapSession : public SyncTask<ToneMapTaskCode>::TaskHandler {
@@ -80,6 +84,11 @@ class ToneMapSession : public SyncTask<ToneMapTaskCode>::TaskHandler {
   void SetReleaseFence(int fd);
   void SetToneMapConfig(Layer *layer);
   bool IsSameToneMapConfig(Layer *layer);
+  bool FallBackToGpu(Layer *layer);
+  // GL work stays on the GL lane, CPU blits run on a lane of their own.
+  SyncTask<ToneMapTaskCode> &GetBlitTask() {
+    return cpu_tone_mapper_ ? cpu_blit_task_ : tone_map_task_;
+  }
 
   // TaskHandler methods implementation.
   virtual void OnTask(const ToneMapTaskCode &task_code,
@@ -87,7 +96,11 @@ class ToneMapSession : public SyncTask<ToneMapTaskCode>::TaskHandler {
 
   static const uint8_t kNumIntermediateBuffers = 2;
   SyncTask<ToneMapTaskCode> tone_map_task_;
+  SyncTask<ToneMapTaskCode> cpu_blit_task_;
+  ToneMapBlitContext blit_ctx_ = {};
+  bool blit_pending_ = false;
   Tonemapper *gpu_tone_mapper_ = nullptr;
+  CpuTonemapper *cpu_tone_mapper_ = nullptr;
   HWCBufferAllocator *buffer_allocator_ = nullptr;
   ToneMapConfig tone_map_config_ = {};
   uint8_t current_buffer_index_ = 0;
@@ -99,7 +112,7 @@ class ToneMapSession : public SyncTask<ToneMapTaskCode>::TaskHandler {
 
 class HWCToneMapper {
  public:
-  explicit HWCToneMapper(HWCBufferAllocator *allocator) : buffer_allocator_(allocator) {}
+  explicit HWCToneMapper(HWCBufferAllocator *allocator);
   ~HWCToneMapper() {}
 
   int HandleToneMap(LayerStack *layer_stack);
@@ -109,7 +122,8 @@ class HWCToneMapper {
   void Terminate();
 
  private:
-  void ToneMap(Layer *layer, ToneMapSession *session);
+  void StartToneMap(Layer *layer, ToneMapSession *session);
+  void FinishToneMaps();
   DisplayError AcquireToneMapSession(Layer *layer, uint32_t *session_index);
   void DumpToneMapOutput(ToneMapSession *session, int *acquire_fence);
 
@@ -119,6 +133,7 @@ class HWCToneMapper {
   uint32_t dump_frame_count_ = 0;
   uint32_t dump_frame_index_ = 0;
   int fb_session_index_ = -1;
+  bool cpu_tone_mapper_enabled_ = false;
 };
 
 }  // namespace sdm
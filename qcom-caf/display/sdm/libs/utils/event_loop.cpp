@@ -0,0 +1,166 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/event_loop.h>
+
+#include <algorithm>
+
+#define __CLASS__ "EventLoop"
+
+namespace sdm {
+
+// Retry delays after an epoll_wait failure
+static const uint32_t kMinBackoffUs = 1000;
+static const uint32_t kMaxBackoffUs = 1000000;
+
+EventLoop *EventLoop::Get() {
+  // Lives for the life of the process, like the listeners it serves.
+  static EventLoop *event_loop = new EventLoop();
+  return event_loop;
+}
+
+DisplayError EventLoop::Start() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    DLOGE("epoll_create1 failed, error = %s", strerror(errno));
+    return kErrorResources;
+  }
+
+  thread_ = std::thread(&EventLoop::Run, this);
+  thread_id_ = thread_.get_id();
+  thread_.detach();
+
+  return kErrorNone;
+}
+
+DisplayError EventLoop::Register(int fd, uint32_t events, const Handler &handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd < 0 || fd_to_id_.count(fd)) {
+    return kErrorParameters;
+  }
+
+  if (epoll_fd_ < 0) {
+    DisplayError error = Start();
+    if (error != kErrorNone) {
+      return error;
+    }
+  }
+
+  uint64_t id = next_id_++;
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.u64 = id;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+    DLOGE("epoll_ctl add failed for fd %d, error = %s", fd, strerror(errno));
+    return kErrorResources;
+  }
+
+  std::shared_ptr<Source> source = std::make_shared<Source>();
+  source->fd = fd;
+  source->handler = handler;
+  sources_[id] = source;
+  fd_to_id_[fd] = id;
+
+  return kErrorNone;
+}
+
+DisplayError EventLoop::Unregister(int fd) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = fd_to_id_.find(fd);
+  if (it == fd_to_id_.end()) {
+    return kErrorParameters;
+  }
+
+  uint64_t id = it->second;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
+  fd_to_id_.erase(it);
+  sources_.erase(id);
+
+  // Wait for a handler of this source that is already running, unless that is the caller.
+  if (std::this_thread::get_id() != thread_id_) {
+    dispatch_cv_.wait(lock, [this, id] { return dispatching_id_ != id; });
+  }
+
+  return kErrorNone;
+}
+
+void EventLoop::Run() {
+  prctl(PR_SET_NAME, "SDM_EventLoop", 0, 0, 0);
+  setpriority(PRIO_PROCESS, 0, kThreadPriorityUrgent);
+
+  struct epoll_event events[kMaxEvents];
+  uint32_t backoff_us = kMinBackoffUs;
+  while (true) {
+    int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // A failing epoll_wait keeps failing right away, do not spin on it.
+      DLOGW("epoll_wait failed, error = %s, retrying in %u us", strerror(errno), backoff_us);
+      usleep(backoff_us);
+      backoff_us = std::min(backoff_us * 2, kMaxBackoffUs);
+      continue;
+    }
+    backoff_us = kMinBackoffUs;
+
+    for (int i = 0; i < count; i++) {
+      uint64_t id = events[i].data.u64;
+      std::shared_ptr<Source> source;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sources_.find(id);
+        if (it == sources_.end()) {
+          // Unregistered after epoll_wait returned.
+          continue;
+        }
+        source = it->second;
+        dispatching_id_ = id;
+      }
+
+      source->handler(events[i].events);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dispatching_id_ = 0;
+      }
+      dispatch_cv_.notify_all();
+    }
+  }
+}
+
+}  // namespace sdm
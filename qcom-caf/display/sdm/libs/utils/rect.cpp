@@ -83,6 +83,58 @@ LayerRect Intersection(const LayerRect &rect1, const LayerRect &rect2) {
   return res;
 }
 
+// Two rects can be merged without growing the area they cover when one contains the other, or
+// when they span the same rows (columns) and overlap or touch horizontally (vertically).
+static bool IsMergeable(const LayerRect &rect1, const LayerRect &rect2) {
+  if (rect1.top == rect2.top && rect1.bottom == rect2.bottom) {
+    return (rect2.left <= rect1.right) && (rect1.left <= rect2.right);
+  }
+
+  if (rect1.left == rect2.left && rect1.right == rect2.right) {
+    return (rect2.top <= rect1.bottom) && (rect1.top <= rect2.bottom);
+  }
+
+  LayerRect res = Intersection(rect1, rect2);
+
+  return (res == rect1) || (res == rect2);
+}
+
+void Coalesce(std::vector<LayerRect> *rects) {
+  if (rects->size() < 2) {
+    return;
+  }
+
+  // Empty rects add nothing to a region, but keep one if the region is empty as a whole.
+  auto end = std::remove_if(rects->begin(), rects->end(),
+                            [](const LayerRect &rect) { return !IsValid(rect); });
+  if (end == rects->begin()) {
+    end++;
+  }
+  rects->erase(end, rects->end());
+
+  // Merging two rects can make the result mergeable with a rect visited earlier, so repeat until
+  // a full pass finds nothing. Stacks carry a handful of damage rects, so this stays cheap.
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < rects->size(); i++) {
+      for (size_t j = i + 1; j < rects->size();) {
+        LayerRect &rect1 = rects->at(i);
+        LayerRect &rect2 = rects->at(j);
+        if (!IsMergeable(rect1, rect2)) {
+          j++;
+          continue;
+        }
+
+        rect1 = Union(rect1, rect2);
+        rect2 = rects->back();
+        rects->pop_back();
+        merged = true;
+      }
+    }
+  }
+}
+
 LayerRect Reposition(const LayerRect &rect, const int &x_offset, const int &y_offset) {
   LayerRect res;
 
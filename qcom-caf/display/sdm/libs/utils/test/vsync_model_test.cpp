@@ -0,0 +1,175 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Feeds VsyncModel simulated hardware vsync traces and checks its predictions against the true
+// vsync grid. Exits with a non zero status if any check fails.
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utils/vsync_model.h>
+
+#include <random>
+
+using sdm::VsyncModel;
+
+namespace {
+
+const int64_t kNominalPeriodNs = 16666667;  // Mode reported at 60 Hz
+const int64_t kTruePeriodNs = 16393443;     // Panel actually running at 61 Hz
+const double kJitterNs = 300000.0;
+const int64_t kStartNs = 1000000000;
+
+int failures = 0;
+
+void Check(bool condition, const char *what, int64_t value) {
+  printf("%s %s: %" PRId64 "\n", condition ? "PASS" : "FAIL", what, value);
+  if (!condition) {
+    failures++;
+  }
+}
+
+int64_t Abs(int64_t value) {
+  return value < 0 ? -value : value;
+}
+
+// Simulated vsync source: a fixed grid with gaussian timestamp jitter
+class VsyncTrace {
+ public:
+  VsyncTrace(int64_t phase_ns, int64_t period_ns)
+    : phase_ns_(phase_ns), period_ns_(period_ns), random_(1234), jitter_(0.0, kJitterNs) { }
+
+  int64_t Vsync(int64_t ordinal) { return phase_ns_ + ordinal * period_ns_; }
+  int64_t Timestamp(int64_t ordinal) {
+    return Vsync(ordinal) + static_cast<int64_t>(jitter_(random_));
+  }
+  bool Drop() { return (random_() % 10) == 0; }
+  void Shift(int64_t offset_ns) { phase_ns_ += offset_ns; }
+
+ private:
+  int64_t phase_ns_;
+  int64_t period_ns_;
+  std::mt19937 random_;
+  std::normal_distribution<double> jitter_;
+};
+
+// Error of the model's next vsync prediction, made half a period after vsync ordinal.
+int64_t PredictionError(VsyncModel *model, VsyncTrace *trace, int64_t ordinal) {
+  int64_t now_ns = trace->Vsync(ordinal) + kTruePeriodNs / 2;
+  return model->PredictVsync(now_ns, 0) - trace->Vsync(ordinal + 1);
+}
+
+void TestDriftJitterAndDrops() {
+  VsyncModel model;
+  VsyncTrace trace(kStartNs, kTruePeriodNs);
+  model.Reset(kNominalPeriodNs);
+
+  int64_t ordinal = 0;
+  for (; ordinal < 200; ordinal++) {
+    if (!trace.Drop()) {
+      model.AddSample(trace.Timestamp(ordinal));
+    }
+  }
+
+  Check(Abs(model.GetPeriod() - kTruePeriodNs) < 20000, "period fitted to the 61 Hz panel",
+        model.GetPeriod() - kTruePeriodNs);
+  Check(Abs(PredictionError(&model, &trace, ordinal - 1)) < 400000,
+        "next vsync predicted within 0.4 ms", PredictionError(&model, &trace, ordinal - 1));
+  Check(Abs(model.PredictVsync(trace.Vsync(ordinal - 1) + kTruePeriodNs / 2, 9) -
+            trace.Vsync(ordinal + 9)) < 600000, "tenth vsync predicted within 0.6 ms",
+        model.PredictVsync(trace.Vsync(ordinal - 1) + kTruePeriodNs / 2, 9) -
+        trace.Vsync(ordinal + 9));
+}
+
+void TestSpikeRejected() {
+  VsyncModel model;
+  VsyncTrace trace(kStartNs, kTruePeriodNs);
+  model.Reset(kNominalPeriodNs);
+
+  int64_t ordinal = 0;
+  for (; ordinal < 100; ordinal++) {
+    model.AddSample(trace.Timestamp(ordinal));
+  }
+
+  // A single late interrupt, 8 ms off the grid
+  model.AddSample(trace.Vsync(ordinal) + 8000000);
+  ordinal++;
+  Check(model.GetOutlierCount() == 1, "late sample counted as an outlier",
+        model.GetOutlierCount());
+  Check(Abs(PredictionError(&model, &trace, ordinal - 1)) < 400000,
+        "prediction unaffected by the outlier", PredictionError(&model, &trace, ordinal - 1));
+}
+
+void TestPhaseJump() {
+  VsyncModel model;
+  VsyncTrace trace(kStartNs, kTruePeriodNs);
+  model.Reset(kNominalPeriodNs);
+
+  int64_t ordinal = 0;
+  for (; ordinal < 100; ordinal++) {
+    model.AddSample(trace.Timestamp(ordinal));
+  }
+
+  // Panel off and on again: the grid restarts 5 ms later
+  trace.Shift(5000000);
+  for (int i = 0; i < 3; i++, ordinal++) {
+    model.AddSample(trace.Timestamp(ordinal));
+  }
+  Check(Abs(PredictionError(&model, &trace, ordinal - 1)) < 1000000,
+        "re-locked within three samples of a phase jump",
+        PredictionError(&model, &trace, ordinal - 1));
+
+  for (int i = 0; i < 50; i++, ordinal++) {
+    model.AddSample(trace.Timestamp(ordinal));
+  }
+  Check(Abs(PredictionError(&model, &trace, ordinal - 1)) < 400000,
+        "converged again after the phase jump", PredictionError(&model, &trace, ordinal - 1));
+}
+
+void TestNoSamples() {
+  VsyncModel model;
+  model.Reset(kNominalPeriodNs);
+  Check(model.PredictVsync(kStartNs, 0) == 0, "no prediction before the first vsync",
+        model.PredictVsync(kStartNs, 0));
+  Check(model.GetPeriod() == kNominalPeriodNs, "nominal period reported until fitted",
+        model.GetPeriod());
+}
+
+}  // namespace
+
+int main() {
+  TestDriftJitterAndDrops();
+  TestSpikeRejected();
+  TestPhaseJump();
+  TestNoSamples();
+
+  printf("%s\n", failures ? "FAILED" : "ALL PASSED");
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/vsync_model.h>
+
+namespace sdm {
+
+// Rounds numerator / denominator to the nearest integer for a positive denominator.
+static int64_t RoundDiv(int64_t numerator, int64_t denominator) {
+  if (numerator >= 0) {
+    return (numerator + denominator / 2) / denominator;
+  }
+
+  return -((-numerator + denominator / 2) / denominator);
+}
+
+void VsyncModel::Reset(int64_t nominal_period_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  nominal_period_ns_ = nominal_period_ns;
+  period_ns_ = nominal_period_ns;
+  anchor_ns_ = 0;
+  num_samples_ = 0;
+  next_sample_ = 0;
+  consecutive_outliers_ = 0;
+  outlier_count_ = 0;
+}
+
+void VsyncModel::Restart(int64_t timestamp_ns) {
+  period_ns_ = nominal_period_ns_;
+  anchor_ns_ = timestamp_ns;
+  samples_[0] = timestamp_ns;
+  num_samples_ = 1;
+  next_sample_ = 1;
+  consecutive_outliers_ = 0;
+}
+
+void VsyncModel::AddSample(int64_t timestamp_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (nominal_period_ns_ <= 0) {
+    return;
+  }
+
+  if (!num_samples_) {
+    Restart(timestamp_ns);
+    return;
+  }
+
+  int64_t last_ns = samples_[(next_sample_ + kWindowSize - 1) % kWindowSize];
+  if (timestamp_ns <= last_ns) {
+    // Repeated or out of order timestamp.
+    return;
+  }
+
+  int64_t ordinal = RoundDiv(timestamp_ns - anchor_ns_, period_ns_);
+  int64_t residual = timestamp_ns - (anchor_ns_ + ordinal * period_ns_);
+  if ((residual < 0 ? -residual : residual) > period_ns_ / kOutlierDivisor ||
+      timestamp_ns - last_ns < period_ns_ / 2) {
+    outlier_count_++;
+    if (++consecutive_outliers_ >= kMaxConsecutiveOutliers) {
+      Restart(timestamp_ns);
+    }
+    return;
+  }
+
+  consecutive_outliers_ = 0;
+  samples_[next_sample_] = timestamp_ns;
+  next_sample_ = (next_sample_ + 1) % kWindowSize;
+  if (num_samples_ < kWindowSize) {
+    num_samples_++;
+  }
+
+  Fit();
+}
+
+void VsyncModel::Fit() {
+  if (num_samples_ < kMinFitSamples) {
+    anchor_ns_ = samples_[(next_sample_ + kWindowSize - 1) % kWindowSize];
+    return;
+  }
+
+  // Fit timestamp = intercept + slope * ordinal relative to the oldest sample in the window.
+  // Values are kept relative to the oldest sample so that they fit a double without loss.
+  uint32_t oldest = (next_sample_ + kWindowSize - num_samples_) % kWindowSize;
+  int64_t base_ns = samples_[oldest];
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (uint32_t i = 0; i < num_samples_; i++) {
+    int64_t offset_ns = samples_[(oldest + i) % kWindowSize] - base_ns;
+    double x = static_cast<double>(RoundDiv(offset_ns, period_ns_));
+    double y = static_cast<double>(offset_ns);
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+
+  double n = static_cast<double>(num_samples_);
+  double denominator = n * sum_xx - sum_x * sum_x;
+  if (denominator <= 0) {
+    return;
+  }
+
+  double slope = (n * sum_xy - sum_x * sum_y) / denominator;
+  double intercept = (sum_y - slope * sum_x) / n;
+  int64_t period_ns = static_cast<int64_t>(slope + 0.5);
+  int64_t drift_ns = period_ns - nominal_period_ns_;
+  if ((drift_ns < 0 ? -drift_ns : drift_ns) > nominal_period_ns_ / kMaxDriftDivisor) {
+    return;
+  }
+
+  period_ns_ = period_ns;
+  anchor_ns_ = base_ns + static_cast<int64_t>(intercept + 0.5);
+}
+
+int64_t VsyncModel::PredictVsync(int64_t time_ns, uint32_t index) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!num_samples_ || period_ns_ <= 0) {
+    return 0;
+  }
+
+  // Number of whole periods from the anchor up to and including time_ns.
+  int64_t elapsed_ns = time_ns - anchor_ns_;
+  int64_t periods = elapsed_ns >= 0 ? (elapsed_ns / period_ns_) :
+                                      -((-elapsed_ns + period_ns_ - 1) / period_ns_);
+
+  return anchor_ns_ + (periods + 1 + index) * period_ns_;
+}
+
+int64_t VsyncModel::GetPeriod() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return (num_samples_ >= kMinFitSamples) ? period_ns_ : nominal_period_ns_;
+}
+
+uint32_t VsyncModel::GetOutlierCount() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return outlier_count_;
+}
+
+}  // namespace sdm
@@ -0,0 +1,229 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/worker_pool.h>
+
+#include <thread>
+
+#define __CLASS__ "WorkerPool"
+
+namespace sdm {
+
+// Roughly 10us of polling on the cores this runs on, well below a futex wake up and reschedule.
+static const uint32_t kSpinCount = 1000;
+
+// Spinning only pays off when the other side runs on another core meanwhile.
+static uint32_t GetSpinCount() {
+  static const uint32_t spin_count = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? kSpinCount : 0;
+  return spin_count;
+}
+
+static inline void CpuRelax() {
+#if defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#elif defined(__i386__) || defined(__x86_64__)
+  asm volatile("pause" ::: "memory");
+#endif
+}
+
+static inline void FutexWait(std::atomic<uint32_t> *word, uint32_t value) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT_PRIVATE, value, NULL, NULL,
+          0);
+}
+
+static inline void FutexWake(std::atomic<uint32_t> *word, int count) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE_PRIVATE, count, NULL, NULL,
+          0);
+}
+
+void WorkerTask::Wait() {
+  uint32_t spin_count = GetSpinCount();
+  for (uint32_t i = 0; i < spin_count; i++) {
+    if (IsDone()) {
+      return;
+    }
+    CpuRelax();
+  }
+
+  while (true) {
+    uint32_t state = state_.load(std::memory_order_acquire);
+    if (state == kStateDone) {
+      return;
+    }
+    if (state == kStateQueued &&
+        !state_.compare_exchange_weak(state, kStateWaited, std::memory_order_acquire)) {
+      continue;
+    }
+    FutexWait(&state_, kStateWaited);
+  }
+}
+
+void WorkerTask::Complete() {
+  // The task may be destroyed as soon as it reads done, so it is not touched after the exchange.
+  // A wake up on a reused address is harmless, futex waiters recheck their word.
+  if (state_.exchange(kStateDone, std::memory_order_release) == kStateWaited) {
+    FutexWake(&state_, INT_MAX);
+  }
+}
+
+WorkerPool *WorkerPool::Get() {
+  // Lives for the life of the process, its threads are never joined.
+  static WorkerPool *worker_pool = new WorkerPool();
+  return worker_pool;
+}
+
+WorkerPool::WorkerPool() {
+  for (Queue &queue : queues_) {
+    for (uint32_t i = 0; i < kQueueSize; i++) {
+      queue.slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+}
+
+void WorkerPool::Submit(Lane lane, WorkerTask *task) {
+  Queue &queue = queues_[lane];
+
+  std::call_once(queue.started, [this, lane] {
+    uint32_t num_workers = (lane == kLaneGeneral) ? kNumGeneralWorkers : 1;
+    for (uint32_t i = 0; i < num_workers; i++) {
+      std::thread(&WorkerPool::Run, this, lane, i).detach();
+    }
+  });
+
+  task->Wait();
+  task->state_.store(WorkerTask::kStateQueued, std::memory_order_relaxed);
+
+  // Only as many tasks as there are task owners are in flight, the queue does not fill up in
+  // practice.
+  while (!TryPush(&queue, task)) {
+    sched_yield();
+  }
+
+  queue.event.fetch_add(1, std::memory_order_seq_cst);
+  if (queue.sleepers.load(std::memory_order_seq_cst)) {
+    FutexWake(&queue.event, 1);
+  }
+}
+
+bool WorkerPool::TryPush(Queue *queue, WorkerTask *task) {
+  uint32_t pos = queue->enqueue_pos.load(std::memory_order_relaxed);
+  while (true) {
+    Slot &slot = queue->slots[pos % kQueueSize];
+    int32_t diff = INT32(slot.sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (queue->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        slot.task = task;
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = queue->enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool WorkerPool::TryPop(Queue *queue, WorkerTask **task) {
+  uint32_t pos = queue->dequeue_pos.load(std::memory_order_relaxed);
+  while (true) {
+    Slot &slot = queue->slots[pos % kQueueSize];
+    int32_t diff = INT32(slot.sequence.load(std::memory_order_acquire) - (pos + 1));
+    if (diff == 0) {
+      if (queue->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        *task = slot.task;
+        slot.sequence.store(pos + kQueueSize, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = queue->dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+WorkerTask *WorkerPool::Pop(Queue *queue) {
+  WorkerTask *task = nullptr;
+  uint32_t spin_count = GetSpinCount();
+
+  for (uint32_t i = 0; i < spin_count; i++) {
+    if (TryPop(queue, &task)) {
+      return task;
+    }
+    CpuRelax();
+  }
+
+  while (true) {
+    // Sample the event before the last look at the queue, a push after it changes the word and
+    // makes the wait return right away.
+    uint32_t event = queue->event.load(std::memory_order_seq_cst);
+    queue->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    if (!TryPop(queue, &task)) {
+      FutexWait(&queue->event, event);
+    }
+    queue->sleepers.fetch_sub(1, std::memory_order_relaxed);
+    if (task || TryPop(queue, &task)) {
+      return task;
+    }
+  }
+}
+
+void WorkerPool::Run(Lane lane, uint32_t index) {
+  char name[16] = {};
+  if (lane == kLaneGL) {
+    snprintf(name, sizeof(name), "SDM_WorkerGL");
+  } else if (lane == kLaneCpu) {
+    snprintf(name, sizeof(name), "SDM_WorkerCPU");
+  } else {
+    snprintf(name, sizeof(name), "SDM_Worker_%u", index);
+  }
+  prctl(PR_SET_NAME, name, 0, 0, 0);
+  setpriority(PRIO_PROCESS, 0, kThreadPriorityUrgent);
+  DLOGI("%s started", name);
+
+  Queue &queue = queues_[lane];
+  while (true) {
+    WorkerTask *task = Pop(&queue);
+    task->Run();
+    task->Complete();
+  }
+}
+
+}  // namespace sdm